@@ -1121,7 +1121,8 @@ bool I_IsHeadless()
 	static bool initialized = false;
 	if (!initialized)
 	{
-		headless = Args.CheckParm("-novideo") || Args.CheckParm("+demotest");
+		headless = Args.CheckParm("-novideo") || Args.CheckParm("+demotest") ||
+		           Args.CheckParm("-netdemoinfo");
 		initialized = true;
 	}
 
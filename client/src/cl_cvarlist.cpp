@@ -380,6 +380,18 @@ CVAR(				cl_autoscreenshot, "0", "Automatically capture a screenshot at the end
 CVAR(				cl_splitnetdemos, "0", "Create separate netdemos for each map",
 					CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
+CVAR_RANGE(			cl_netdemosnapshotspacing, "20", "Number of seconds between the snapshots " \
+					"recorded in a netdemo for seeking",
+					CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 1.0f, 1800.0f)
+
+CVAR_RANGE(			cl_netdemokeyframespacing, "5", "Number of seconds between the snapshots kept " \
+					"in memory while playing a netdemo to speed up seeking, 0 to disable",
+					CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 600.0f)
+
+CVAR_RANGE(			cl_netdemocompression, "1", "Compression used for recording netdemos " \
+					"(0 = none, 1 = LZO)",
+					CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 1.0f)
+
 // Mouse settings
 // --------------
 
@@ -38,9 +38,13 @@
 #include "st_stuff.h"
 #include "p_mobj.h"
 #include "g_level.h"
+#include "minilzo.h"
 
 EXTERN_CVAR(sv_maxclients)
 EXTERN_CVAR(sv_maxplayers)
+EXTERN_CVAR(cl_netdemosnapshotspacing)
+EXTERN_CVAR(cl_netdemokeyframespacing)
+EXTERN_CVAR(cl_netdemocompression)
 
 extern std::string server_host;
 extern std::string digest;
@@ -51,7 +55,7 @@ argb_t CL_GetPlayerColor(player_t*);
 
 NetDemo::NetDemo() :
 	state(st_stopped), oldstate(st_stopped), filename(""),
-	demofp(NULL)
+	demofp(NULL), writer(NULL), readblock_index(-1), read_offset(0), keyframe_memory(0), seektic(-1), pov(0)
 {
     memset(&header, 0, sizeof(header));
 }
@@ -79,6 +83,14 @@ void NetDemo::copy(NetDemo &to, const NetDemo &from)
 	to.captured			= from.captured;
 	to.snapshot_index	= from.snapshot_index;
 	to.map_index		= from.map_index;
+	to.block_offsets	= from.block_offsets;
+	to.readblock		= from.readblock;
+	to.readblock_index	= from.readblock_index;
+	to.read_offset		= from.read_offset;
+	to.keyframes		= from.keyframes;
+	to.keyframe_memory	= from.keyframe_memory;
+	to.seektic			= from.seektic;
+	to.pov				= from.pov;
 	memcpy(&to.header, &from.header, sizeof(header));
 }
 
@@ -123,9 +135,24 @@ void NetDemo::cleanUp()
 		fclose(demofp);
 		demofp = NULL;
 	}
+
+	if (writer)
+	{
+		writer->close();
+		delete writer;
+		writer = NULL;
+	}
+
+	block_offsets.clear();
+	readblock.clear();
+	readblock_index = -1;
+	read_offset = 0;
 	
 	snapshot_index.clear();
 	map_index.clear();
+	keyframes.clear();
+	keyframe_memory = 0;
+	seektic = -1;
 	state = oldstate = NetDemo::st_stopped;
 }
 
@@ -159,64 +186,6 @@ void NetDemo::fatalError(const std::string &message)
 	Printf(PRINT_HIGH, "%s\n", message.c_str());
 }
 
-//
-// writeHeader()
-//
-//   Writes the header struct to the netdemo file in little-endian format
-//   Assumes that demofp has been opened correctly elsewhere.  Does not close
-//   the file.
-
-bool NetDemo::writeHeader()
-{
-	strncpy(header.identifier, "ODAD", 4);
-	header.version = NETDEMOVER;
-	header.compression = 0;
-	header.snapshot_spacing = NetDemo::SNAPSHOT_SPACING;
-
-	netdemo_header_t tmpheader;
-	memcpy(&tmpheader, &header, sizeof(header));
-
-	// convert from native byte ordering to little-endian
-	tmpheader.snapshot_index_size	= LESHORT(tmpheader.snapshot_index_size);
-	tmpheader.snapshot_index_offset	= LELONG(tmpheader.snapshot_index_offset);
-	tmpheader.map_index_size		= LESHORT(tmpheader.map_index_size);
-	tmpheader.map_index_offset		= LELONG(tmpheader.map_index_offset);
-	tmpheader.snapshot_spacing		= LESHORT(tmpheader.snapshot_spacing);
-	tmpheader.starting_gametic		= LELONG(tmpheader.starting_gametic);
-	tmpheader.ending_gametic		= LELONG(tmpheader.ending_gametic);
-	
-	fseek(demofp, 0, SEEK_SET);
-	size_t cnt = 0;
-	cnt += sizeof(tmpheader.identifier) *
-		fwrite(&tmpheader.identifier, sizeof(tmpheader.identifier), 1, demofp);
-	cnt += sizeof(tmpheader.version) *
-		fwrite(&tmpheader.version, sizeof(tmpheader.version), 1, demofp);
-	cnt += sizeof(tmpheader.compression) *
-		fwrite(&tmpheader.compression, sizeof(tmpheader.compression), 1, demofp);
-	cnt += sizeof(tmpheader.snapshot_index_size) *
-		fwrite(&tmpheader.snapshot_index_size, sizeof(tmpheader.snapshot_index_size), 1, demofp);
-	cnt += sizeof(tmpheader.snapshot_index_offset)*
-		fwrite(&tmpheader.snapshot_index_offset, sizeof(tmpheader.snapshot_index_offset), 1, demofp);
-	cnt += sizeof(tmpheader.map_index_size) *
-		fwrite(&tmpheader.map_index_size, sizeof(tmpheader.map_index_size), 1, demofp);
-	cnt += sizeof(tmpheader.map_index_offset)*
-		fwrite(&tmpheader.map_index_offset, sizeof(tmpheader.map_index_offset), 1, demofp);
-	cnt += sizeof(tmpheader.snapshot_spacing) *
-		fwrite(&tmpheader.snapshot_spacing, sizeof(tmpheader.snapshot_spacing), 1, demofp);
-	cnt += sizeof(tmpheader.starting_gametic) *
-		fwrite(&tmpheader.starting_gametic, sizeof(tmpheader.starting_gametic), 1, demofp);
-	cnt += sizeof(tmpheader.ending_gametic) *
-		fwrite(&tmpheader.ending_gametic, sizeof(tmpheader.ending_gametic), 1, demofp);
-	cnt += sizeof(tmpheader.reserved) *
-		fwrite(&tmpheader.reserved, sizeof(tmpheader.reserved), 1, demofp);
-	
-	if (cnt < NetDemo::HEADER_SIZE)
-		return false;
-
-	return true;
-}
-
-
 //
 // readHeader()
 //
@@ -249,10 +218,16 @@ bool NetDemo::readHeader()
 		fread(&header.starting_gametic, sizeof(header.starting_gametic), 1, demofp);
 	cnt += sizeof(header.ending_gametic) *
 		fread(&header.ending_gametic, sizeof(header.ending_gametic), 1, demofp);
+	cnt += sizeof(header.block_size) *
+		fread(&header.block_size, sizeof(header.block_size), 1, demofp);
+	cnt += sizeof(header.block_count) *
+		fread(&header.block_count, sizeof(header.block_count), 1, demofp);
+	cnt += sizeof(header.block_table_offset) *
+		fread(&header.block_table_offset, sizeof(header.block_table_offset), 1, demofp);
 	cnt += sizeof(header.reserved) *
 		fread(&header.reserved, sizeof(header.reserved), 1, demofp);
 	
-	if (cnt < NetDemo::HEADER_SIZE)
+	if (cnt < NETDEMO_HEADER_SIZE)
 		return false;
 
 	// convert from little-endian to native byte ordering
@@ -263,45 +238,147 @@ bool NetDemo::readHeader()
 	header.snapshot_spacing 		= LESHORT(header.snapshot_spacing);
 	header.starting_gametic 		= LELONG(header.starting_gametic);
 	header.ending_gametic			= LELONG(header.ending_gametic);
+	header.block_size				= LELONG(header.block_size);
+	header.block_count				= LELONG(header.block_count);
+	header.block_table_offset		= LELONG(header.block_table_offset);
 	
 	return true;
 }
 
 
 //
-// writeSnapshotIndex()
+// readBlockTable()
 //
-//   Writes the snapshot index to the netdemo file, converting it to
-//   little-endian format from whatever the client's architecture uses.  Assumes
-//   that demofp has been opened correctly elsewhere.  Does not close the file.
+//   Reads the file offsets of the compressed blocks from the netdemo file.
 
-bool NetDemo::writeSnapshotIndex()
+bool NetDemo::readBlockTable()
 {
-	fseek(demofp, header.snapshot_index_offset, SEEK_SET);
+	if (header.block_size == 0 || header.block_size > NetDemo::MAX_SNAPSHOT_SIZE)
+		return false;
+
+	if (fseek(demofp, header.block_table_offset, SEEK_SET) != 0)
+		return false;
+
+	block_offsets.resize(header.block_count);
+	for (size_t i = 0; i < block_offsets.size(); i++)
+	{
+		uint32_t offset;
+		if (fread(&offset, sizeof(offset), 1, demofp) < 1)
+			return false;
+
+		block_offsets[i] = LELONG(offset);
+	}
+
+	return true;
+}
+
+
+//
+// loadBlock()
+//
+//   Reads and decompresses a block of a compressed netdemo into readblock.
+
+bool NetDemo::loadBlock(size_t index)
+{
+	if ((int)index == readblock_index)
+		return true;
+
+	readblock_index = -1;
 
+	if (index >= block_offsets.size() ||
+		fseek(demofp, block_offsets[index], SEEK_SET) != 0)
+		return false;
 
+	uint32_t lengths[2];
+	if (fread(lengths, sizeof(lengths), 1, demofp) < 1)
+		return false;
 
-	for (size_t i = 0; i < snapshot_index.size(); i++)
+	uint32_t packed_len = LELONG(lengths[0]);
+	uint32_t size = LELONG(lengths[1]);
+	if (size > header.block_size || packed_len > size)
+		return false;
+
+	readblock.resize(size);
+	if (packed_len == 0)
 	{
-		netdemo_index_entry_t entry;
-		// convert to little-endian
-		entry.ticnum = LELONG(snapshot_index[i].ticnum);
-		entry.offset = LELONG(snapshot_index[i].offset);
-		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fwrite(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fwrite(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < NetDemo::INDEX_ENTRY_SIZE)
+		if (fread(&readblock[0], 1, size, demofp) < size)
+			return false;
+	}
+	else
+	{
+		std::vector<byte> packed(packed_len);
+		if (fread(&packed[0], 1, packed_len, demofp) < packed_len)
+			return false;
+
+		lzo_uint newlen = size;
+		int res = lzo1x_decompress_safe(&packed[0], packed_len, &readblock[0], &newlen, NULL);
+		if (res != LZO_E_OK || newlen != size)
+			return false;
+	}
+
+	readblock_index = index;
+	return true;
+}
+
+
+//
+// readData()
+//
+//   Reads from the netdemo file, decompressing as needed.  Returns false if
+//   there is not enough data left.
+
+bool NetDemo::readData(void *data, size_t size)
+{
+	if (header.compression == NETDEMO_COMP_NONE)
+		return fread(data, 1, size, demofp) == size;
+
+	byte *dest = static_cast<byte *>(data);
+
+	while (size > 0)
+	{
+		// the first block starts after the header
+		size_t index = read_offset / header.block_size;
+		size_t blockstart = MAX<size_t>(index * header.block_size, NETDEMO_HEADER_SIZE);
+
+		if (!loadBlock(index) || read_offset - blockstart >= readblock.size())
 			return false;
+
+		size_t pos = read_offset - blockstart;
+		size_t len = MIN(size, readblock.size() - pos);
+
+		memcpy(dest, &readblock[pos], len);
+		dest += len;
+		size -= len;
+		read_offset += len;
 	}
 
 	return true;
 }
 
 
+//
+// seekData()
+//
+//   Moves to an offset in the netdemo as if it were uncompressed.
+
+bool NetDemo::seekData(uint32_t offset)
+{
+	if (header.compression == NETDEMO_COMP_NONE)
+		return fseek(demofp, offset, SEEK_SET) == 0;
+
+	read_offset = offset;
+	return true;
+}
+
+uint32_t NetDemo::tellData()
+{
+	if (header.compression == NETDEMO_COMP_NONE)
+		return ftell(demofp);
+
+	return read_offset;
+}
+
+
 //
 // readSnapshotIndex()
 //
@@ -311,19 +388,15 @@ bool NetDemo::writeSnapshotIndex()
 
 bool NetDemo::readSnapshotIndex()
 {
-	fseek(demofp, header.snapshot_index_offset, SEEK_SET);
+	if (!seekData(header.snapshot_index_offset))
+		return false;
 
 	for (int i = 0; i < header.snapshot_index_size; i++)
 	{
 		netdemo_index_entry_t entry;
 		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fread(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fread(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < INDEX_ENTRY_SIZE)
+		if (!readData(&entry.ticnum, sizeof(entry.ticnum)) ||
+			!readData(&entry.offset, sizeof(entry.offset)))
 			return false;
 
 		// convert from little-endian to native
@@ -337,45 +410,17 @@ bool NetDemo::readSnapshotIndex()
 }
 
 
-bool NetDemo::writeMapIndex()
-{
-	fseek(demofp, header.map_index_offset, SEEK_SET);
-
-	for (size_t i = 0; i < map_index.size(); i++)
-	{
-		netdemo_index_entry_t entry;
-		// convert to little-endian
-		entry.ticnum = LELONG(map_index[i].ticnum);
-		entry.offset = LELONG(map_index[i].offset);
-		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fwrite(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fwrite(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < NetDemo::INDEX_ENTRY_SIZE)
-			return false;
-	}
-
-	return true;
-}
-
 bool NetDemo::readMapIndex()
 {
-	fseek(demofp, header.map_index_offset, SEEK_SET);
+	if (!seekData(header.map_index_offset))
+		return false;
 
 	for (int i = 0; i < header.map_index_size; i++)
 	{
 		netdemo_index_entry_t entry;
 		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fread(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fread(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < INDEX_ENTRY_SIZE)
+		if (!readData(&entry.ticnum, sizeof(entry.ticnum)) ||
+			!readData(&entry.offset, sizeof(entry.offset)))
 			return false;
 
 		// convert from little-endian to native
@@ -417,22 +462,26 @@ bool NetDemo::startRecording(const std::string &filename)
 		demofp = NULL;
 	}
 
-	demofp = fopen(filename.c_str(), "wb");
-	if (!demofp)
+	// the file is written by a separate thread so that recording does not
+	// stall the game on disk I/O
+	byte compression = cl_netdemocompression ? NETDEMO_COMP_LZO : NETDEMO_COMP_NONE;
+
+	delete writer;
+	writer = new NetDemoWriter;
+	if (!writer->open(filename, compression))
 	{
+		delete writer;
+		writer = NULL;
+
 		//error("Unable to create netdemo file " + filename + ".");
 		I_Warning("Unable to create netdemo file %s", filename.c_str());
 		return false;
 	}
 
 	memset(&header, 0, sizeof(header));
-	// Note: The header is not finalized at this point.  Write it anyway to
-	// reserve space in the output file for it and overwrite it later.
-	if (!writeHeader())
-	{
-		error("Unable to write netdemo header.");
-		return false;
-	}
+	header.snapshot_spacing = cl_netdemosnapshotspacing.asInt() * TICRATE;
+	header.compression = compression;
+	block_offsets.clear();
 
 	state = NetDemo::st_recording;
 	header.starting_gametic = gametic;
@@ -475,7 +524,7 @@ bool NetDemo::startRecording(const std::string &filename)
 //
 //
 
-bool NetDemo::startPlaying(const std::string &filename)
+bool NetDemo::startPlaying(const std::string &filename, byte pov)
 {
 	this->filename = filename;
 	
@@ -489,7 +538,7 @@ bool NetDemo::startPlaying(const std::string &filename)
 	{
 		// restart playing
 		cleanUp();
-		return startPlaying(filename);
+		return startPlaying(filename, pov);
 	}
 
 	if (isRecording())
@@ -498,6 +547,26 @@ bool NetDemo::startPlaying(const std::string &filename)
 		return false;
 	}
 
+	if (!openFile(filename))
+		return false;
+
+	this->pov = pov;
+	state = NetDemo::st_playing;
+
+	Printf(PRINT_HIGH, "Playing netdemo %s.\n", filename.c_str());
+	
+	return true;
+}
+
+
+//
+// openFile()
+//
+//   Opens a netdemo for reading and reads its header and indices.  Leaves
+//   the file positioned at the first message.
+
+bool NetDemo::openFile(const std::string &filename)
+{
 	if (!(demofp = fopen(filename.c_str(), "rb")))
 	{
 		error("Unable to open netdemo file.");
@@ -510,31 +579,34 @@ bool NetDemo::startPlaying(const std::string &filename)
 		return false;
 	}
 
-    if (header.version != NETDEMOVER)
-    {
-        // Do nothing since there is only one version of netdemo files currently
-    }
+	if (header.version > NETDEMOVER)
+	{
+		error("Netdemo was recorded with a newer version of Odamex.");
+		return false;
+	}
 
-	// read the demo's index
-	if (fseek(demofp, header.snapshot_index_offset, SEEK_SET) != 0)
+	// older netdemos can't be compressed, their block fields are reserved
+	if (header.compression > NETDEMO_COMP_LZO ||
+		(header.version < 4 && header.compression != NETDEMO_COMP_NONE))
 	{
-		error("Unable to find netdemo snapshot index.\n");
+		error("Unknown netdemo compression.");
 		return false;
 	}
 
-	if (!readSnapshotIndex())
+	if (header.compression != NETDEMO_COMP_NONE && !readBlockTable())
 	{
-		error("Unable to read netdemo snapshot index.\n");
+		error("Unable to read netdemo block table.");
 		return false;
 	}
 
-	// read the demo's map index
-	if (fseek(demofp, header.map_index_offset, SEEK_SET) != 0)
+	// read the demo's index
+	if (!readSnapshotIndex())
 	{
-		error("Unable to find netdemo map index.\n");
+		error("Unable to read netdemo snapshot index.\n");
 		return false;
 	}
 
+	// read the demo's map index
 	if (!readMapIndex())
 	{
 		error("Unable to read netdemo map index.\n");
@@ -542,11 +614,8 @@ bool NetDemo::startPlaying(const std::string &filename)
 	}
 
 	// get set up to read server cmds
-	fseek(demofp, NetDemo::HEADER_SIZE, SEEK_SET);
-	state = NetDemo::st_playing;
+	seekData(NETDEMO_HEADER_SIZE);
 
-	Printf(PRINT_HIGH, "Playing netdemo %s.\n", filename.c_str());
-	
 	return true;
 }
 
@@ -606,43 +675,31 @@ bool NetDemo::stopRecording()
 
 	// write the end-of-demo marker
 	byte marker = svc_netdemostop;
-	writeChunk(&marker, sizeof(marker), NetDemo::msg_packet);
+	writeChunk(&marker, sizeof(marker), NETDEMO_MSG_PACKET);
 
 	// write the number of the last gametic in the recording
 	header.ending_gametic = gametic;
 
 	// tack the snapshot index onto the end of the recording
-	fflush(demofp);
-	header.snapshot_index_offset = ftell(demofp);
+	header.snapshot_index_offset = writer->tell();
 	header.snapshot_index_size = snapshot_index.size();
-
-	if (!writeSnapshotIndex())
-	{
-		error("Unable to write netdemo snapshot index.");
-		return false;
-	}
+	writer->writeIndex(snapshot_index);
 
 	// tack the map index on to the end of the snapshot index
-	fflush(demofp);
-	header.map_index_offset = ftell(demofp);
+	header.map_index_offset = writer->tell();
 	header.map_index_size = map_index.size();
+	writer->writeIndex(map_index);
 
-	if (!writeMapIndex())
-	{
-		error("Unable to write netdemo map index.");
-		return false;
-	}
-
-	// rewrite the header since snapshot_index_offset and 
-	// snapshot_index_size are now known
-	if (!writeHeader())
+	// rewrite the header since snapshot_index_offset and
+	// snapshot_index_size are now known, and wait for the writer to finish
+	if (!writer->finish(header))
 	{
-		error("Unable to write updated netdemo header.");
+		error("Unable to write netdemo file.");
 		return false;
 	}
 
-	fclose(demofp);
-	demofp = NULL;
+	delete writer;
+	writer = NULL;
 
 	Printf(PRINT_HIGH, "Demo recording has stopped.\n");
 	reset();
@@ -676,70 +733,92 @@ bool NetDemo::stopPlaying()
 	return true;
 }
 
+
 //
-// writeLocalCmd()
+// convert()
 //
-//   Generates a message indicating the current position and angle of the
-//   consoleplayer, taking the place of ticcmds.  
-void NetDemo::writeLocalCmd(buf_t *netbuffer) const
+//   Rewrites the netdemo filename to newfilename using the compression
+//   set by cl_netdemocompression.  If newfilename is empty, the netdemo is
+//   replaced.  The uncompressed layout of the file does not change, so the
+//   offsets in the indices are copied as they are.
+
+bool NetDemo::convert(const std::string &filename, const std::string &newfilename)
 {
-	// Record the local player's data
-	player_t *player = &consoleplayer();
-	if (!player->mo)
-		return;
+	if (isPlaying() || isPaused() || isRecording())
+		return false;
 
-	AActor *mo = player->mo;
-
-	MSG_WriteByte(netbuffer, svc_netdemocap);
-	MSG_WriteByte(netbuffer, player->cmd.buttons);
-	MSG_WriteByte(netbuffer, player->cmd.impulse);
-	MSG_WriteShort(netbuffer, player->cmd.yaw);
-	MSG_WriteShort(netbuffer, player->cmd.forwardmove);
-	MSG_WriteShort(netbuffer, player->cmd.sidemove);
-	MSG_WriteShort(netbuffer, player->cmd.upmove);
-	MSG_WriteShort(netbuffer, player->cmd.pitch);
-
-	MSG_WriteByte(netbuffer, mo->waterlevel);
-	MSG_WriteLong(netbuffer, mo->x);
-	MSG_WriteLong(netbuffer, mo->y);
-	MSG_WriteLong(netbuffer, mo->z);
-	MSG_WriteLong(netbuffer, mo->momx);
-	MSG_WriteLong(netbuffer, mo->momy);
-	MSG_WriteLong(netbuffer, mo->momz);
-	MSG_WriteLong(netbuffer, mo->angle);
-	MSG_WriteLong(netbuffer, mo->pitch);
-	MSG_WriteLong(netbuffer, player->viewheight);
-	MSG_WriteLong(netbuffer, player->deltaviewheight);
-	MSG_WriteLong(netbuffer, player->jumpTics);
-	MSG_WriteLong(netbuffer, mo->reactiontime);
-	MSG_WriteByte(netbuffer, player->readyweapon);
-	MSG_WriteByte(netbuffer, player->pendingweapon);
-}
+	if (!openFile(filename))
+		return false;
 
+	std::string outname = newfilename.empty() ? filename + ".tmp" : newfilename;
 
-void NetDemo::writeChunk(const byte *data, size_t size, netdemo_message_t type)
-{
-	message_header_t msgheader;
-	memset(&msgheader, 0, sizeof(msgheader));
-	
-	msgheader.type = static_cast<byte>(type);
-	msgheader.length = LELONG((uint32_t)size);
-	msgheader.gametic = LELONG(gametic);
-	
-	size_t cnt = 0;
-	cnt += sizeof(msgheader.type) *
-		fwrite(&msgheader.type, sizeof(msgheader.type), 1, demofp);
-	cnt += sizeof(msgheader.length) *
-		fwrite(&msgheader.length, sizeof(msgheader.length), 1, demofp);
-	cnt += sizeof(msgheader.gametic) *
-		fwrite(&msgheader.gametic, sizeof(msgheader.gametic), 1, demofp);
+	// the packets are copied as they are, so the netdemo keeps the version
+	// they were recorded with.  Compression only needs version 4.
+	byte compression = cl_netdemocompression ? NETDEMO_COMP_LZO : NETDEMO_COMP_NONE;
+	byte version = header.version;
+	if (compression != NETDEMO_COMP_NONE && version < 4)
+		version = 4;
 
-	cnt += fwrite(data, 1, size, demofp);
-	if (cnt < size + NetDemo::MESSAGE_HEADER_SIZE)
+	NetDemoWriter out;
+	if (!out.open(outname, compression, version))
 	{
-		error("Unable to write netdemo message chunk\n");
-		return;
+		error("Unable to create netdemo file " + outname + ".");
+		return false;
+	}
+
+	// everything up to the end of the last index
+	uint32_t end = MAX(
+		header.snapshot_index_offset + header.snapshot_index_size * NETDEMO_INDEX_ENTRY_SIZE,
+		header.map_index_offset + header.map_index_size * NETDEMO_INDEX_ENTRY_SIZE);
+
+	std::vector<byte> buf(NETDEMO_BLOCK_SIZE);
+	seekData(NETDEMO_HEADER_SIZE);
+
+	for (uint32_t pos = NETDEMO_HEADER_SIZE; pos < end; )
+	{
+		size_t len = MIN<size_t>(end - pos, buf.size());
+		if (!readData(&buf[0], len))
+		{
+			out.close();
+			remove(outname.c_str());
+			error("Unable to read netdemo file " + filename + ".");
+			return false;
+		}
+
+		out.writeData(&buf[0], len);
+		pos += len;
+	}
+
+	// the indices keep their offsets, everything else in the header too
+	netdemo_header_t outheader;
+	memcpy(&outheader, &header, sizeof(header));
+	bool ok = out.finish(outheader);
+
+	cleanUp();
+
+	if (!ok)
+	{
+		remove(outname.c_str());
+		Printf(PRINT_HIGH, "Unable to write netdemo file %s.\n", outname.c_str());
+		return false;
 	}
+
+	if (newfilename.empty())
+	{
+		if (remove(filename.c_str()) != 0 || rename(outname.c_str(), filename.c_str()) != 0)
+		{
+			Printf(PRINT_HIGH, "Unable to replace netdemo file %s.\n", filename.c_str());
+			return false;
+		}
+	}
+
+	Printf(PRINT_HIGH, "Converted netdemo %s.\n", filename.c_str());
+	return true;
+}
+
+void NetDemo::writeChunk(const byte *data, size_t size, netdemo_message_t type)
+{
+	writer->writeChunk(type, data, size, gametic);
 }
 
 
@@ -764,6 +843,10 @@ bool NetDemo::atSnapshotInterval()
 void NetDemo::ticker()
 {
 	netdemotic++;
+
+	// stop fast-forwarding once the tic being seeked to has been played
+	if (seektic >= 0 && (gametic >= seektic || gametic >= (int)header.ending_gametic))
+		seektic = -1;
 }
 
 //
@@ -786,35 +869,31 @@ void NetDemo::writeMessages()
 		writeSnapshotData(snapbuf, length);
 		writeSnapshotIndexEntry();
 			
-		writeChunk(snapbuf, length, NetDemo::msg_snapshot);
+		writeChunk(snapbuf, length, NETDEMO_MSG_SNAPSHOT);
 	}
 
 	if (connected)
 	{	
 		// Write the console player's game data
 		SZ_Clear(&netbuf_localcmd);
-		writeLocalCmd(&netbuf_localcmd);
+		NetDemo_WriteLocalCmd(&netbuf_localcmd, consoleplayer());
 		captured.push_back(netbuf_localcmd);
 	}
 
-	byte *output_buf = new byte[captured.size() * MAX_UDP_PACKET];
+	// write the captured packets straight into the write buffer
+	size_t output_len = 0;
+	for (std::list<buf_t>::const_iterator it = captured.begin(); it != captured.end(); ++it)
+		output_len += it->BytesLeftToRead();
 
-	uint32_t output_len = 0;
-	while (!captured.empty())
-	{
-		buf_t netbuf(captured.front());
-		uint32_t len = netbuf.BytesLeftToRead();
+	writer->writeChunkHeader(NETDEMO_MSG_PACKET, output_len, gametic);
 
-		byte *chunk = netbuf.ReadChunk(len);
-		memcpy(output_buf + output_len, chunk, len);
-		output_len += len;
-		
-		captured.pop_front();
-	}
+	for (std::list<buf_t>::iterator it = captured.begin(); it != captured.end(); ++it)
+		writer->writeData(it->ptr() + it->BytesRead(), it->BytesLeftToRead());
 
-	writeChunk(output_buf, output_len, NetDemo::msg_packet);
+	captured.clear();
 
-	delete [] output_buf;
+	if (writer->failed())
+		error("Unable to write netdemo file.");
 }
 
 
@@ -825,21 +904,15 @@ void NetDemo::writeMessages()
 //   len and tic parameters.
 //   Returns false upon file read error.
 
-bool NetDemo::readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic) const
+bool NetDemo::readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic)
 {
 	len = tic = 0;
 
 	message_header_t msgheader;
 	
-	size_t cnt = 0;
-	cnt += sizeof(msgheader.type) *
-		fread(&msgheader.type, sizeof(msgheader.type), 1, demofp);
-	cnt += sizeof(msgheader.length) *
-		fread(&msgheader.length, sizeof(msgheader.length), 1, demofp);
-	cnt += sizeof(msgheader.gametic) *
-		fread(&msgheader.gametic, sizeof(msgheader.gametic), 1, demofp);
-	
-	if (cnt < NetDemo::MESSAGE_HEADER_SIZE)
+	if (!readData(&msgheader.type, sizeof(msgheader.type)) ||
+		!readData(&msgheader.length, sizeof(msgheader.length)) ||
+		!readData(&msgheader.gametic, sizeof(msgheader.gametic)))
 	{
 		return false;
 	}
@@ -862,24 +935,121 @@ bool NetDemo::readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t
  
 void NetDemo::readMessageBody(buf_t *netbuffer, uint32_t len)
 {
-	char *msgdata = new char[len];
+	std::vector<byte> msgdata(len);
 	
-	size_t cnt = fread(msgdata, 1, len, demofp);
-	if (cnt < len)
+	if (len && !readData(&msgdata[0], len))
 	{
-		delete[] msgdata;
 		fatalError("Can not read netdemo message.");
 		return;
 	}
 
+	parseMessage(netbuffer, len ? &msgdata[0] : NULL, len);
+}
+
+
+//
+// readPOVPacket()
+//
+//   Reads a message recorded by the server and puts together the packet
+//   that was sent to the player being watched.  The message holds every
+//   distinct message sent during the tic once:
+//
+//     WORD count, then count messages of LONG length and data
+//     BYTE number of players, then for each player
+//       BYTE player id, WORD count, then count WORD message numbers
+//
+//   Returns false if nothing was sent to the player that tic.
+//
+
+bool NetDemo::readPOVPacket(uint32_t len, std::vector<byte> &packet)
+{
+	packet.clear();
+
+	std::vector<byte> data(len);
+	if (len && !readData(&data[0], len))
+	{
+		fatalError("Can not read netdemo message.");
+		return false;
+	}
+
+	size_t pos = 0;
+
+	#define NEED(n) if (pos + (n) > data.size()) { fatalError("Bad netdemo message."); return false; }
+
+	NEED(2);
+	size_t count = data[pos] | (data[pos + 1] << 8);
+	pos += 2;
+
+	std::vector<std::pair<size_t, size_t> > messages;
+	for (size_t i = 0; i < count; i++)
+	{
+		NEED(4);
+		size_t msglen = data[pos] | (data[pos + 1] << 8) |
+						(data[pos + 2] << 16) | (data[pos + 3] << 24);
+		pos += 4;
+
+		NEED(msglen);
+		messages.push_back(std::make_pair(pos, msglen));
+		pos += msglen;
+	}
+
+	NEED(1);
+	size_t numpovs = data[pos++];
+	for (size_t i = 0; i < numpovs; i++)
+	{
+		NEED(3);
+		byte id = data[pos];
+		size_t refs = data[pos + 1] | (data[pos + 2] << 8);
+		pos += 3;
+
+		NEED(refs * 2);
+
+		// watch the first player recorded unless told otherwise
+		if (pov == 0)
+			pov = id;
+
+		if (id == pov)
+		{
+			for (size_t j = 0; j < refs; j++)
+			{
+				size_t index = data[pos + j * 2] | (data[pos + j * 2 + 1] << 8);
+				if (index >= messages.size())
+				{
+					fatalError("Bad netdemo message.");
+					return false;
+				}
+
+				packet.insert(packet.end(), data.begin() + messages[index].first,
+					data.begin() + messages[index].first + messages[index].second);
+			}
+			return true;
+		}
+
+		pos += refs * 2;
+	}
+
+	#undef NEED
+
+	return false;
+}
+
+
+//
+// parseMessage()
+//
+//   Puts a packet read from the netdemo into netbuffer and parses it.
+//
+
+void NetDemo::parseMessage(buf_t *netbuffer, const byte *data, size_t len)
+{
 	// ensure netbuffer has enough free space to hold this packet
 	if (netbuffer->maxsize() - netbuffer->size() < len)
 	{
 		netbuffer->resize(len + netbuffer->size() + 1, false);
 	}
 
-	netbuffer->WriteChunk(msgdata, len);
-	delete [] msgdata;
+	if (len)
+		netbuffer->WriteChunk((const char *)data, len);
 
 	if (!connected)
 	{
@@ -929,17 +1099,34 @@ void NetDemo::readMessages(buf_t* netbuffer)
 	uint32_t len = 0, tic = 0;
 	
 	// get the values for type, len and tic
-	readMessageHeader(type, len, tic);
+	if (!readMessageHeader(type, len, tic))
+		seektic = -1;
 	
-	while (type == NetDemo::msg_snapshot)
+	while (type == NETDEMO_MSG_SNAPSHOT)
 	{
 		// skip over snapshots and read the next message instead
-		fseek(demofp, len, SEEK_CUR);
-		readMessageHeader(type, len, tic);
+		seekData(tellData() + len);
+		if (!readMessageHeader(type, len, tic))
+			seektic = -1;
 	}
 
+	// take a snapshot every so often so that seeking does not have to
+	// play everything since the last snapshot in the file
+	cacheKeyframe(tic, tellData() - NETDEMO_MESSAGE_HEADER_SIZE);
+
 	// read from the input file and put the data into netbuffer
 	gametic = tic;
+
+	if (type == NETDEMO_MSG_POVPACKET)
+	{
+		// an empty packet keeps the game running on tics where nothing was
+		// sent to the player being watched
+		static std::vector<byte> packet;
+		if (readPOVPacket(len, packet) || connected)
+			parseMessage(netbuffer, packet.empty() ? NULL : &packet[0], packet.size());
+		return;
+	}
+
 	readMessageBody(netbuffer, len);
 }
 
@@ -1214,7 +1401,7 @@ void NetDemo::writeConnectionSequence(buf_t *netbuffer)
 //		Returns the snapshot that preceeds the ticnum parameter or returns
 //		NULL if the ticnum is out of bounds.
 //
-const NetDemo::netdemo_index_entry_t *NetDemo::snapshotLookup(int ticnum) const
+const netdemo_index_entry_t *NetDemo::snapshotLookup(int ticnum) const
 {
 	int index = (ticnum - header.starting_gametic) / header.snapshot_spacing - 1;
 
@@ -1325,7 +1512,7 @@ void NetDemo::nextMap()
 	if (nextmapindex >= header.map_index_size)
 		return;
 
-	const NetDemo::netdemo_index_entry_t *snap = &map_index[nextmapindex];
+	const netdemo_index_entry_t *snap = &map_index[nextmapindex];
 	
 	readSnapshot(snap);
 }
@@ -1345,7 +1532,7 @@ void NetDemo::prevMap()
 	if (prevmapindex < 0)
 		prevmapindex = 0;
 
-	const NetDemo::netdemo_index_entry_t *snap = &map_index[prevmapindex];
+	const netdemo_index_entry_t *snap = &map_index[prevmapindex];
 
 	readSnapshot(snap);
 }
@@ -1360,9 +1547,10 @@ void NetDemo::readSnapshot(const netdemo_index_entry_t *snap)
 	if (!isPlaying() || !snap)
 		return;
 
+	seektic = -1;
 	gametic = snap->ticnum;
 	int file_offset = snap->offset;
-	fseek(demofp, file_offset, SEEK_SET);
+	seekData(file_offset);
 	
 	// read the values for length, gametic, and message type
 	netdemo_message_t type;
@@ -1375,8 +1563,7 @@ void NetDemo::readSnapshot(const netdemo_index_entry_t *snap)
 		return;
 	}
 		
-	size_t cnt = fread(snapbuf, 1, len, demofp);
-	if (cnt < len)
+	if (!readData(snapbuf, len))
 	{
 		fatalError("Unable to read snapshot from data file");
 		return;
@@ -1387,6 +1574,146 @@ void NetDemo::readSnapshot(const netdemo_index_entry_t *snap)
 }
 
 
+//
+// readKeyframe()
+//
+//   Restores the world state to a snapshot taken during playback
+//
+void NetDemo::readKeyframe(int ticnum, const netdemo_keyframe_t &keyframe)
+{
+	if (!isPlaying() || keyframe.data.empty())
+		return;
+
+	seektic = -1;
+	gametic = ticnum;
+	seekData(keyframe.offset);
+
+	size_t len = keyframe.data.size();
+	memcpy(snapbuf, &keyframe.data[0], len);
+
+	readSnapshotData(snapbuf, len);
+	netdemotic = ticnum - header.starting_gametic;
+}
+
+
+//
+// findKeyframe()
+//
+//   Returns the tic of the latest snapshot at or before ticnum, either from
+//   the snapshot index or taken during playback, or -1 if there is none.
+//   snap is set to the index entry for the snapshot, or NULL if the
+//   snapshot was taken during playback.
+//
+int NetDemo::findKeyframe(int ticnum, const netdemo_index_entry_t *&snap) const
+{
+	snap = NULL;
+	int keytic = -1;
+
+	// the snapshot index is in the order the snapshots were written
+	size_t lo = 0, hi = snapshot_index.size();
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if ((int)snapshot_index[mid].ticnum <= ticnum)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo > 0)
+	{
+		snap = &snapshot_index[lo - 1];
+		keytic = snap->ticnum;
+	}
+
+	std::map<int, netdemo_keyframe_t>::const_iterator it = keyframes.upper_bound(ticnum);
+	if (it != keyframes.begin())
+	{
+		--it;
+		if (it->first > keytic)
+		{
+			snap = NULL;
+			keytic = it->first;
+		}
+	}
+
+	return keytic;
+}
+
+
+//
+// cacheKeyframe()
+//
+//   Keeps a snapshot of the world in memory if the last snapshot before
+//   ticnum is more than cl_netdemokeyframespacing seconds old.  This fills
+//   in the gaps between the snapshots in the file, which are far apart in
+//   older netdemos.  offset is where the messages for ticnum start.
+//
+void NetDemo::cacheKeyframe(int ticnum, uint32_t offset)
+{
+	int spacing = cl_netdemokeyframespacing.asInt() * TICRATE;
+	if (spacing <= 0 || keyframe_memory >= NetDemo::MAX_KEYFRAME_MEMORY)
+		return;
+
+	if (!connected || gamestate != GS_LEVEL)
+		return;
+
+	const netdemo_index_entry_t *snap;
+	int keytic = findKeyframe(ticnum, snap);
+	if (keytic >= 0 && ticnum - keytic < spacing)
+		return;
+
+	size_t length;
+	writeSnapshotData(snapbuf, length);
+	if (length > NetDemo::MAX_SNAPSHOT_SIZE)
+		return;
+
+	netdemo_keyframe_t &keyframe = keyframes[ticnum];
+	keyframe.offset = offset;
+	keyframe.data.assign(snapbuf, snapbuf + length);
+	keyframe_memory += length;
+}
+
+
+//
+// seekTo()
+//
+//   Restores the latest snapshot before ticnum unless the current position
+//   is closer, and then has the demo played up to ticnum without drawing
+//   anything or playing sounds (see CL_RunTics).
+//
+bool NetDemo::seekTo(int ticnum)
+{
+	if (!isPlaying())
+		return false;
+
+	if (ticnum < (int)header.starting_gametic)
+		ticnum = header.starting_gametic;
+	if (ticnum > (int)header.ending_gametic)
+		ticnum = header.ending_gametic;
+
+	const netdemo_index_entry_t *snap;
+	int keytic = findKeyframe(ticnum, snap);
+
+	if (ticnum < gametic || keytic > gametic)
+	{
+		if (keytic < 0)
+			return false;
+
+		if (snap)
+			readSnapshot(snap);
+		else
+			readKeyframe(keytic, keyframes[keytic]);
+
+		if (!isPlaying())
+			return false;
+	}
+
+	seektic = ticnum > gametic ? ticnum : -1;
+	return true;
+}
+
+
 //
 // calculateTotalTime()
 //
@@ -1436,26 +1763,26 @@ const std::vector<int> NetDemo::getMapChangeTimes()
 
 void NetDemo::writeMapChange()
 {
-	if (connected && gamestate == GS_LEVEL)
+	if (isRecording() && connected && gamestate == GS_LEVEL)
 	{
 		size_t length;
 		writeSnapshotData(snapbuf, length);
 		writeMapIndexEntry();
 		writeSnapshotIndexEntry();
 		
-		writeChunk(snapbuf, length, NetDemo::msg_snapshot);
+		writeChunk(snapbuf, length, NETDEMO_MSG_SNAPSHOT);
 	}
 }
 
 void NetDemo::writeIntermission()
 {
-	if (connected && gamestate == GS_INTERMISSION)
+	if (isRecording() && connected && gamestate == GS_INTERMISSION)
 	{
 		size_t length;
 		writeSnapshotData(snapbuf, length);
 		writeSnapshotIndexEntry();
 		
-		writeChunk(snapbuf, length, NetDemo::msg_snapshot);
+		writeChunk(snapbuf, length, NETDEMO_MSG_SNAPSHOT);
 	}
 }
 
@@ -1672,8 +1999,7 @@ void NetDemo::writeSnapshotIndexEntry()
 	// Update the snapshot index
 	netdemo_index_entry_t entry;
 	
-	fflush(demofp);
-	entry.offset = ftell(demofp);
+	entry.offset = writer->tell();
 	entry.ticnum = gametic;
 	snapshot_index.push_back(entry);
 }
@@ -1687,8 +2013,7 @@ void NetDemo::writeMapIndexEntry()
 	// Update the map index
 	netdemo_index_entry_t entry;
 	
-	fflush(demofp);
-	entry.offset = ftell(demofp);
+	entry.offset = writer->tell();
 	entry.ticnum = gametic;
 	map_index.push_back(entry);
 }
@@ -4,9 +4,11 @@
 #include "doomtype.h"
 #include "i_net.h"
 #include "d_net.h"
+#include "d_netdemo.h"
 #include <string>
 #include <vector>
 #include <list>
+#include <map>
 
 class NetDemo
 {
@@ -16,8 +18,13 @@ public:
 	NetDemo(const NetDemo &rhs);
 	NetDemo& operator=(const NetDemo &rhs);
 	
-	bool startPlaying(const std::string &filename);
+	// Netdemos recorded by the server can be watched from any player's
+	// view, pov is that player's id or 0 for the first one recorded.
+	bool startPlaying(const std::string &filename, byte pov = 0);
 	bool startRecording(const std::string &filename);
+
+	// Rewrites a netdemo using the compression set by cl_netdemocompression
+	bool convert(const std::string &filename, const std::string &newfilename);
 	bool stopPlaying();
 	bool stopRecording();
 	bool pause();
@@ -34,12 +41,19 @@ public:
 	bool isPaused() const { return (state == NetDemo::st_paused); }
 	
 	int getSpacing() const { return header.snapshot_spacing; }
+	byte getVersion() const { return header.version; }
 	
 	void nextSnapshot();
 	void prevSnapshot();
 	void nextMap();
 	void prevMap();
 
+	// Jumps to the keyframe closest to ticnum and plays the demo up to it
+	// with rendering and sound turned off.  Returns false if not playing.
+	bool seekTo(int ticnum);
+	bool isSeeking() const { return seektic >= 0; }
+	int getStartingTic() const { return header.starting_gametic; }
+
 	void ticker();
 	int calculateTimeElapsed();
 	int calculateTotalTime();
@@ -55,12 +69,6 @@ private:
 		st_paused
 	} netdemo_state_t;
 
-	typedef enum
-	{
-		msg_packet		= 0xAA,
-		msg_snapshot
-	} netdemo_message_t;
-
 	typedef struct
 	{
 		byte		type;
@@ -68,11 +76,12 @@ private:
 		uint32_t	gametic;
 	} message_header_t;
 
+	// a snapshot taken during playback, kept in memory for seeking
 	typedef struct
 	{
-		uint32_t	ticnum;
-		uint32_t	offset;			// offset in the demo file
-	} netdemo_index_entry_t;
+		uint32_t			offset;	// offset of the next message in the demo file
+		std::vector<byte>	data;
+	} netdemo_keyframe_t;
 	
 	void cleanUp();
 	void copy(NetDemo &to, const NetDemo &from);
@@ -90,60 +99,63 @@ private:
 	void writeSnapshotIndexEntry();
 	void writeMapIndexEntry();
 	void readSnapshot(const netdemo_index_entry_t *snap);
+	void readKeyframe(int ticnum, const netdemo_keyframe_t &keyframe);
+	int findKeyframe(int ticnum, const netdemo_index_entry_t *&snap) const;
+	void cacheKeyframe(int ticnum, uint32_t offset);
 	void writeChunk(const byte *data, size_t size, netdemo_message_t type);
-	bool writeHeader();
 	bool readHeader();
+	bool readBlockTable();
+
+	bool openFile(const std::string &filename);
+	bool loadBlock(size_t index);
+	bool readData(void *data, size_t size);
+	bool seekData(uint32_t offset);
+	uint32_t tellData();
 	
 	bool atSnapshotInterval();
 	
-	bool writeSnapshotIndex();
 	bool readSnapshotIndex();
-	bool writeMapIndex();
 	bool readMapIndex();
 	int getCurrentSnapshotIndex() const;
 	int getCurrentMapIndex() const;
 	
-	void writeLocalCmd(buf_t *netbuffer) const;
-	bool readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic) const;
+	bool readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic);
 	void readMessageBody(buf_t *netbuffer, uint32_t len);
+	bool readPOVPacket(uint32_t len, std::vector<byte> &packet);
+	void parseMessage(buf_t *netbuffer, const byte *data, size_t len);
 	void writeFullUpdate(int ticnum);
 
-	typedef struct
-	{
-		char		identifier[4];  		// "ODAD"
-		byte		version;
-		byte    	compression;    		// type of compression used
-		uint16_t	snapshot_index_size;	// number of snapshots in the index
-		uint32_t	snapshot_index_offset;	// offset from start of the file for the index
-		uint16_t	map_index_size;			// number of maps in the mapindex
-		uint32_t	map_index_offset;		// offset from start of the file for the mapindex
-		uint16_t	snapshot_spacing;		// number of gametics between indices
-		uint32_t	starting_gametic;		// the gametic the demo starts at
-		uint32_t	ending_gametic;			// the last gametic of the demo
-		byte		reserved[36];   		// for future use
-	} netdemo_header_t;
-	
-	static const size_t HEADER_SIZE = 64;
-	static const size_t MESSAGE_HEADER_SIZE = 9;
-	static const size_t INDEX_ENTRY_SIZE = 8;
-
-	static const uint16_t SNAPSHOT_SPACING = 20 * TICRATE;
-
 	static const size_t MAX_SNAPSHOT_SIZE = 131072;
+
+	// memory that can be used for keyframes taken during playback
+	static const size_t MAX_KEYFRAME_MEMORY = 64 * 1024 * 1024;
 	
 	netdemo_state_t		state;
 	netdemo_state_t		oldstate;	// used when unpausing
 	std::string			filename;
-	FILE*				demofp;
+	FILE*				demofp;		// only used for playback
+
+	NetDemoWriter*		writer;		// writes the file when recording
+
+	// where each block of a compressed netdemo starts, see d_netdemo.h
+	std::vector<uint32_t> block_offsets;
+	std::vector<byte>	readblock;			// the block being read
+	int					readblock_index;
+	uint32_t			read_offset;
 
 	std::list<buf_t>	captured;
 
 	netdemo_header_t	header;	
 	std::vector<netdemo_index_entry_t> snapshot_index;
 	std::vector<netdemo_index_entry_t> map_index;
+
+	std::map<int, netdemo_keyframe_t> keyframes;
+	size_t				keyframe_memory;
 	
 	byte				snapbuf[NetDemo::MAX_SNAPSHOT_SIZE];
 	int					netdemotic;
+	int					seektic;	// tic being fast-forwarded to or -1
+	byte				pov;		// player being watched in server netdemos
 };
 
 
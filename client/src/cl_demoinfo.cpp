@@ -0,0 +1,290 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Headless netdemo analysis.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "c_console.h"
+#include "c_cvars.h"
+#include "g_game.h"
+#include "cl_demo.h"
+#include "cl_demoinfo.h"
+
+extern NetDemo netdemo;
+extern bool nodrawers, noblit;
+
+void CL_NetDemoPlay(const std::string &filename);
+void CL_QuitCommand();
+
+EXTERN_CVAR(sv_gametype)
+
+typedef struct
+{
+	std::string	name;
+	int			team;
+	bool		spectator;
+	int			frags, kills, deaths, points;
+} demoinfo_player_t;
+
+typedef struct
+{
+	std::string	name;
+	int			starttic, endtic;
+	std::vector<demoinfo_player_t> players;
+} demoinfo_map_t;
+
+typedef struct
+{
+	int			tic;
+	std::string	player;
+	bool		team;
+	std::string	message;
+} demoinfo_chat_t;
+
+static bool active = false;
+static bool complete = false;
+static std::string demofilename;
+static int starttic = -1;
+
+static std::vector<demoinfo_map_t> maps;
+static std::vector<demoinfo_chat_t> chat;
+
+//
+// CL_StartNetDemoInfo
+//
+// Plays the netdemo without drawing anything and as fast as possible.
+//
+void CL_StartNetDemoInfo(const std::string &filename)
+{
+	nodrawers = noblit = true;
+	timingdemo = true;
+
+	active = true;
+	complete = false;
+	maps.clear();
+	chat.clear();
+
+	CL_NetDemoPlay(filename);
+
+	if (netdemo.isPlaying())
+		demofilename = netdemo.getFileName();
+	starttic = netdemo.getStartingTic();
+}
+
+//
+// CL_NetDemoInfoEndMap
+//
+// Keeps the scores of the map that is being left.
+//
+static void CL_NetDemoInfoEndMap()
+{
+	if (maps.empty() || maps.back().endtic >= 0)
+		return;
+
+	demoinfo_map_t &map = maps.back();
+	map.endtic = gametic;
+
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (!it->ingame())
+			continue;
+
+		demoinfo_player_t player;
+		player.name = it->userinfo.netname;
+		player.team = it->userinfo.team;
+		player.spectator = it->spectator;
+		player.frags = it->fragcount;
+		player.kills = it->killcount;
+		player.deaths = it->deathcount;
+		player.points = it->points;
+
+		map.players.push_back(player);
+	}
+}
+
+void CL_NetDemoInfoNewMap(const char *mapname)
+{
+	if (!active)
+		return;
+
+	CL_NetDemoInfoEndMap();
+
+	demoinfo_map_t map;
+	map.name = mapname;
+	map.starttic = gametic;
+	map.endtic = -1;
+
+	maps.push_back(map);
+}
+
+void CL_NetDemoInfoSay(player_t &player, bool team, const char *message)
+{
+	if (!active)
+		return;
+
+	demoinfo_chat_t line;
+	line.tic = gametic;
+	line.player = player.userinfo.netname;
+	line.team = team;
+	line.message = message;
+
+	chat.push_back(line);
+}
+
+//
+// CL_NetDemoInfoEnd
+//
+// Called when the end of the netdemo is read, before the players are
+// cleared.
+//
+void CL_NetDemoInfoEnd()
+{
+	if (!active)
+		return;
+
+	CL_NetDemoInfoEndMap();
+	complete = true;
+}
+
+//
+// CL_JSONString
+//
+static std::string CL_JSONString(const std::string &str)
+{
+	std::string out = "\"";
+
+	for (size_t i = 0; i < str.length(); i++)
+	{
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (c < 0x20)
+		{
+			char buf[8];
+			sprintf(buf, "\\u%04x", c);
+			out += buf;
+		}
+		else
+		{
+			out += c;
+		}
+	}
+
+	return out + "\"";
+}
+
+static double CL_DemoSeconds(int tic)
+{
+	return double(tic - starttic) / TICRATE;
+}
+
+//
+// CL_WriteNetDemoInfo
+//
+// Writes the summary to the netdemo's file name with .json in place of
+// the .odd extension.
+//
+static bool CL_WriteNetDemoInfo(const std::string &filename)
+{
+	FILE *fp = fopen(filename.c_str(), "w");
+	if (fp == NULL)
+		return false;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"file\": %s,\n", CL_JSONString(demofilename).c_str());
+	fprintf(fp, "\t\"complete\": %s,\n", complete ? "true" : "false");
+	fprintf(fp, "\t\"gametype\": %d,\n", sv_gametype.asInt());
+
+	fprintf(fp, "\t\"maps\": [");
+	for (size_t i = 0; i < maps.size(); i++)
+	{
+		const demoinfo_map_t &map = maps[i];
+		int endtic = map.endtic >= 0 ? map.endtic : gametic;
+
+		fprintf(fp, "%s\n\t\t{\n", i ? "," : "");
+		fprintf(fp, "\t\t\t\"map\": %s,\n", CL_JSONString(map.name).c_str());
+		fprintf(fp, "\t\t\t\"start\": %.2f,\n", CL_DemoSeconds(map.starttic));
+		fprintf(fp, "\t\t\t\"end\": %.2f,\n", CL_DemoSeconds(endtic));
+
+		fprintf(fp, "\t\t\t\"players\": [");
+		for (size_t j = 0; j < map.players.size(); j++)
+		{
+			const demoinfo_player_t &player = map.players[j];
+
+			fprintf(fp, "%s\n\t\t\t\t{ \"name\": %s, \"team\": %d, \"spectator\": %s, "
+				"\"frags\": %d, \"kills\": %d, \"deaths\": %d, \"points\": %d }",
+				j ? "," : "", CL_JSONString(player.name).c_str(), player.team,
+				player.spectator ? "true" : "false",
+				player.frags, player.kills, player.deaths, player.points);
+		}
+		fprintf(fp, "%s]\n\t\t}", map.players.empty() ? "" : "\n\t\t\t");
+	}
+	fprintf(fp, "%s],\n", maps.empty() ? "" : "\n\t");
+
+	fprintf(fp, "\t\"chat\": [");
+	for (size_t i = 0; i < chat.size(); i++)
+	{
+		const demoinfo_chat_t &line = chat[i];
+
+		fprintf(fp, "%s\n\t\t{ \"time\": %.2f, \"player\": %s, \"team\": %s, \"message\": %s }",
+			i ? "," : "", CL_DemoSeconds(line.tic), CL_JSONString(line.player).c_str(),
+			line.team ? "true" : "false", CL_JSONString(line.message).c_str());
+	}
+	fprintf(fp, "%s]\n", chat.empty() ? "" : "\n\t");
+
+	fprintf(fp, "}\n");
+
+	return fclose(fp) == 0;
+}
+
+void CL_NetDemoInfoTicker()
+{
+	if (!active || netdemo.isPlaying() || netdemo.isPaused())
+		return;
+
+	active = false;
+
+	std::string filename = demofilename;
+	if (filename.length() >= 4 && filename.compare(filename.length() - 4, 4, ".odd") == 0)
+		filename.erase(filename.length() - 4);
+	filename += ".json";
+
+	if (demofilename.empty())
+		Printf(PRINT_HIGH, "netdemoinfo: unable to play netdemo\n");
+	else if (!CL_WriteNetDemoInfo(filename))
+		Printf(PRINT_HIGH, "netdemoinfo: unable to write %s\n", filename.c_str());
+	else
+		Printf(PRINT_HIGH, "netdemoinfo: %s %s\n", filename.c_str(),
+			complete ? "complete" : "incomplete");
+
+	CL_QuitCommand();
+}
+
+VERSION_CONTROL (cl_demoinfo_cpp, "$Id$")
@@ -0,0 +1,47 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Headless netdemo analysis.
+//
+//	With -netdemoinfo, the client plays a netdemo as fast as it can
+//	without drawing anything, writes a JSON summary of the maps, scores
+//	and chat next to the netdemo and quits.  Run one client per netdemo
+//	to go through many of them at once.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __CL_DEMOINFO_H__
+#define __CL_DEMOINFO_H__
+
+#include <string>
+
+class player_s;
+typedef player_s player_t;
+
+void CL_StartNetDemoInfo(const std::string &filename);
+
+// called by the message parser while the netdemo plays
+void CL_NetDemoInfoNewMap(const char *mapname);
+void CL_NetDemoInfoSay(player_t &player, bool team, const char *message);
+void CL_NetDemoInfoEnd();
+
+// writes the summary and quits once the netdemo has stopped
+void CL_NetDemoInfoTicker();
+
+#endif	// __CL_DEMOINFO_H__
@@ -22,8 +22,10 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <map>
 #include <sstream>
 #include <iomanip>
+#include <vector>
 
 #include "c_dispatch.h"
 #include "cmdlib.h"
@@ -31,6 +33,7 @@
 #include "d_main.h"
 #include "i_net.h"
 #include "i_system.h"
+#include "i_filewriter.h"
 #include "md5.h"
 #include "m_argv.h"
 #include "m_fileio.h"
@@ -45,6 +48,9 @@ EXTERN_CVAR (cl_waddownloaddir)
 
 void CL_Reconnect(void);
 
+// chunks after the first missing one that are acknowledged with clc_wadack
+#define DOWNLOAD_ACK_BYTES	32
+
 // GhostlyDeath <October 26, 2008> -- VC6 Compiler Error
 // C2552: 'identifier' : non-aggregates cannot be initialized with initializer list
 // What does this mean? VC6 considers std::string non-static (that it changes every time?)
@@ -65,14 +71,21 @@ struct download_s
 	public:
 		std::string filename;
 		std::string md5;
-		buf_t *buf;
-		size_t got_bytes;
+		std::string partname;	// file the download is written to
+		FileWriter file;
+		size_t length;
+		size_t got_bytes;		// everything before this has been received
+		size_t received;		// bytes received in total
+		size_t chunk_size;
+		std::vector<bool> chunks;	// which chunks have been received
+		std::map<size_t, std::string> pending;	// chunks past got_bytes, not hashed yet
+		md5_state_t md5state;	// of everything before got_bytes
+		bool started;
         dtime_t timeout;
 		int retrycount;
 		
 		download_s()
 		{
-			buf = NULL;
 			this->clear();
 			timeout = 0;
 		}
@@ -83,20 +96,40 @@ struct download_s
 
 		void clear()
 		{
+			file.close();
+
 			filename = "";
 			md5 = "";
+			partname = "";
+			length = 0;
 			got_bytes = 0;
+			received = 0;
+			chunk_size = 0;
+			chunks.clear();
+			pending.clear();
+			md5_init(&md5state);
+			started = false;
             timeout = 0;
             retrycount = 0;
-            
-			if (buf != NULL)
-			{
-				delete buf;
-				buf = NULL;
-			}
 		}
 } download;
 
+// What is saved next to a partial download, so a download can be resumed
+// after the client was restarted.  Only read back by the same build.
+struct download_state_t
+{
+	char			magic[4];
+	unsigned int	length;
+	unsigned int	chunk_size;
+	unsigned int	got_bytes;
+	char			md5[33];
+	md5_state_t		md5state;
+};
+
+static const char download_state_magic[4] = { 'O', 'D', 'P', 'D' };
+
+// save the state of a partial download every time this much more arrived
+#define DOWNLOAD_STATE_INTERVAL	(1024 * 1024)
 
 extern std::string DownloadStr;
 
@@ -142,22 +175,190 @@ void ClearDownloadProgressBar()
 }
 
 
+//
+// CL_GetDownloadDirs
+//
+static void CL_GetDownloadDirs(std::vector<std::string> &dirs)
+{
+#ifdef _WIN32
+    const char separator = ';';
+#else
+    const char separator = ':';
+#endif
+
+    // Try to save to the wad paths in this order -- Hyper_Eye
+    D_AddSearchDir(dirs, cl_waddownloaddir.cstring(), separator);
+    D_AddSearchDir(dirs, Args.CheckValue("-waddir"), separator);
+    D_AddSearchDir(dirs, getenv("DOOMWADDIR"), separator);
+    D_AddSearchDir(dirs, getenv("DOOMWADPATH"), separator);
+    D_AddSearchDir(dirs, waddirs.cstring(), separator);
+    dirs.push_back(startdir);
+    dirs.push_back(progdir);
+
+    dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+}
+
+static std::string CL_DownloadStateName()
+{
+	return download.partname + ".state";
+}
+
+//
+// CL_SaveDownloadState
+//
+// Remember how far the download got.  The chunks are flushed to the disk
+// first so the state never claims more than the partial file holds.
+//
+static void CL_SaveDownloadState()
+{
+	if (download.partname.empty() || download.md5.empty())
+		return;
+
+	download.file.flush();
+	if (download.file.failed())
+		return;
+
+	download_state_t state;
+	memset(&state, 0, sizeof(state));
+
+	memcpy(state.magic, download_state_magic, sizeof(state.magic));
+	state.length = download.length;
+	state.chunk_size = download.chunk_size;
+	state.got_bytes = download.got_bytes;
+	strncpy(state.md5, download.md5.c_str(), sizeof(state.md5) - 1);
+	state.md5state = download.md5state;
+
+	M_WriteFile(CL_DownloadStateName(), &state, sizeof(state));
+}
+
+//
+// CL_LoadDownloadState
+//
+static bool CL_LoadDownloadState(download_state_t &state)
+{
+	if (download.md5.empty())
+		return false;
+
+	FILE *fp = fopen(CL_DownloadStateName().c_str(), "rb");
+	if (!fp)
+		return false;
+
+	bool ok = fread(&state, 1, sizeof(state), fp) == sizeof(state);
+	fclose(fp);
+
+	state.md5[sizeof(state.md5) - 1] = 0;
+
+	return ok && !memcmp(state.magic, download_state_magic, sizeof(state.magic)) &&
+		download.md5 == state.md5 && state.chunk_size &&
+		state.got_bytes <= state.length;
+}
+
+//
+// CL_RemovePartialDownload
+//
+static void CL_RemovePartialDownload()
+{
+	download.file.close();
+
+	if (download.partname.empty())
+		return;
+
+	remove(CL_DownloadStateName().c_str());
+	remove(download.partname.c_str());
+}
+
+//
+// CL_OpenPartialDownload
+//
+// Open the temporary file the download goes into, picking up where a
+// previous attempt left off if it was for the same file.
+//
+static bool CL_OpenPartialDownload()
+{
+	std::vector<std::string> dirs;
+	CL_GetDownloadDirs(dirs);
+
+	download.file.close();
+	download.length = 0;
+	download.got_bytes = 0;
+	download.received = 0;
+	download.chunk_size = 0;
+	download.chunks.clear();
+	download.pending.clear();
+	md5_init(&download.md5state);
+
+	for (size_t i = 0; i < dirs.size(); i++)
+	{
+		std::string dir = dirs[i];
+		if (dir[dir.length() - 1] != PATHSEPCHAR)
+			dir += PATHSEP;
+
+		download.partname = dir + download.filename + ".part";
+
+		download_state_t state;
+		bool resume = CL_LoadDownloadState(state);
+
+		if (!download.file.open(download.partname, !resume))
+			continue;
+
+		if (resume)
+		{
+			download.length = state.length;
+			download.chunk_size = state.chunk_size;
+			download.got_bytes = download.received = state.got_bytes;
+			download.md5state = state.md5state;
+			download.chunks.assign((state.length + state.chunk_size - 1) / state.chunk_size, false);
+
+			for (size_t j = 0; j < state.got_bytes / state.chunk_size; j++)
+				download.chunks[j] = true;
+		}
+
+		return true;
+	}
+
+	download.partname = "";
+	return false;
+}
+
 void IntDownloadComplete(void)
 {
-    std::string actual_md5 = MD5SUM(download.buf->ptr(), download.buf->maxsize());
+	bool written = download.file.close();
+
+	md5_byte_t digest[16];
+	md5_finish(&download.md5state, digest);
+
+	std::stringstream hash;
+	for (int i = 0; i < 16; i++)
+		hash << std::setw(2) << std::setfill('0') << std::hex << std::uppercase << (short)digest[i];
+
+    std::string actual_md5 = hash.str();
 
-	Printf(PRINT_HIGH, "\nDownload complete, got %u bytes\n", download.buf->maxsize());
+	Printf(PRINT_HIGH, "\nDownload complete, got %u bytes\n", download.length);
 	Printf(PRINT_HIGH, "%s\n %s\n", download.filename.c_str(), actual_md5.c_str());
 
+	if (!written)
+	{
+		Printf(PRINT_HIGH, "Download failed: could not write %s\n", download.partname.c_str());
+
+		CL_RemovePartialDownload();
+		download.clear();
+        CL_QuitNetGame();
+
+        ClearDownloadProgressBar();
+
+        return;
+	}
+
 	if(download.md5 == "")
 	{
-		Printf(PRINT_HIGH, "Server gave no checksum, assuming valid\n", (int)download.buf->maxsize());
+		Printf(PRINT_HIGH, "Server gave no checksum, assuming valid\n");
 	}
 	else if(actual_md5 != download.md5)
 	{
 		Printf(PRINT_HIGH, " %s on server\n", download.md5.c_str());
 		Printf(PRINT_HIGH, "Download failed: bad checksum\n");
 
+		CL_RemovePartialDownload();
 		download.clear();
         CL_QuitNetGame();
 
@@ -166,55 +367,29 @@ void IntDownloadComplete(void)
         return;
     }
 
-    // got the wad! save it!
-    std::vector<std::string> dirs;
-    std::string filename;
-    size_t i;
-#ifdef _WIN32
-    const char separator = ';';
-#else
-    const char separator = ':';
-#endif
-
-    // Try to save to the wad paths in this order -- Hyper_Eye
-    D_AddSearchDir(dirs, cl_waddownloaddir.cstring(), separator);
-    D_AddSearchDir(dirs, Args.CheckValue("-waddir"), separator);
-    D_AddSearchDir(dirs, getenv("DOOMWADDIR"), separator);
-    D_AddSearchDir(dirs, getenv("DOOMWADPATH"), separator);
-    D_AddSearchDir(dirs, waddirs.cstring(), separator);
-    dirs.push_back(startdir);
-    dirs.push_back(progdir);
-
-    dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+    // got the wad! move it into place next to the partial download
+    std::string filename = download.partname.substr(0, download.partname.length() - 5);
 
-    for(i = 0; i < dirs.size(); i++)
+    // check for existing file
+    if(M_FileExists(filename))
     {
-        filename.clear();
-        filename = dirs[i];
-        if(filename[filename.length() - 1] != PATHSEPCHAR)
-            filename += PATHSEP;
-        filename += download.filename;
-
-        // check for existing file
-   	    if(M_FileExists(filename))
-   	    {
-   	        // there is an existing file, so use a new file whose name includes the checksum
-   	        filename += ".";
-   	        filename += actual_md5;
-   	    }
-
-        if (M_WriteFile(filename, download.buf->ptr(), download.buf->maxsize()))
-            break;
+        // there is an existing file, so use a new file whose name includes the checksum
+        filename += ".";
+        filename += actual_md5;
     }
 
     // Unable to write
-    if(i == dirs.size())
+    if (rename(download.partname.c_str(), filename.c_str()) != 0)
     {
+		Printf(PRINT_HIGH, "Unable to save download as \"%s\"\n", filename.c_str());
+
 		download.clear();
         CL_QuitNetGame();
         return;
     }
 
+	remove(CL_DownloadStateName().c_str());
+
     Printf(PRINT_HIGH, "Saved download as \"%s\"\n", filename.c_str());
 
 	download.clear();
@@ -234,13 +409,23 @@ void CL_RequestDownload(std::string filename, std::string filehash)
 	{
 		// [Russell] - Allow resumeable downloads
 		if ((download.filename != filename) ||
-			(download.md5 != filehash))
+			(download.md5 != filehash) || !download.file.isOpen())
 		{
+			download.clear();
 			download.filename = filename;
 			download.md5 = filehash;
-			download.got_bytes = 0;
+
+			if (!CL_OpenPartialDownload())
+			{
+				Printf(PRINT_HIGH, "Unable to write %s to any wad directory\n", filename.c_str());
+				download.clear();
+				CL_QuitNetGame();
+				return;
+			}
 		}
 
+		download.started = false;
+
 		// denis todo clear previous downloads
 		MSG_WriteMarker(&net_buffer, clc_wantwad);
 		MSG_WriteString(&net_buffer, filename.c_str());
@@ -257,8 +442,7 @@ void CL_RequestDownload(std::string filename, std::string filehash)
 		// reconnect a couple of times and this will let the checksum system do its
 		// work
 
-		if ((download.buf != NULL) &&
-			(download.got_bytes >= download.buf->maxsize()))
+		if (download.length && download.got_bytes >= download.length)
 		{
 			IntDownloadComplete();
 		}
@@ -272,6 +456,7 @@ void CL_RequestDownload(std::string filename, std::string filehash)
 void CL_DownloadStart()
 {
 	DWORD file_len = MSG_ReadLong();
+	size_t chunk_size = (unsigned short)MSG_ReadShort();
 
 	if(gamestate != GS_DOWNLOAD)
 	{
@@ -279,6 +464,17 @@ void CL_DownloadStart()
 		return;
 	}
 
+	// the server repeats this until it hears back from us
+	if (download.started)
+		return;
+
+	if (chunk_size == 0)
+	{
+		Printf(PRINT_HIGH, "Bad download chunk size, aborting\n");
+		CL_QuitNetGame();
+		return;
+	}
+
 	// don't go for more than 100 megs
 	if(file_len > 100*1024*1024)
 	{
@@ -287,23 +483,44 @@ void CL_DownloadStart()
 		return;
 	}
 
+	if (!download.file.isOpen())
+	{
+		Printf(PRINT_HIGH, "Download was not requested, aborting\n");
+		CL_QuitNetGame();
+		return;
+	}
+
     // [Russell] - Allow resumeable downloads
-	if (download.got_bytes == 0)
+	if (download.length != file_len || download.chunk_size != chunk_size)
     {
-        if (download.buf != NULL)
-        {
-            delete download.buf;
-            download.buf = NULL;
-        }
+		bool resumed = download.got_bytes != 0;
 
-        download.buf = new buf_t ((size_t)file_len);
+		// start over with an empty file
+		download.file.open(download.partname, true);
 
-        memset(download.buf->ptr(), 0, file_len);
-    }
-    else
-        Printf(PRINT_HIGH, "Resuming download of %s...\n", download.filename.c_str());
+		download.length = file_len;
+		download.got_bytes = 0;
+		download.received = 0;
+		download.chunk_size = chunk_size;
+		download.chunks.assign((file_len + chunk_size - 1) / chunk_size, false);
+		download.pending.clear();
+		md5_init(&download.md5state);
+
+		// the server is sending from where we asked it to
+		if (resumed)
+		{
+			MSG_WriteMarker(&net_buffer, clc_wantwad);
+			MSG_WriteString(&net_buffer, download.filename.c_str());
+			MSG_WriteString(&net_buffer, download.md5.c_str());
+			MSG_WriteLong(&net_buffer, 0);
 
+			NET_SendPacket(net_buffer, serveraddr);
+		}
+	}
+	else if (download.received)
+		Printf(PRINT_HIGH, "Resuming download of %s...\n", download.filename.c_str());
 
+	download.started = true;
 
 	Printf(PRINT_HIGH, "Downloading %s bytes...\n",
         FormatNBytes(file_len).c_str());
@@ -373,6 +590,36 @@ void CL_DownloadTicker()
     }
 }
 
+//
+// CL_DownloadAck
+//
+// Tell the server how much of the file we have from the start, followed by
+// which of the chunks after the first missing one have arrived.
+//
+static void CL_DownloadAck()
+{
+	byte received[DOWNLOAD_ACK_BYTES];
+	size_t len = 0;
+
+	memset(received, 0, sizeof(received));
+
+	size_t base = download.got_bytes / download.chunk_size + 1;
+
+	for (size_t i = 0; i < sizeof(received) * 8 && base + i < download.chunks.size(); i++)
+	{
+		if (download.chunks[base + i])
+		{
+			received[i / 8] |= 1 << (i % 8);
+			len = i / 8 + 1;
+		}
+	}
+
+	MSG_WriteMarker(&net_buffer, clc_wadack);
+	MSG_WriteLong(&net_buffer, download.got_bytes);
+	MSG_WriteByte(&net_buffer, len);
+	MSG_WriteChunk(&net_buffer, received, len);
+}
+
 //
 // CL_Download
 // denis - get a little chunk of the file and store it, much like a hampster. Well, hamster; but hampsters can dance and sing. Also much like Scraps, the Ice Age squirrel thing, stores his acorn. Only with a bit more success. Actually, quite a bit more success, specifically as in that the world doesn't crack apart when we store our chunk and it does when Scraps stores his (or her?) acorn. But when Scraps does it, it is funnier. The rest of Ice Age mostly sucks.
@@ -387,19 +634,15 @@ void CL_Download()
 	if(gamestate != GS_DOWNLOAD)
 		return;
 
-	if (download.buf == NULL)
-	{
-		// We must have not received the svc_wadinfo message
-		Printf(PRINT_HIGH, "Unable to start download, aborting\n");
-		download.clear();
-		CL_QuitNetGame();
+	// svc_wadinfo went missing, the server sends it again
+	if (!download.started)
 		return;
-	}
 
 	// check ranges
-	if(offset + len > download.buf->maxsize() || len > left || p == NULL)
+	if(offset + len > download.length || len == 0 || len > left || p == NULL ||
+	   offset % download.chunk_size != 0 || len > download.chunk_size)
 	{
-		Printf(PRINT_HIGH, "Bad download packet (%d, %d) encountered (%d), aborting\n", (int)offset, (int)left, (int)download.buf->size());
+		Printf(PRINT_HIGH, "Bad download packet (%d, %d) encountered (%d), aborting\n", (int)offset, (int)left, (int)download.length);
 
 		download.clear();
 		CL_QuitNetGame();
@@ -408,32 +651,49 @@ void CL_Download()
 
 	// Reset retransmission timer
 	CL_DownloadTick();
-	
-	if (offset < download.got_bytes)
-        return;
-	
-	// check for missing packet, re-request
-	if(offset > download.got_bytes)
+
+	size_t chunk = offset / download.chunk_size;
+
+	// duplicates only need acknowledging again
+	if (!download.chunks[chunk])
 	{
-		DPrintf("Missed a packet after %d bytes (got %d), re-requesting\n", download.got_bytes, offset);
-		MSG_WriteMarker(&net_buffer, clc_wantwad);
-		MSG_WriteString(&net_buffer, download.filename.c_str());
-		MSG_WriteString(&net_buffer, download.md5.c_str());
-		MSG_WriteLong(&net_buffer, download.got_bytes);
-		NET_SendPacket(net_buffer, serveraddr);
-		return;
+		download.file.write(p, len, offset);
+		download.chunks[chunk] = true;
+		download.received += len;
+
+		// hash everything that is contiguous now
+		if (offset == download.got_bytes)
+		{
+			size_t old_bytes = download.got_bytes;
+
+			md5_append(&download.md5state, (const md5_byte_t *)p, len);
+			download.got_bytes += len;
+
+			std::map<size_t, std::string>::iterator it;
+			while ((it = download.pending.find(download.got_bytes)) != download.pending.end())
+			{
+				md5_append(&download.md5state, (const md5_byte_t *)it->second.data(), it->second.size());
+				download.got_bytes += it->second.size();
+				download.pending.erase(it);
+			}
+
+			if (old_bytes / DOWNLOAD_STATE_INTERVAL != download.got_bytes / DOWNLOAD_STATE_INTERVAL)
+				CL_SaveDownloadState();
+		}
+		else
+		{
+			download.pending[offset].assign((const char *)p, len);
+		}
 	}
 
-	// send keepalive
-	NET_SendPacket(net_buffer, serveraddr);
+	CL_DownloadAck();
 
-	// copy into downloaded buffer
-	memcpy(download.buf->ptr() + offset, p, len);
-	download.got_bytes += len;
+	// send ack and keepalive
+	NET_SendPacket(net_buffer, serveraddr);
 
 	// calculate percentage for the user
 	static size_t old_percent = 0;
-	size_t percent = (download.got_bytes*100)/download.buf->maxsize();
+	size_t percent = (download.received*100)/download.length;
 	if(percent != old_percent)
 	{
         SetDownloadPercentage(percent);
@@ -446,7 +706,7 @@ void CL_Download()
 	// pause at 100% if the server disconnected you previously, you can
 	// reconnect a couple of times and this will let the checksum system do its
 	// work
-	if(download.got_bytes >= download.buf->maxsize())
+	if(download.got_bytes >= download.length)
 	{
         IntDownloadComplete();
 	}
@@ -52,6 +52,7 @@
 #include "m_fileio.h"
 #include "r_sky.h"
 #include "cl_demo.h"
+#include "cl_demoinfo.h"
 #include "cl_download.h"
 #include "p_local.h"
 #include "cl_maplist.h"
@@ -69,6 +70,7 @@
 #include "v_text.h"
 #include "hu_stuff.h"
 #include "p_acs.h"
+#include "m_bitstream.h"
 
 #include <string>
 #include <vector>
@@ -120,6 +122,10 @@ netadr_t  lastconaddr;
 int       packetseq[256];
 byte      packetnum;
 
+// highest sequence received and which of the 32 before it arrived
+int          ack_sequence;
+unsigned int ack_received;
+
 // denis - unique session key provided by the server
 std::string digest;
 
@@ -714,8 +720,14 @@ void CL_RunTics()
 	else
 	{
 		CL_StepTics(1);
+
+		// finish seeking through a netdemo before anything is drawn again
+		while (netdemo.isSeeking() && netdemo.isPlaying())
+			CL_StepTics(1);
 	}
 
+	CL_NetDemoInfoTicker();
+
 	if (!connected)
 		CL_RequestConnectInfo();
 
@@ -1141,6 +1153,7 @@ std::string CL_GenerateNetDemoFileName(const std::string &filename = cl_netdemon
 
 void CL_NetDemoStop()
 {
+	CL_NetDemoInfoEnd();
 	netdemo.stopPlaying();
 }
 
@@ -1149,7 +1162,13 @@ void CL_NetDemoRecord(const std::string &filename)
 	netdemo.startRecording(filename);
 }
 
-void CL_NetDemoPlay(const std::string &filename)
+//
+// CL_NetDemoFileName
+//
+// Looks for a netdemo in the default path if no path is given, adding .odd
+// to the name if needed.
+//
+static std::string CL_NetDemoFileName(const std::string &filename)
 {
 	std::string newfilename;
 
@@ -1171,7 +1190,12 @@ void CL_NetDemoPlay(const std::string &filename)
 			M_AppendExtension(newfilename, ".odd", false);
 	}
 
-	netdemo.startPlaying(newfilename);
+	return newfilename;
+}
+
+void CL_NetDemoPlay(const std::string &filename)
+{
+	netdemo.startPlaying(CL_NetDemoFileName(filename));
 }
 
 BEGIN_COMMAND(stopnetdemo)
@@ -1234,7 +1258,7 @@ BEGIN_COMMAND(netplay)
 {
 	if(argc <= 1)
 	{
-		Printf(PRINT_HIGH, "Usage: netplay <demoname>\n");
+		Printf(PRINT_HIGH, "Usage: netplay <demoname> [player id]\n");
 		return;
 	}
 
@@ -1247,10 +1271,40 @@ BEGIN_COMMAND(netplay)
 	connected = false;
 
 	std::string filename = argv[1];
-	CL_NetDemoPlay(filename);
+
+	// netdemos recorded by the server can be watched as any player
+	byte pov = argc > 2 ? (byte)clamp(atoi(argv[2]), 0, MAXPLAYERS) : 0;
+	netdemo.startPlaying(CL_NetDemoFileName(filename), pov);
 }
 END_COMMAND(netplay)
 
+BEGIN_COMMAND(netconvert)
+{
+	if (argc <= 1)
+	{
+		Printf(PRINT_HIGH, "Usage: netconvert <demoname> [newname]\n");
+		Printf(PRINT_HIGH, "Rewrites a netdemo using the compression set by cl_netdemocompression.\n");
+		return;
+	}
+
+	std::string filename = CL_NetDemoFileName(argv[1]);
+	std::string newfilename;
+	if (argc > 2)
+		newfilename = argv[2];
+
+	if ((netdemo.isPlaying() || netdemo.isPaused() || netdemo.isRecording()) &&
+		netdemo.getFileName() == filename)
+	{
+		Printf(PRINT_HIGH, "Can not convert a netdemo that is in use.\n");
+		return;
+	}
+
+	NetDemo *converter = new NetDemo;
+	converter->convert(filename, newfilename);
+	delete converter;
+}
+END_COMMAND(netconvert)
+
 BEGIN_COMMAND(netdemostats)
 {
 	if (!netdemo.isPlaying() && !netdemo.isPaused())
@@ -1276,18 +1330,42 @@ END_COMMAND(netdemostats)
 
 BEGIN_COMMAND(netff)
 {
-	if (netdemo.isPlaying())
+	if (!netdemo.isPlaying())
+		return;
+
+	if (argc > 1)
+		netdemo.seekTo(gametic + int(atof(argv[1]) * TICRATE));
+	else
 		netdemo.nextSnapshot();
 }
 END_COMMAND(netff)
 
 BEGIN_COMMAND(netrew)
 {
-	if (netdemo.isPlaying())
+	if (!netdemo.isPlaying())
+		return;
+
+	if (argc > 1)
+		netdemo.seekTo(gametic - int(atof(argv[1]) * TICRATE));
+	else
 		netdemo.prevSnapshot();
 }
 END_COMMAND(netrew)
 
+BEGIN_COMMAND(netseek)
+{
+	if (argc <= 1)
+	{
+		Printf(PRINT_HIGH, "Usage: netseek <seconds>\n");
+		Printf(PRINT_HIGH, "Jumps to the given time from the start of the netdemo.\n");
+		return;
+	}
+
+	if (netdemo.isPlaying())
+		netdemo.seekTo(netdemo.getStartingTic() + int(atof(argv[1]) * TICRATE));
+}
+END_COMMAND(netseek)
+
 BEGIN_COMMAND(netnextmap)
 {
 	if (netdemo.isPlaying())
@@ -1712,8 +1790,12 @@ bool CL_Connect(void)
 	memset(packetseq, -1, sizeof(packetseq) );
 	packetnum = 0;
 
+	ack_sequence = -1;
+	ack_received = 0;
+
 	MSG_WriteMarker(&net_buffer, clc_ack);
-	MSG_WriteLong(&net_buffer, 0);
+	MSG_WriteLong(&net_buffer, ack_sequence);
+	MSG_WriteLong(&net_buffer, ack_received);
 
 	if (gamestate == GS_DOWNLOAD && missing_file.length())
 		CL_RequestDownload(missing_file, missing_hash);
@@ -1889,6 +1971,8 @@ void CL_Say()
 	if (!validplayer(player))
 		return;
 
+	CL_NetDemoInfoSay(player, message_visibility == 1, message);
+
 	bool spectator = player.spectator || player.playerstate == PST_DOWNLOAD;
 
 	if (consoleplayer().id != player.id)
@@ -2380,6 +2464,7 @@ void CL_SpawnPlayer()
 
 		// [SL] 2012-04-23 - Clear predicted sectors
 		movingsectors.clear();
+		CL_ClearPredictionCheckpoints();
 	}
 
 	if (p->id == displayplayer().id)
@@ -2445,18 +2530,40 @@ void CL_PlayerInfo(void)
 //
 // CL_SetMobjSpeedAndAngle
 //
+// Netdemos older than version 5 have the message unpacked.
+//
 void CL_SetMobjSpeedAndAngle(void)
 {
 	AActor *mo;
 	int     netid;
+	angle_t angle;
+	fixed_t momx = 0, momy = 0, momz = 0;
 
-	netid = MSG_ReadShort();
-	mo = P_FindThingById(netid);
+	if ((netdemo.isPlaying() || netdemo.isPaused()) && netdemo.getVersion() < 5)
+	{
+		netid = MSG_ReadShort();
+		angle = MSG_ReadLong();
+		momx = MSG_ReadLong();
+		momy = MSG_ReadLong();
+		momz = MSG_ReadLong();
+	}
+	else
+	{
+		BitReader bits(net_message);
+		netid = bits.ReadBits(16);
+		angle = bits.ReadAngle(16);
 
-	angle_t angle = MSG_ReadLong();
-	fixed_t momx = MSG_ReadLong();
-	fixed_t momy = MSG_ReadLong();
-	fixed_t momz = MSG_ReadLong();
+		if (bits.ReadBool())
+		{
+			momx = bits.ReadVarInt();
+			momy = bits.ReadVarInt();
+			momz = bits.ReadVarInt();
+		}
+
+		bits.Align();
+	}
+
+	mo = P_FindThingById(netid);
 
 	if (!mo)
 		return;
@@ -3003,6 +3110,11 @@ void CL_CheckMissedPacket(void)
 			return;
 		}
 	}
+
+	// the original packet may still turn up late, so make sure it
+	// gets skipped as well
+	packetseq[packetnum] = sequence;
+	packetnum++;
 }
 
 // Decompress the packet sequence
@@ -3030,6 +3142,8 @@ void CL_Decompress(int sequence)
 
 	if(method & minilzo_mask)
 		MSG_DecompressMinilzo();
+	else if(method & static_huffman_mask)
+		MSG_DecompressStatic();
 #if 0
 	if(method & adaptive_record_mask)
 		compressor.ack_sent(net_message.ptr(), MSG_BytesLeft());
@@ -3039,17 +3153,59 @@ void CL_Decompress(int sequence)
 //
 // CL_ReadPacketHeader
 //
-void CL_ReadPacketHeader(void)
+// Returns false if the packet has already been received, either itself or
+// as the svc_missedpacket copy of its reliable data, and must be skipped.
+//
+bool CL_ReadPacketHeader(void)
 {
-	unsigned int sequence = MSG_ReadLong();
+	int sequence = MSG_ReadLong();
+
+	bool duplicate = (sequence == ack_sequence);
+	if (sequence < ack_sequence && ack_sequence - sequence <= 32 &&
+		(ack_received & (1u << (ack_sequence - sequence - 1))))
+		duplicate = true;
+
+	for (int n = 0; n < 256 && !duplicate; n++)
+	{
+		if (packetseq[n] == sequence)
+			duplicate = true;
+	}
+
+	// note the packet in the selective acknowledgement
+	if (sequence > ack_sequence)
+	{
+		int shift = sequence - ack_sequence;
+
+		if (ack_sequence < 0 || shift > 32)
+			ack_received = 0;
+		else
+			ack_received = ((shift < 32 ? ack_received << shift : 0) | (1u << (shift - 1)));
+
+		ack_sequence = sequence;
+	}
+	else if (sequence < ack_sequence && ack_sequence - sequence <= 32)
+	{
+		ack_received |= 1u << (ack_sequence - sequence - 1);
+	}
 
 	MSG_WriteMarker(&net_buffer, clc_ack);
-	MSG_WriteLong(&net_buffer, sequence);
+	MSG_WriteLong(&net_buffer, ack_sequence);
+	MSG_WriteLong(&net_buffer, ack_received);
+
+	if (duplicate)
+	{
+		#ifdef ODAMEX_DEBUG
+			Printf (PRINT_LOW, "warning: duplicate packet\n");
+		#endif
+		return false;
+	}
 
 	CL_Decompress(sequence);
 
 	packetseq[packetnum] = sequence;
 	packetnum++;
+
+	return true;
 }
 
 void CL_GetServerSettings(void)
@@ -3338,9 +3494,11 @@ void CL_LoadMap(void)
 	// the music from the old wad continues to play...
 	S_StopMusic();
 
+	CL_NetDemoInfoNewMap(mapname);
 	G_InitNew (mapname);
 
 	movingsectors.clear();
+	CL_ClearPredictionCheckpoints();
 	teleported_players.clear();
 
 	CL_ClearSectorSnapshots();
@@ -3941,18 +4099,26 @@ void CL_SimulateSectors()
 			continue;
 
 		// Fetch the snapshot for this world_index and run the sector's
-		// thinkers to play any sector sounds
-		SectorSnapshot snap = itr->second.getSnapshot(world_index);
-		if (snap.isValid())
+		// thinkers to play any sector sounds.  Only generate one when the
+		// server did not send a snapshot for this tic.
+		SectorSnapshot generated;
+		const SectorSnapshot *snap = itr->second.findSnapshot(world_index);
+		if (snap == NULL)
+		{
+			generated = itr->second.getSnapshot(world_index);
+			snap = &generated;
+		}
+
+		if (snap->isValid())
 		{
-			snap.toSector(sector);
+			snap->toSector(sector);
 
 			if (sector->ceilingdata)
 				sector->ceilingdata->RunThink();
 			if (sector->floordata && sector->ceilingdata != sector->floordata)
 				sector->floordata->RunThink();
 
-			snap.toSector(sector);
+			snap->toSector(sector);
 		}
 	}
 }
@@ -52,11 +52,12 @@ void CL_InitNetwork (void);
 void CL_RequestConnectInfo(void);
 bool CL_PrepareConnect(void);
 void CL_ParseCommands(void);
-void CL_ReadPacketHeader(void);
+bool CL_ReadPacketHeader(void);
 void CL_SendCmd(void);
 void CL_SaveCmd(void);
 void CL_MoveThing(AActor *mobj, fixed_t x, fixed_t y, fixed_t z);
 void CL_PredictWorld(void);
+void CL_ClearPredictionCheckpoints(void);
 void CL_SendUserInfo(void);
 bool CL_Connect(void);
 
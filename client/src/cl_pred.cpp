@@ -54,6 +54,16 @@ void P_CalcHeight (player_t *player);
 extern NetCommand localcmds[MAXSAVETICS];
 static PlayerSnapshot cl_savedsnaps[MAXSAVETICS];
 
+// The local player as predicted at the end of each of the tics from
+// cl_checkpointstart to cl_checkpointend, all run one after another from
+// the same starting point.  If the server agrees with one of them, the
+// prediction of the tics after it still holds and doesn't need to be run
+// again.
+static PlayerSnapshot cl_checkpoints[MAXSAVETICS];
+static int cl_checkpointstart = 0;
+static int cl_checkpointend = -1;
+static AActor *cl_checkpointmo = NULL;
+
 bool predicting;
 
 extern std::map<unsigned short, SectorSnapshotManager> sector_snaps;
@@ -97,7 +107,7 @@ bool CL_SectorIsPredicting(sector_t *sector)
 	if (!sector || !cl_predictsectors)
 		return false;
 		
-	std::list<movingsector_t>::iterator itr = P_FindMovingSector(sector);
+	std::vector<movingsector_t>::iterator itr = P_FindMovingSector(sector);
 	if (itr != movingsectors.end() && sector == itr->sector)
 		return (itr->moving_ceiling || itr->moving_floor);
 
@@ -114,7 +124,7 @@ bool CL_SectorIsPredicting(sector_t *sector)
 //
 static void CL_ResetSectors()
 {
-	std::list<movingsector_t>::iterator itr;
+	std::vector<movingsector_t>::iterator itr;
 	itr = movingsectors.begin();
 	
 	// Iterate through all predicted sectors
@@ -133,10 +143,19 @@ static void CL_ResetSectors()
 		if (mgr && !mgr->empty())
 		{
 			int mostrecent = mgr->getMostRecentTime();
-			SectorSnapshot snap = mgr->getSnapshot(mostrecent);
+
+			// extrapolate from an earlier snapshot if the most recent one
+			// is no longer stored
+			SectorSnapshot generated;
+			const SectorSnapshot *snap = mgr->findSnapshot(mostrecent);
+			if (snap == NULL)
+			{
+				generated = mgr->getSnapshot(mostrecent);
+				snap = &generated;
+			}
 			
-			bool ceilingdone = P_CeilingSnapshotDone(&snap);
-			bool floordone = P_FloorSnapshotDone(&snap);
+			bool ceilingdone = P_CeilingSnapshotDone(snap);
+			bool floordone = P_FloorSnapshotDone(snap);
 			
 			if (ceilingdone && floordone)
 				snapfinished = true;
@@ -144,7 +163,7 @@ static void CL_ResetSectors()
 			{
 				// snapshots have been received for this sector recently, so
 				// reset this sector to the most recent snapshot from the server
-				snap.toSector(sector);
+				snap->toSector(sector);
 			}
 		}
 		else
@@ -156,7 +175,7 @@ static void CL_ResetSectors()
 		{
 			// no valid snapshots in the container so remove this sector from the
 			// movingsectors list whenever prediction is done
-			movingsectors.erase(itr++);
+			itr = P_EraseMovingSector(itr);
 		}
 		else
 		{
@@ -171,7 +190,7 @@ static void CL_ResetSectors()
 //
 static void CL_PredictSectors(int predtic)
 {
-	std::list<movingsector_t>::iterator itr;
+	std::vector<movingsector_t>::iterator itr;
 	for (itr = movingsectors.begin(); itr != movingsectors.end(); ++itr)
 	{
 		sector_t *sector = itr->sector;
@@ -263,6 +282,95 @@ static void CL_PredictLocalPlayer(int predtic)
 	player->mo->RunThink();
 }
 
+//
+// CL_ClearPredictionCheckpoints
+//
+// Forgets every prediction made so far, for when the local player is
+// respawned or a new level starts.
+//
+void CL_ClearPredictionCheckpoints()
+{
+	cl_checkpointstart = 0;
+	cl_checkpointend = -1;
+	cl_checkpointmo = NULL;
+}
+
+//
+// CL_SaveCheckpoint
+//
+// Remembers where the local player ended up after predicting tic predtic.
+//
+static void CL_SaveCheckpoint(player_t *player, int predtic)
+{
+	if (predtic != cl_checkpointend + 1 || player->mo != cl_checkpointmo)
+	{
+		cl_checkpointstart = predtic;
+		cl_checkpointmo = player->mo;
+	}
+
+	cl_checkpoints[predtic % MAXSAVETICS] = PlayerSnapshot(predtic, player);
+	cl_checkpointend = predtic;
+
+	if (cl_checkpointstart <= cl_checkpointend - MAXSAVETICS)
+		cl_checkpointstart = cl_checkpointend - MAXSAVETICS + 1;
+}
+
+//
+// CL_CheckpointConfirmed
+//
+// Returns true if the server's position for tic snaptic is exactly what
+// was predicted for that tic.
+//
+static bool CL_CheckpointConfirmed(player_t *player, const PlayerSnapshot &snap, int snaptic)
+{
+	if (snaptic < cl_checkpointstart || snaptic > cl_checkpointend ||
+		player->mo != cl_checkpointmo || !snap.isContinuous())
+		return false;
+
+	// The sectors are put back where the server last had them before
+	// predicting, so the tics after this one could come out differently
+	if (cl_predictsectors && !movingsectors.empty())
+		return false;
+
+	const PlayerSnapshot &checkpoint = cl_checkpoints[snaptic % MAXSAVETICS];
+
+	return	checkpoint.getX() == snap.getX() &&
+			checkpoint.getY() == snap.getY() &&
+			checkpoint.getZ() == snap.getZ() &&
+			checkpoint.getMomX() == snap.getMomX() &&
+			checkpoint.getMomY() == snap.getMomY() &&
+			checkpoint.getMomZ() == snap.getMomZ() &&
+			checkpoint.getWaterLevel() == snap.getWaterLevel();
+}
+
+//
+// CL_RestoreCheckpoint
+//
+// Puts the local player back where it was predicted to be after tic
+// predtic.  Only the things prediction changes are restored.
+//
+static void CL_RestoreCheckpoint(player_t *player, int predtic)
+{
+	const PlayerSnapshot &checkpoint = cl_checkpoints[predtic % MAXSAVETICS];
+
+	PlayerSnapshot snap(predtic);
+	snap.setX(checkpoint.getX());
+	snap.setY(checkpoint.getY());
+	snap.setZ(checkpoint.getZ());
+	snap.setMomX(checkpoint.getMomX());
+	snap.setMomY(checkpoint.getMomY());
+	snap.setMomZ(checkpoint.getMomZ());
+	snap.setOnGround(checkpoint.getOnGround());
+	snap.setCeilingZ(checkpoint.getCeilingZ());
+	snap.setFloorZ(checkpoint.getFloorZ());
+	snap.setWaterLevel(checkpoint.getWaterLevel());
+	snap.setViewHeight(checkpoint.getViewHeight());
+	snap.setDeltaViewHeight(checkpoint.getDeltaViewHeight());
+	snap.setJumpTime(checkpoint.getJumpTime());
+
+	snap.toPlayer(player);
+}
+
 //
 // CL_PredictWorld
 //
@@ -288,12 +396,16 @@ void CL_PredictWorld(void)
 	// correction.  Handle them as a special case and leave.
 	if (consoleplayer().spectator)
 	{
+		CL_ClearPredictionCheckpoints();
 		CL_PredictSpectator();
 		return;
 	}
 		
 	if (p->tic <= 0)	// No verified position from the server
+	{
+		CL_ClearPredictionCheckpoints();
 		return;
+	}
 
 	// Disable sounds, etc, during prediction
 	predicting = true;
@@ -315,7 +427,20 @@ void CL_PredictWorld(void)
 	// Move the client to the last position received from the sever
 	int snaptime = p->snapshots.getMostRecentTime();
 	PlayerSnapshot snap = p->snapshots.getSnapshot(snaptime);
-	snap.toPlayer(p);
+
+	if (cl_predictlocalplayer && predtic == p->tic && predtic < gametic - 1 &&
+		CL_CheckpointConfirmed(p, snap, predtic))
+	{
+		// The server agrees with what was predicted for its tic, so only
+		// the tics that haven't been predicted yet are left to run
+		predtic = MIN(cl_checkpointend, gametic - 1);
+		CL_RestoreCheckpoint(p, predtic);
+	}
+	else
+	{
+		snap.toPlayer(p);
+		cl_checkpointend = -1;
+	}
 
 	if (cl_predictlocalplayer)
 	{
@@ -323,7 +448,8 @@ void CL_PredictWorld(void)
 		{
 			if (cl_predictsectors)
 				CL_PredictSectors(predtic);
-			CL_PredictLocalPlayer(predtic);  
+			CL_PredictLocalPlayer(predtic);
+			CL_SaveCheckpoint(p, predtic);
 		}
 
 		// If the player didn't just spawn or teleport, nudge the player from
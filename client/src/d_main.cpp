@@ -89,6 +89,7 @@
 #include "stats.h"
 #include "p_ctf.h"
 #include "cl_main.h"
+#include "cl_demoinfo.h"
 
 #include "res_texture.h"
 #include "w_ident.h"
@@ -925,6 +926,11 @@ void D_DoomMain()
 		CL_NetDemoPlay(filename);
 	}
 
+	// play a netdemo without drawing, write a summary of it and quit
+	p = Args.CheckParm("-netdemoinfo");
+	if (p && p < Args.NumArgs() - 1)
+		CL_StartNetDemoInfo(Args.GetArg(p + 1));
+
 	// --- initialization complete ---
 
 	Printf_Bold("\n\35\36\36\36\36 Odamex Client Initialized \36\36\36\36\37\n");
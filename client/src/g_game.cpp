@@ -956,7 +956,8 @@ void G_Ticker (void)
 			last_received = gametic;
 			noservermsgs = false;
 
-			CL_ReadPacketHeader();
+			if (!CL_ReadPacketHeader())
+				continue;
 
 			if (netdemo.isRecording())
 				netdemo.capture(&net_message);
@@ -2233,6 +2234,12 @@ BOOL G_CheckDemoStatus (void)
 			else
 				Printf(PRINT_HIGH, "demotest:no player\n");
 
+			// light levels, to check running light thinkers in parallel
+			DWORD lights = 0;
+			for (int i = 0; i < numsectors; i++)
+				lights = lights * 31 + sectors[i].lightlevel;
+			Printf(PRINT_HIGH, "demotest lights:%x\n", lights);
+
 			demotest = false;
 
 			// exit the application
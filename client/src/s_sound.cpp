@@ -565,6 +565,10 @@ static void S_StartSound(fixed_t* pt, fixed_t x, fixed_t y, int channel,
 	if (volume <= 0.0f)
 		return;
 
+	// nothing should be heard while fast-forwarding a netdemo
+	if (netdemo.isSeeking())
+		return;
+
 	if (!consoleplayer().mo && channel != CHAN_INTERFACE)
 		return;
 
@@ -480,10 +480,13 @@ public:
 	//
 	// ActorBlockMapListNode
 	//
-	// [SL] A container for the linked list nodes for all of the mapblocks that
-	// an actor can be standing in.  Vanilla Doom only considered an actor to
-	// be in the mapblock where its center was located, even if it was
-	// overlapping other blocks.
+	// [SL] Keeps track of all of the mapblocks that an actor can be standing
+	// in.  Vanilla Doom only considered an actor to be in the mapblock where
+	// its center was located, even if it was overlapping other blocks.
+	//
+	// The actors themselves are kept in an array for each mapblock (see
+	// blockthings_t), so this only needs to remember which blocks to
+	// remove the actor from again.
 	//
 	class ActorBlockMapListNode
 	{
@@ -491,14 +494,12 @@ public:
 		ActorBlockMapListNode(AActor *mo);
 		void Link();
 		void Unlink();
+		bool Relink();
 		AActor* Next(int bmx, int bmy);
 
 	private:
 		void clear();
-		size_t getIndex(int bmx, int bmy);
-		
-		static const size_t BLOCKSX = 3;
-		static const size_t BLOCKSY = 3;
+		bool getBlocks(int &left, int &right, int &top, int &bottom) const;
 
 		AActor		*actor;
 			
@@ -508,11 +509,6 @@ public:
 		// the number of blocks the actor occupies
 		int			blockcntx;
 		int			blockcnty;
-
-		// the next and previous actors in each of the possible blockmaps
-		// this actor can inhabit
-		AActor		*next[BLOCKSX * BLOCKSY];
-		AActor		**prev[BLOCKSX * BLOCKSY];
 	};
 	
 	ActorBlockMapListNode bmapnode;
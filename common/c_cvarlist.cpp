@@ -286,5 +286,17 @@ CVAR(				waddirs, "", "Allow custom WAD directories to be specified",
 // Experimental settings (all categories)
 // =======================================
 
+CVAR_RANGE(			thinkerthreads, "0", "Number of extra threads used to run sector light thinkers, " \
+					"0 runs them all on the main thread",
+					CVARTYPE_BYTE, CVAR_ARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 15.0f)
+
+CVAR_RANGE(			thinkerthreadsminlights, "256", "Fewest light changes in a batch that are split over " \
+					"the thinker threads, smaller batches run on the main thread",
+					CVARTYPE_WORD, CVAR_ARCHIVE | CVAR_NOENABLEDISABLE, 1.0f, 65535.0f)
+
+CVAR_RANGE(			sv_monstersleep, "0", "Idle monsters more than this many blockmap blocks (128 units) " \
+					"from every player stop looking for players until they hear one, 0 keeps them all awake",
+					CVARTYPE_BYTE, CVAR_SERVERARCHIVE | CVAR_SERVERINFO | CVAR_NOENABLEDISABLE, 0.0f, 255.0f)
+
 
 VERSION_CONTROL (c_cvarlist_cpp, "$Id$")
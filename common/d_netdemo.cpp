@@ -0,0 +1,314 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Netdemo file layout and writer.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "doomtype.h"
+#include "d_player.h"
+#include "i_net.h"
+#include "m_swap.h"
+#include "minilzo.h"
+#include "version.h"
+#include "d_netdemo.h"
+
+static lzo_byte netdemo_wrkmem[LZO1X_1_MEM_COMPRESS];
+
+NetDemoWriter::NetDemoWriter() :
+	compression(NETDEMO_COMP_NONE), version(NETDEMOVER), writebuf_offset(0),
+	blockfile_offset(0)
+{
+}
+
+bool NetDemoWriter::open(const std::string &filename, byte compression, byte version)
+{
+	if (!file.open(filename, true))
+		return false;
+
+	this->compression = compression;
+	this->version = version;
+
+	writebuf.clear();
+	block_offsets.clear();
+
+	// the header is rewritten once the netdemo is finished
+	netdemo_header_t header;
+	memset(&header, 0, sizeof(header));
+	writeHeader(header);
+
+	writebuf_offset = NETDEMO_HEADER_SIZE;
+	blockfile_offset = NETDEMO_HEADER_SIZE;
+
+	return true;
+}
+
+void NetDemoWriter::close()
+{
+	file.close();
+	writebuf.clear();
+}
+
+//
+// NetDemoWriter::writeHeader
+//
+// Writes the header to the start of the file in little-endian format.
+//
+void NetDemoWriter::writeHeader(const netdemo_header_t &header)
+{
+	netdemo_header_t tmpheader;
+	memcpy(&tmpheader, &header, sizeof(header));
+
+	memcpy(tmpheader.identifier, "ODAD", 4);
+	tmpheader.version = version;
+	tmpheader.compression = compression;
+
+	// convert from native byte ordering to little-endian
+	tmpheader.snapshot_index_size	= LESHORT(tmpheader.snapshot_index_size);
+	tmpheader.snapshot_index_offset	= LELONG(tmpheader.snapshot_index_offset);
+	tmpheader.map_index_size		= LESHORT(tmpheader.map_index_size);
+	tmpheader.map_index_offset		= LELONG(tmpheader.map_index_offset);
+	tmpheader.snapshot_spacing		= LESHORT(tmpheader.snapshot_spacing);
+	tmpheader.starting_gametic		= LELONG(tmpheader.starting_gametic);
+	tmpheader.ending_gametic		= LELONG(tmpheader.ending_gametic);
+	tmpheader.block_size			= LELONG(tmpheader.block_size);
+	tmpheader.block_count			= LELONG(tmpheader.block_count);
+	tmpheader.block_table_offset	= LELONG(tmpheader.block_table_offset);
+
+	byte buf[NETDEMO_HEADER_SIZE], *p = buf;
+
+	#define WRITE_FIELD(f) memcpy(p, &tmpheader.f, sizeof(tmpheader.f)); p += sizeof(tmpheader.f)
+	WRITE_FIELD(identifier);
+	WRITE_FIELD(version);
+	WRITE_FIELD(compression);
+	WRITE_FIELD(snapshot_index_size);
+	WRITE_FIELD(snapshot_index_offset);
+	WRITE_FIELD(map_index_size);
+	WRITE_FIELD(map_index_offset);
+	WRITE_FIELD(snapshot_spacing);
+	WRITE_FIELD(starting_gametic);
+	WRITE_FIELD(ending_gametic);
+	WRITE_FIELD(block_size);
+	WRITE_FIELD(block_count);
+	WRITE_FIELD(block_table_offset);
+	WRITE_FIELD(reserved);
+	#undef WRITE_FIELD
+
+	file.write(buf, p - buf, 0);
+}
+
+//
+// NetDemoWriter::writeBlock
+//
+// Hands data to the writer thread, compressing it first if the netdemo
+// is compressed.  When compressed, each call writes one block that is
+// decompressed on its own, starting with its compressed and uncompressed
+// length.  A compressed length of zero means the block is stored as-is.
+//
+void NetDemoWriter::writeBlock(const byte *data, size_t size)
+{
+	if (compression == NETDEMO_COMP_NONE)
+	{
+		file.write(data, size);
+		return;
+	}
+
+	static byte packed[8 + NETDEMO_BLOCK_SIZE + NETDEMO_BLOCK_SIZE / 16 + 64 + 3];
+
+	lzo_uint packed_len = 0;
+	int res = lzo1x_1_compress(data, size, packed + 8, &packed_len, netdemo_wrkmem);
+
+	// store the block as-is if it doesn't compress
+	if (res != LZO_E_OK || packed_len >= size)
+	{
+		packed_len = 0;
+		memcpy(packed + 8, data, size);
+	}
+
+	uint32_t lengths[2];
+	lengths[0] = LELONG((uint32_t)packed_len);
+	lengths[1] = LELONG((uint32_t)size);
+	memcpy(packed, lengths, sizeof(lengths));
+
+	size_t len = 8 + (packed_len ? packed_len : size);
+	file.write(packed, len);
+
+	block_offsets.push_back(blockfile_offset);
+	blockfile_offset += len;
+}
+
+//
+// NetDemoWriter::writeData
+//
+// Buffers data to be written to the end of the netdemo.  Once at least
+// one whole block has been buffered, each block up to the last block
+// boundary is handed to writeBlock().  Compressed netdemos rely on the
+// blocks always ending on these boundaries.
+//
+void NetDemoWriter::writeData(const void *data, size_t size)
+{
+	const byte *bytes = static_cast<const byte *>(data);
+	writebuf.insert(writebuf.end(), bytes, bytes + size);
+
+	size_t start = 0;
+	for (;;)
+	{
+		size_t pos = writebuf_offset + start;
+		size_t boundary = pos - pos % NETDEMO_BLOCK_SIZE + NETDEMO_BLOCK_SIZE;
+
+		if (tell() < boundary)
+			break;
+
+		writeBlock(&writebuf[start], boundary - pos);
+		start = boundary - writebuf_offset;
+	}
+
+	if (start > 0)
+	{
+		writebuf.erase(writebuf.begin(), writebuf.begin() + start);
+		writebuf_offset += start;
+	}
+}
+
+//
+// NetDemoWriter::flush
+//
+// Hands everything that has been buffered to the writer thread.
+//
+void NetDemoWriter::flush()
+{
+	if (!writebuf.empty())
+		writeBlock(&writebuf[0], writebuf.size());
+
+	writebuf_offset = tell();
+	writebuf.clear();
+}
+
+//
+// NetDemoWriter::writeChunkHeader
+//
+// Writes the header for a chunk of the given size.  The contents of the
+// chunk have to be written right after.
+//
+void NetDemoWriter::writeChunkHeader(byte type, size_t size, uint32_t gametic)
+{
+	uint32_t length = LELONG((uint32_t)size);
+	uint32_t tic = LELONG(gametic);
+
+	writeData(&type, sizeof(type));
+	writeData(&length, sizeof(length));
+	writeData(&tic, sizeof(tic));
+}
+
+void NetDemoWriter::writeChunk(byte type, const void *data, size_t size, uint32_t gametic)
+{
+	writeChunkHeader(type, size, gametic);
+	writeData(data, size);
+}
+
+//
+// NetDemoWriter::writeIndex
+//
+// Appends an index, converting it to little-endian format.
+//
+void NetDemoWriter::writeIndex(const std::vector<netdemo_index_entry_t> &index)
+{
+	for (size_t i = 0; i < index.size(); i++)
+	{
+		uint32_t ticnum = LELONG(index[i].ticnum);
+		uint32_t offset = LELONG(index[i].offset);
+
+		writeData(&ticnum, sizeof(ticnum));
+		writeData(&offset, sizeof(offset));
+	}
+}
+
+bool NetDemoWriter::finish(netdemo_header_t &header)
+{
+	flush();
+
+	// the block table goes after everything that is compressed
+	if (compression != NETDEMO_COMP_NONE)
+	{
+		header.block_size = NETDEMO_BLOCK_SIZE;
+		header.block_count = block_offsets.size();
+		header.block_table_offset = blockfile_offset;
+
+		for (size_t i = 0; i < block_offsets.size(); i++)
+		{
+			uint32_t offset = LELONG(block_offsets[i]);
+			file.write(&offset, sizeof(offset));
+			blockfile_offset += sizeof(offset);
+		}
+	}
+	else
+	{
+		header.block_size = header.block_count = header.block_table_offset = 0;
+	}
+
+	writeHeader(header);
+
+	memcpy(header.identifier, "ODAD", 4);
+	header.version = version;
+	header.compression = compression;
+
+	return file.close();
+}
+
+//
+// NetDemo_WriteLocalCmd
+//
+// Generates a message with the player's current position and angle, taking
+// the place of ticcmds.
+//
+void NetDemo_WriteLocalCmd(buf_t *netbuffer, player_t &player)
+{
+	if (!player.mo)
+		return;
+
+	AActor *mo = player.mo;
+
+	MSG_WriteByte(netbuffer, svc_netdemocap);
+	MSG_WriteByte(netbuffer, player.cmd.buttons);
+	MSG_WriteByte(netbuffer, player.cmd.impulse);
+	MSG_WriteShort(netbuffer, player.cmd.yaw);
+	MSG_WriteShort(netbuffer, player.cmd.forwardmove);
+	MSG_WriteShort(netbuffer, player.cmd.sidemove);
+	MSG_WriteShort(netbuffer, player.cmd.upmove);
+	MSG_WriteShort(netbuffer, player.cmd.pitch);
+
+	MSG_WriteByte(netbuffer, mo->waterlevel);
+	MSG_WriteLong(netbuffer, mo->x);
+	MSG_WriteLong(netbuffer, mo->y);
+	MSG_WriteLong(netbuffer, mo->z);
+	MSG_WriteLong(netbuffer, mo->momx);
+	MSG_WriteLong(netbuffer, mo->momy);
+	MSG_WriteLong(netbuffer, mo->momz);
+	MSG_WriteLong(netbuffer, mo->angle);
+	MSG_WriteLong(netbuffer, mo->pitch);
+	MSG_WriteLong(netbuffer, player.viewheight);
+	MSG_WriteLong(netbuffer, player.deltaviewheight);
+	MSG_WriteLong(netbuffer, player.jumpTics);
+	MSG_WriteLong(netbuffer, mo->reactiontime);
+	MSG_WriteByte(netbuffer, player.readyweapon);
+	MSG_WriteByte(netbuffer, player.pendingweapon);
+}
+
+VERSION_CONTROL (d_netdemo_cpp, "$Id$")
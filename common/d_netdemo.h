@@ -0,0 +1,147 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Netdemo file layout and writer.
+//
+//	Netdemos are recorded by the client (client/src/cl_demo.cpp) and by
+//	the server (server/src/sv_demo.cpp).  Both write them through
+//	NetDemoWriter so the header, chunks and compressed blocks only have
+//	one implementation.
+//
+//	A netdemo starts with a header, followed by chunks of a type byte,
+//	the LONG length and gametic, then the data.  The snapshot and map
+//	indices follow the last chunk.  Compressed netdemos store everything
+//	after the header in blocks of NETDEMO_BLOCK_SIZE bytes that are
+//	compressed separately, each starting with its compressed and
+//	uncompressed length, and a table of where each block starts in the
+//	file is appended.  Offsets everywhere else are offsets into the
+//	uncompressed data, which is laid out exactly like an uncompressed
+//	netdemo.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __D_NETDEMO_H__
+#define __D_NETDEMO_H__
+
+#include <string>
+#include <vector>
+
+#include "doomtype.h"
+#include "i_filewriter.h"
+#include "version.h"
+
+class buf_t;
+class player_s;
+
+static const size_t NETDEMO_HEADER_SIZE = 64;
+static const size_t NETDEMO_MESSAGE_HEADER_SIZE = 9;
+static const size_t NETDEMO_INDEX_ENTRY_SIZE = 8;
+
+// uncompressed size of the blocks of a compressed netdemo
+static const size_t NETDEMO_BLOCK_SIZE = 65536;
+
+typedef enum
+{
+	NETDEMO_MSG_PACKET		= 0xAA,
+	NETDEMO_MSG_SNAPSHOT,
+	NETDEMO_MSG_POVPACKET				// packets for several players, from the server
+} netdemo_message_t;
+
+typedef enum
+{
+	NETDEMO_COMP_NONE		= 0,
+	NETDEMO_COMP_LZO					// blocks compressed with LZO1X
+} netdemo_compression_t;
+
+typedef struct
+{
+	char		identifier[4];  		// "ODAD"
+	byte		version;
+	byte    	compression;    		// type of compression used
+	uint16_t	snapshot_index_size;	// number of snapshots in the index
+	uint32_t	snapshot_index_offset;	// offset from start of the file for the index
+	uint16_t	map_index_size;			// number of maps in the mapindex
+	uint32_t	map_index_offset;		// offset from start of the file for the mapindex
+	uint16_t	snapshot_spacing;		// number of gametics between indices
+	uint32_t	starting_gametic;		// the gametic the demo starts at
+	uint32_t	ending_gametic;			// the last gametic of the demo
+	uint32_t	block_size;				// uncompressed size of each block
+	uint32_t	block_count;			// number of compressed blocks
+	uint32_t	block_table_offset;		// offset from start of the file for the block table
+	byte		reserved[24];   		// for future use
+} netdemo_header_t;
+
+typedef struct
+{
+	uint32_t	ticnum;
+	uint32_t	offset;			// offset in the demo file
+} netdemo_index_entry_t;
+
+class NetDemoWriter
+{
+public:
+	NetDemoWriter();
+
+	// Creates filename and reserves space for the header.  Only netdemos
+	// copied from an older file should pass an older version.
+	bool open(const std::string &filename, byte compression, byte version = NETDEMOVER);
+
+	// Closes the file without finishing it.
+	void close();
+
+	bool isOpen() const { return file.isOpen(); }
+	bool failed() { return file.failed(); }
+
+	void writeData(const void *data, size_t size);
+	void writeChunkHeader(byte type, size_t size, uint32_t gametic);
+	void writeChunk(byte type, const void *data, size_t size, uint32_t gametic);
+	void writeIndex(const std::vector<netdemo_index_entry_t> &index);
+
+	// Where the next data goes in the uncompressed layout.
+	uint32_t tell() const { return writebuf_offset + writebuf.size(); }
+
+	// Writes out everything, then the block table and header, and closes
+	// the file.  The identifier, version, compression and block fields of
+	// header are filled in from what the netdemo was opened with.  Returns
+	// false if anything failed to write.
+	bool finish(netdemo_header_t &header);
+
+private:
+	FileWriter			file;
+	byte				compression;
+	byte				version;
+	std::vector<byte>	writebuf;			// data not yet handed to the writer
+	uint32_t			writebuf_offset;	// offset of writebuf[0]
+	uint32_t			blockfile_offset;	// where the next block will be written
+	std::vector<uint32_t> block_offsets;
+
+	void writeBlock(const byte *data, size_t size);
+	void flush();
+	void writeHeader(const netdemo_header_t &header);
+
+	// not copyable
+	NetDemoWriter(const NetDemoWriter &);
+	NetDemoWriter &operator=(const NetDemoWriter &);
+};
+
+// Writes the svc_netdemocap message that takes the place of a player's
+// ticcmds, since nobody is sent where they are themselves.
+void NetDemo_WriteLocalCmd(buf_t *netbuffer, player_s &player);
+
+#endif	// __D_NETDEMO_H__
@@ -25,6 +25,7 @@
 #ifndef __D_PLAYER_H__
 #define __D_PLAYER_H__
 
+#include <deque>
 #include <list>
 #include <vector>
 #include <queue>
@@ -37,6 +38,7 @@
 #include "d_ticcmd.h"
 
 #include "d_net.h"
+#include "i_retransmit.h"
 
 // The player data structure depends on a number
 // of other structs: items (internal inventory),
@@ -271,13 +273,11 @@ public:
 		short		minorversion;	// GhostlyDeath -- Minor
 
 		// for reliable protocol
-		buf_t       relpackets; // save reliable packets here
-		int         packetbegin[256]; // the beginning of a packet
-		int         packetsize[256]; // the size of a packet
-		int         packetseq[256];
+		RetransmitStore relstore; // reliable data of recent packets
 		int         sequence;
-		int         last_sequence;
-		byte        packetnum;
+		int         last_sequence;	// highest sequence acknowledged
+		int         srtt;			// smoothed round trip time in ms
+		int         rttvar;			// round trip time variation in ms
 
 		int         rate;
 		int         reliable_bps;	// bytes per second
@@ -296,11 +296,38 @@ public:
 		class download_t
 		{
 		public:
-			std::string name;
-			unsigned int next_offset;
+			// a chunk that has been sent but not acknowledged
+			struct chunk_t
+			{
+				dtime_t			time;		// when it was last sent
+				unsigned int	sendseq;	// order it was last sent in
+				bool			acked;
+			};
 
-			download_t() : name(""), next_offset(0) {}
-			download_t(const download_t& other) : name(other.name), next_offset(other.next_offset) {}
+			std::string name;
+			unsigned int next_offset;	// first byte that was never sent
+			unsigned int acked_offset;	// everything before has been received
+			unsigned int length;
+			bool started;				// client acknowledged svc_wadinfo
+
+			std::deque<chunk_t> window;	// chunks from acked_offset on
+			unsigned int sendseq;
+			unsigned int acked_sendseq;	// latest send that was acknowledged
+			unsigned int recovery_sendseq; // don't back off again before this
+
+			float cwnd;					// congestion window, in chunks
+			float ssthresh;
+			int credit;					// bytes the rate cap still allows
+
+			download_t() : name(""), next_offset(0), acked_offset(0), length(0),
+				started(false), sendseq(0), acked_sendseq(0), recovery_sendseq(0),
+				cwnd(0), ssthresh(0), credit(0) {}
+			download_t(const download_t& other) : name(other.name),
+				next_offset(other.next_offset), acked_offset(other.acked_offset),
+				length(other.length), started(other.started), window(other.window),
+				sendseq(other.sendseq), acked_sendseq(other.acked_sendseq),
+				recovery_sendseq(other.recovery_sendseq), cwnd(other.cwnd),
+				ssthresh(other.ssthresh), credit(other.credit) {}
 		}download;
 
 		client_t()
@@ -310,15 +337,10 @@ public:
 			version = 0;
 			majorversion = 0;
 			minorversion = 0;
-			for (size_t i = 0; i < 256; i++)
-			{
-				packetbegin[i] = 0;
-				packetsize[i] = 0;
-				packetseq[i] = 0;
-			}
 			sequence = 0;
 			last_sequence = 0;
-			packetnum = 0;
+			srtt = 0;
+			rttvar = 0;
 			rate = 0;
 			reliable_bps = 0;
 			unreliable_bps = 0;
@@ -330,7 +352,6 @@ public:
 			// GhostlyDeath -- done with the {}
 			netbuf = MAX_UDP_PACKET;
 			reliablebuf = MAX_UDP_PACKET;
-			relpackets = MAX_UDP_PACKET*50;
 			digest = "";
 			allow_rcon = false;
 			displaydisconnect = true;
@@ -344,10 +365,11 @@ public:
 			version(other.version),
 			majorversion(other.majorversion),
 			minorversion(other.minorversion),
-			relpackets(other.relpackets),
+			relstore(other.relstore),
 			sequence(other.sequence),
 			last_sequence(other.last_sequence),
-			packetnum(other.packetnum),
+			srtt(other.srtt),
+			rttvar(other.rttvar),
 			rate(other.rate),
 			reliable_bps(other.reliable_bps),
 			unreliable_bps(other.unreliable_bps),
@@ -360,9 +382,6 @@ public:
 			compressor(other.compressor),
 			download(other.download)
 		{
-				memcpy(packetbegin, other.packetbegin, sizeof(packetbegin));
-				memcpy(packetsize, other.packetsize, sizeof(packetsize));
-				memcpy(packetseq, other.packetseq, sizeof(packetseq));
 		}
 	} client;
 
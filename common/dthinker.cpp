@@ -40,6 +40,17 @@ DThinker *DThinker::LastThinker = NULL;
 
 std::vector<DThinker *> LingerDestroy;
 
+// Thinkers by class, indexed by TypeIndex, in the order they were created.
+// Destroyed thinkers leave a NULL behind until the start of the next tic.
+static std::vector<std::vector<DThinker *> > ClassThinkers;
+static bool ClassThinkersDirty = false;
+
+// Thinkers created since the start of the tic, not filed by class yet.
+// Destroyed ones are set to NULL.
+static std::vector<DThinker *> NewThinkers;
+
+static QWORD NextThinkerSerial = 0;
+
 void DThinker::Serialize (FArchive &arc)
 {
 	Super::Serialize (arc);
@@ -111,6 +122,10 @@ DThinker::DThinker ()
 	LastThinker = this;
 	refCount = 0;
 	destroyed = false;
+
+	m_ClassIndex = -1;
+	m_Serial = NextThinkerSerial++;
+	NewThinkers.push_back(this);
 }
 
 DThinker::~DThinker ()
@@ -125,6 +140,80 @@ void DThinker::Orphan()
 	m_Next = NULL;
 	m_Prev = NULL;
 	refCount = 0;
+	m_ClassIndex = -1;
+}
+
+//
+// DThinker::FileNewThinkers
+//
+// Files the thinkers created since the last tic in the arrays of their
+// classes and drops the thinkers destroyed since then from them.
+//
+void DThinker::FileNewThinkers ()
+{
+	if (ClassThinkersDirty)
+	{
+		for (size_t i = 0; i < ClassThinkers.size(); i++)
+		{
+			std::vector<DThinker *> &list = ClassThinkers[i];
+			size_t count = 0;
+
+			for (size_t j = 0; j < list.size(); j++)
+			{
+				if (list[j])
+				{
+					list[j]->m_ClassIndex = count;
+					list[count++] = list[j];
+				}
+			}
+			list.resize(count);
+		}
+
+		ClassThinkersDirty = false;
+	}
+
+	for (size_t i = 0; i < NewThinkers.size(); i++)
+	{
+		DThinker *thinker = NewThinkers[i];
+		if (thinker == NULL)
+			continue;
+
+		unsigned short type = RUNTIME_TYPE(thinker)->TypeIndex;
+
+		if (type >= ClassThinkers.size())
+			ClassThinkers.resize(type + 1);
+
+		thinker->m_ClassIndex = ClassThinkers[type].size();
+		ClassThinkers[type].push_back(thinker);
+	}
+
+	NewThinkers.clear();
+}
+
+//
+// DThinker::Unfile
+//
+// Removes a destroyed thinker from its class array.
+//
+void DThinker::Unfile ()
+{
+	if (m_ClassIndex >= 0)
+	{
+		ClassThinkers[RUNTIME_TYPE(this)->TypeIndex][m_ClassIndex] = NULL;
+		ClassThinkersDirty = true;
+		m_ClassIndex = -1;
+		return;
+	}
+
+	// usually one of the last thinkers created
+	for (size_t i = NewThinkers.size(); i-- > 0; )
+	{
+		if (NewThinkers[i] == this)
+		{
+			NewThinkers[i] = NULL;
+			break;
+		}
+	}
 }
 
 void DThinker::Destroy ()
@@ -141,6 +230,8 @@ void DThinker::Destroy ()
 		m_Next->m_Prev = m_Prev;
 	if (m_Prev)
 		m_Prev->m_Next = m_Next;
+
+	Unfile ();
 	
 	destroyed = true;
 		
@@ -193,6 +284,10 @@ void DThinker::DestroyAllThinkers ()
 		}
 	}
 	LingerDestroy.clear();
+
+	ClassThinkers.clear();
+	ClassThinkersDirty = false;
+	NewThinkers.clear();
 }
 
 // Destroy all thinkers except for player-controlled actors
@@ -214,6 +309,49 @@ void DThinker::DestroyMostThinkers ()
 	DObject::EndFrame ();
 }
 
+//
+// ThinkerKind
+//
+// Sorts the classes of thinkers for IndependentThinker once, instead of
+// checking the class of every thinker on every tic.
+//
+enum thinkerkind_t
+{
+	THINKER_UNKNOWN,
+	THINKER_ACTOR,
+	THINKER_MOVINGSECTOR,
+	THINKER_OTHER
+};
+
+static thinkerkind_t ThinkerKind(DThinker *thinker)
+{
+	static std::vector<byte> kinds;
+
+	const TypeInfo *type = RUNTIME_TYPE(thinker);
+
+	if (type->TypeIndex >= kinds.size())
+		kinds.resize(type->TypeIndex + 1, THINKER_UNKNOWN);
+
+	if (kinds[type->TypeIndex] == THINKER_UNKNOWN)
+	{
+		thinkerkind_t kind = THINKER_OTHER;
+
+		if (thinker->IsKindOf (RUNTIME_CLASS (AActor)))
+			kind = THINKER_ACTOR;
+		else if (thinker->IsA(RUNTIME_CLASS (DPillar)) ||
+				 thinker->IsA(RUNTIME_CLASS (DElevator)) ||
+				 thinker->IsA(RUNTIME_CLASS (DFloor)) ||
+				 thinker->IsA(RUNTIME_CLASS (DCeiling)) ||
+				 thinker->IsA(RUNTIME_CLASS (DPlat)) ||
+				 thinker->IsA(RUNTIME_CLASS (DDoor)))
+			kind = THINKER_MOVINGSECTOR;
+
+		kinds[type->TypeIndex] = kind;
+	}
+
+	return (thinkerkind_t)kinds[type->TypeIndex];
+}
+
 //
 // IndependentThinker
 //
@@ -226,7 +364,9 @@ bool IndependentThinker(DThinker *thinker)
 	if (!multiplayer || demoplayback)
 		return false;
 
-	if (thinker->IsKindOf (RUNTIME_CLASS (AActor)))
+	thinkerkind_t kind = ThinkerKind(thinker);
+
+	if (kind == THINKER_ACTOR)
 	{
 		AActor *mobj = static_cast<AActor*>(thinker);
 		if (!mobj->player || mobj->player->spectator)
@@ -241,12 +381,7 @@ bool IndependentThinker(DThinker *thinker)
 			return true;
 	}
 	
-	if (thinker->IsA(RUNTIME_CLASS (DPillar)) ||
-		thinker->IsA(RUNTIME_CLASS (DElevator)) ||
-		thinker->IsA(RUNTIME_CLASS (DFloor)) ||
-		thinker->IsA(RUNTIME_CLASS (DCeiling)) ||
-		thinker->IsA(RUNTIME_CLASS (DPlat)) ||
-		thinker->IsA(RUNTIME_CLASS (DDoor)))
+	if (kind == THINKER_MOVINGSECTOR)
 	{
 		// Client ticks movable sectors in prediction code
 		if (clientside)
@@ -256,12 +391,21 @@ bool IndependentThinker(DThinker *thinker)
 	return false;
 }
 
-
+//
+// DThinker::RunThinkers
+//
+// Thinkers still run in the order they were created rather than class by
+// class.  Most of them call P_Random, so running them in any other order
+// would break demos.
+//
 void DThinker::RunThinkers ()
 {
 	DThinker *currentthinker;
 
 	BEGIN_STAT (ThinkCycles);
+	FileNewThinkers ();
+	DLighting::StartDeferring ();
+
 	currentthinker = FirstThinker;
 	while (currentthinker)
 	{
@@ -269,9 +413,79 @@ void DThinker::RunThinkers ()
 			currentthinker->RunThink();
 		currentthinker = currentthinker->m_Next;
 	}
+
+	DLighting::FinishDeferring ();
 	END_STAT (ThinkCycles);
 }
 
+FThinkerIterator::FThinkerIterator (TypeInfo *type) :
+	m_ParentType(type)
+{
+	Reset ();
+}
+
+void FThinkerIterator::Reset ()
+{
+	m_Classes.clear();
+	m_Positions.clear();
+	m_NewPosition = 0;
+
+	for (size_t i = 0; i < ClassThinkers.size(); i++)
+	{
+		if (!ClassThinkers[i].empty() &&
+			m_ParentType->IsAncestorOf (TypeInfo::m_Types[i]))
+		{
+			m_Classes.push_back(i);
+			m_Positions.push_back(0);
+		}
+	}
+}
+
+//
+// FThinkerIterator::Next
+//
+// Merges the arrays of the matching classes by order of creation, then
+// goes through the thinkers that were created since the last tic.
+// Thinkers destroyed during the iteration are skipped and new ones are
+// returned at the end, just like following the full thinker list would.
+//
+DThinker *FThinkerIterator::Next ()
+{
+	DThinker *best = NULL;
+	size_t bestclass = 0;
+
+	for (size_t i = 0; i < m_Classes.size(); i++)
+	{
+		const std::vector<DThinker *> &list = ClassThinkers[m_Classes[i]];
+		size_t &pos = m_Positions[i];
+
+		while (pos < list.size() && list[pos] == NULL)
+			pos++;
+
+		if (pos < list.size() && (!best || list[pos]->m_Serial < best->m_Serial))
+		{
+			best = list[pos];
+			bestclass = i;
+		}
+	}
+
+	if (best)
+	{
+		m_Positions[bestclass]++;
+		return best;
+	}
+
+	while (m_NewPosition < NewThinkers.size())
+	{
+		DThinker *thinker = NewThinkers[m_NewPosition++];
+		if (thinker && thinker->IsKindOf (m_ParentType))
+			return thinker;
+	}
+
+	Reset ();
+	return NULL;
+}
+
 void *DThinker::operator new (size_t size)
 {
 	return Z_Malloc (size, PU_LEVSPEC, 0);
@@ -28,6 +28,7 @@
 #define __DTHINKER_H__
 
 #include <stdlib.h>
+#include <vector>
 #include "dobject.h"
 
 class AActor;
@@ -83,36 +84,35 @@ private:
 	DThinker *m_Next, *m_Prev;
 	bool destroyed;
 
+	// Besides the list of all thinkers, every thinker is kept in an array
+	// with the other thinkers of its class.  New thinkers are only filed
+	// there at the start of the next tic, as their class is not known yet
+	// when the DThinker constructor runs.
+	int m_ClassIndex;		// position in its class array, -1 if not filed
+	QWORD m_Serial;			// order of creation, the order of the full list
+
+	static void FileNewThinkers ();
+	void Unfile ();
+
 	friend class FThinkerIterator;
 };
 
+// Iterates over the thinkers of a class and its descendants in the same
+// order as the full thinker list, looking only at the arrays of the
+// matching classes.
 class FThinkerIterator
 {
 private:
 	TypeInfo *m_ParentType;
-	DThinker *m_CurrThinker;
+	std::vector<unsigned short> m_Classes;	// matching classes with thinkers
+	std::vector<size_t> m_Positions;		// next position in each of them
+	size_t m_NewPosition;					// next position in unfiled thinkers
+
+	void Reset ();
 
 public:
-	FThinkerIterator (TypeInfo *type)
-	{
-		m_ParentType = type;
-		m_CurrThinker = DThinker::FirstThinker;
-	}
-	DThinker *Next ()
-	{
-		while (m_CurrThinker)
-		{
-			if (m_CurrThinker->IsKindOf (m_ParentType))
-			{
-				DThinker *res = m_CurrThinker;
-				m_CurrThinker = m_CurrThinker->m_Next;
-				return res;
-			}
-			m_CurrThinker = m_CurrThinker->m_Next;
-		}
-		m_CurrThinker = DThinker::FirstThinker;
-		return NULL;
-	}
+	FThinkerIterator (TypeInfo *type);
+	DThinker *Next ();
 };
 
 template <class T> class TThinkerIterator : public FThinkerIterator
@@ -527,12 +527,67 @@ bool huffman::decompress( unsigned char *in_data, size_t in_len, unsigned char *
 	return Huffman_Uncompress_Using_Tree(in_data, in_len, out_data, out_len, root);
 }
 
+// Replace the statistics with a fixed model
+void huffman::set_model(const unsigned int *counts)
+{
+	unsigned int total = 0, divisor = 1;
+	int k;
+
+	for( k = 0; k < 256; ++ k )
+		total += counts[k] ? counts[k] : 1;
+
+	// Same ceiling as _Huffman_Hist, which keeps every code within 32 bits
+	while( total / divisor > 65000 )
+		divisor *= 2;
+
+	total_count = 0;
+	for( k = 0; k < 256; ++ k )
+	{
+		sym[k].Symbol = k;
+		sym[k].Count  = counts[k] / divisor;
+		sym[k].Code   = 0;
+		sym[k].Bits   = 0;
+
+		// a zero count would leave the symbol without a code
+		if( sym[k].Count == 0 )
+			sym[k].Count = 1;
+
+		total_count += sym[k].Count;
+	}
+
+	fresh_histogram = true;
+}
+
+// Copy the current statistics out, indexed by symbol
+void huffman::get_model(unsigned int *counts) const
+{
+	for( int k = 0; k < 256; ++ k )
+		counts[sym[k].Symbol] = sym[k].Count;
+}
+
 // Constructor
 huffman::huffman()
 {
 	reset();
 }
 
+//
+// Static codec
+//
+huffman &huffman_static_codec()
+{
+	static huffman codec;
+	static bool initialized = false;
+
+	if(!initialized)
+	{
+		codec.set_model(huffman_static_model);
+		initialized = true;
+	}
+
+	return codec;
+}
+
 //
 // Huffman Server
 //
@@ -98,6 +98,13 @@ public:
 	// Decompress a chunk of data using only previously generated stats
 	bool decompress( unsigned char *in_data, size_t in_len, unsigned char *out_data, size_t &out_len);
 
+	// Replace the statistics with a fixed model, indexed by symbol, such as
+	// one trained by tools/hufftrain.  Every symbol keeps a nonzero count.
+	void set_model(const unsigned int *counts);
+
+	// Copy the current statistics out, indexed by symbol
+	void get_model(unsigned int *counts) const;
+
 	// For debugging, this count can be used to see if two codecs have had the same length input
 	int get_count() { return total_count; }
 	
@@ -111,6 +118,13 @@ public:
 	} 
 };
 
+// Static model trained offline from captured game traffic (huffman_model.cpp)
+extern const unsigned int huffman_static_model[256];
+
+// Codec built from huffman_static_model.  It is never extended, so both ends
+// can use it without negotiating anything.
+huffman &huffman_static_codec();
+
 #define HUFFMAN_RENEGOTIATE_DELAY	256
 
 class huffman_server
@@ -0,0 +1,64 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Static huffman model for packet compression.
+//
+//	Default model: a prior weighted towards zero bytes, small integers,
+//	sign-extended small negatives and printable text.  Replace it with one
+//	generated by tools/hufftrain from a netdemo corpus.  Changing it breaks
+//	compatibility with clients built against a different model.
+//
+//-----------------------------------------------------------------------------
+
+#include "huffman.h"
+
+const unsigned int huffman_static_model[256] =
+{
+	6840, 680, 552, 449, 367, 302, 249, 207,
+	174, 147, 125, 108, 94, 83, 75, 68,
+	62, 58, 54, 51, 49, 47, 45, 44,
+	43, 43, 42, 41, 41, 41, 40, 40,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 100,
+	100, 100, 100, 100, 100, 100, 100, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 40, 40,
+	40, 40, 40, 40, 40, 40, 41, 41,
+	41, 42, 42, 43, 44, 45, 46, 48,
+	50, 53, 56, 60, 65, 72, 80, 90,
+	102, 118, 138, 162, 193, 232, 280, 1840,
+};
@@ -0,0 +1,375 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Background file writer.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "win32inc.h"
+#include "doomtype.h"
+#include "i_filewriter.h"
+
+#if defined(GEKKO) || defined(_XBOX)
+	#define FILEWRITER_NONE
+#elif defined(_WIN32)
+	#define FILEWRITER_WIN32
+#else
+	#include <pthread.h>
+	#define FILEWRITER_PTHREAD
+#endif
+
+// how much can be waiting to be written before write() blocks
+#define MAX_QUEUED_BYTES	(8 * 1024 * 1024)
+
+#if defined(FILEWRITER_PTHREAD)
+
+struct FileWriter::thread_t
+{
+	pthread_t		handle;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wake;		// a request was queued or we should quit
+	pthread_cond_t	idle;		// a request was done
+};
+
+static void *FileWriterThread(void *param)
+{
+	FileWriter::ThreadMain(param);
+	return NULL;
+}
+
+bool FileWriter::startThread()
+{
+	thread = new thread_t;
+	pthread_mutex_init(&thread->lock, NULL);
+	pthread_cond_init(&thread->wake, NULL);
+	pthread_cond_init(&thread->idle, NULL);
+
+	if (pthread_create(&thread->handle, NULL, FileWriterThread, this) != 0)
+	{
+		pthread_cond_destroy(&thread->idle);
+		pthread_cond_destroy(&thread->wake);
+		pthread_mutex_destroy(&thread->lock);
+		delete thread;
+		thread = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void FileWriter::stopThread()
+{
+	pthread_join(thread->handle, NULL);
+	pthread_cond_destroy(&thread->idle);
+	pthread_cond_destroy(&thread->wake);
+	pthread_mutex_destroy(&thread->lock);
+	delete thread;
+	thread = NULL;
+}
+
+void FileWriter::lock()			{ pthread_mutex_lock(&thread->lock); }
+void FileWriter::unlock()		{ pthread_mutex_unlock(&thread->lock); }
+void FileWriter::waitWake()		{ pthread_cond_wait(&thread->wake, &thread->lock); }
+void FileWriter::waitIdle()		{ pthread_cond_wait(&thread->idle, &thread->lock); }
+void FileWriter::signalWake()	{ pthread_cond_signal(&thread->wake); }
+void FileWriter::signalIdle()	{ pthread_cond_broadcast(&thread->idle); }
+
+#elif defined(FILEWRITER_WIN32)
+
+// Only the writer thread waits on wake and only the thread using the
+// FileWriter waits on idle, so auto-reset events are enough.
+struct FileWriter::thread_t
+{
+	HANDLE				handle;
+	CRITICAL_SECTION	lock;
+	HANDLE				wake;
+	HANDLE				idle;
+};
+
+static DWORD WINAPI FileWriterThread(LPVOID param)
+{
+	FileWriter::ThreadMain(param);
+	return 0;
+}
+
+bool FileWriter::startThread()
+{
+	thread = new thread_t;
+	InitializeCriticalSection(&thread->lock);
+	thread->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	thread->idle = CreateEvent(NULL, FALSE, FALSE, NULL);
+	thread->handle = NULL;
+
+	if (thread->wake && thread->idle)
+		thread->handle = CreateThread(NULL, 0, FileWriterThread, this, 0, NULL);
+
+	if (thread->handle == NULL)
+	{
+		if (thread->wake)
+			CloseHandle(thread->wake);
+		if (thread->idle)
+			CloseHandle(thread->idle);
+		DeleteCriticalSection(&thread->lock);
+		delete thread;
+		thread = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void FileWriter::stopThread()
+{
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	CloseHandle(thread->wake);
+	CloseHandle(thread->idle);
+	DeleteCriticalSection(&thread->lock);
+	delete thread;
+	thread = NULL;
+}
+
+void FileWriter::lock()			{ EnterCriticalSection(&thread->lock); }
+void FileWriter::unlock()		{ LeaveCriticalSection(&thread->lock); }
+void FileWriter::signalWake()	{ SetEvent(thread->wake); }
+void FileWriter::signalIdle()	{ SetEvent(thread->idle); }
+
+void FileWriter::waitWake()
+{
+	unlock();
+	WaitForSingleObject(thread->wake, INFINITE);
+	lock();
+}
+
+void FileWriter::waitIdle()
+{
+	unlock();
+	WaitForSingleObject(thread->idle, INFINITE);
+	lock();
+}
+
+#else
+
+struct FileWriter::thread_t
+{
+};
+
+bool FileWriter::startThread()	{ return false; }
+void FileWriter::stopThread()	{ }
+void FileWriter::lock()			{ }
+void FileWriter::unlock()		{ }
+void FileWriter::waitWake()		{ }
+void FileWriter::waitIdle()		{ }
+void FileWriter::signalWake()	{ }
+void FileWriter::signalIdle()	{ }
+
+#endif
+
+FileWriter::FileWriter() :
+	file(NULL), queued(0), thread(NULL), busy(false), quit(false), error(false)
+{
+}
+
+FileWriter::~FileWriter()
+{
+	close();
+}
+
+//
+// FileWriter::open
+//
+bool FileWriter::open(const std::string &filename, bool truncate)
+{
+	close();
+
+	error = false;
+	quit = false;
+	busy = false;
+
+	file = NULL;
+	if (!truncate)
+		file = fopen(filename.c_str(), "r+b");
+	if (file == NULL)
+		file = fopen(filename.c_str(), "w+b");
+	if (file == NULL)
+		return false;
+
+	// without a thread, writes are done right away
+	if (!startThread())
+		DPrintf("FileWriter: could not start thread, writing %s directly\n", filename.c_str());
+
+	return true;
+}
+
+//
+// FileWriter::process
+//
+// Returns false if the request could not be written.
+//
+bool FileWriter::process(request_t &req)
+{
+	bool ok = true;
+
+	if (req.offset >= 0 && fseek(file, req.offset, SEEK_SET) != 0)
+		ok = false;
+	else if (fwrite(req.data, 1, req.len, file) != req.len)
+		ok = false;
+
+	delete[] req.data;
+	return ok;
+}
+
+//
+// FileWriter::write
+//
+void FileWriter::write(const void *data, size_t len, long offset)
+{
+	if (file == NULL || len == 0)
+		return;
+
+	request_t req;
+	req.data = new byte[len];
+	req.len = len;
+	req.offset = offset;
+	memcpy(req.data, data, len);
+
+	if (thread == NULL)
+	{
+		if (!process(req))
+			error = true;
+		return;
+	}
+
+	lock();
+
+	while (queued > MAX_QUEUED_BYTES)
+		waitIdle();
+
+	queue.push_back(req);
+	queued += len;
+
+	signalWake();
+	unlock();
+}
+
+//
+// FileWriter::flush
+//
+void FileWriter::flush()
+{
+	if (file == NULL)
+		return;
+
+	if (thread)
+		lock();
+
+	while (thread && (!queue.empty() || busy))
+		waitIdle();
+
+	// the thread is idle until the next write
+	if (fflush(file) != 0)
+		error = true;
+
+	if (thread)
+		unlock();
+}
+
+//
+// FileWriter::failed
+//
+bool FileWriter::failed()
+{
+	if (thread)
+		lock();
+
+	bool result = error;
+
+	if (thread)
+		unlock();
+
+	return result;
+}
+
+//
+// FileWriter::close
+//
+bool FileWriter::close()
+{
+	if (file == NULL)
+		return !error;
+
+	if (thread)
+	{
+		lock();
+		quit = true;
+		signalWake();
+		unlock();
+
+		stopThread();
+	}
+
+	if (fclose(file) != 0)
+		error = true;
+	file = NULL;
+
+	return !error;
+}
+
+//
+// FileWriter::run
+//
+// Write queued requests until told to quit and nothing is left.
+//
+void FileWriter::run()
+{
+	lock();
+
+	for (;;)
+	{
+		while (queue.empty() && !quit)
+			waitWake();
+
+		if (queue.empty())
+			break;
+
+		request_t req = queue.front();
+		queue.pop_front();
+		busy = true;
+
+		unlock();
+		bool ok = process(req);
+		lock();
+
+		if (!ok)
+			error = true;
+		busy = false;
+		queued -= req.len;
+		signalIdle();
+	}
+
+	unlock();
+}
+
+void FileWriter::ThreadMain(void *param)
+{
+	static_cast<FileWriter *>(param)->run();
+}
+
+VERSION_CONTROL (i_filewriter_cpp, "$Id$")
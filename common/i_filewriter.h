@@ -0,0 +1,101 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Background file writer.
+//
+//	Writes are copied into a queue and done by a separate thread, so the
+//	game doesn't stall on disk I/O.  A writer owns one file from open
+//	until close.  Platforms without threads write right away.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __I_FILEWRITER_H__
+#define __I_FILEWRITER_H__
+
+#include <stdio.h>
+
+#include <deque>
+#include <string>
+
+#include "doomtype.h"
+
+class FileWriter
+{
+public:
+	FileWriter();
+	~FileWriter();
+
+	// Open filename for writing, keeping its current contents unless
+	// truncate is set.
+	bool open(const std::string &filename, bool truncate);
+	bool isOpen() const { return file != NULL; }
+
+	// Queue len bytes to be written at offset, or right after the previous
+	// write if offset is -1.  The data is copied.  Blocks when too much is
+	// already waiting to be written.
+	void write(const void *data, size_t len, long offset = -1);
+
+	// Wait until everything queued has been written.
+	void flush();
+
+	// Flush and close the file.  Returns false if any write failed.
+	bool close();
+
+	bool failed();
+
+	// entry point of the writer thread
+	static void ThreadMain(void *param);
+
+private:
+	struct request_t
+	{
+		byte	*data;
+		size_t	len;
+		long	offset;
+	};
+
+	FILE				*file;
+	std::deque<request_t>	queue;
+	size_t				queued;		// bytes waiting to be written
+
+	// the writer thread and what it waits on, differs by platform
+	struct thread_t;
+	thread_t			*thread;
+	bool				busy;
+	bool				quit;
+	bool				error;		// guarded by the lock while the thread runs
+
+	bool process(request_t &req);
+	void run();
+
+	bool startThread();
+	void stopThread();
+	void lock();
+	void unlock();
+	void waitWake();		// called with the lock held
+	void waitIdle();		// called with the lock held
+	void signalWake();
+	void signalIdle();
+
+	// not copyable
+	FileWriter(const FileWriter &);
+	FileWriter &operator=(const FileWriter &);
+};
+
+#endif	// __I_FILEWRITER_H__
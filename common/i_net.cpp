@@ -51,6 +51,7 @@
 #	include <arpa/inet.h>
 #	include <netdb.h>
 #	include <sys/ioctl.h>
+#	include <sys/uio.h>
 #endif // GEKKO
 #	include <sys/types.h>
 #	include <errno.h>
@@ -529,6 +530,89 @@ int NET_SendPacket (buf_t &buf, netadr_t &to)
 }
 
 
+//
+// NET_SendPacketv
+//
+// Send a packet made up of several separate pieces of memory, such as a
+// header and a client's reliable and unreliable buffers, without first
+// copying them into one buffer.
+//
+int NET_SendPacketv (const net_iovec_t *iov, size_t count, netadr_t &to)
+{
+	int ret;
+
+	if (simulated_connection)
+		return 0;
+
+	if (count > NET_MAX_IOVEC)
+		count = NET_MAX_IOVEC;
+
+#if defined(GEKKO) || defined(_XBOX)
+	// no scatter-gather I/O, gather into one buffer instead
+	static buf_t gather(MAX_UDP_PACKET);
+
+	gather.clear();
+	for (size_t i = 0; i < count; i++)
+		gather.WriteChunk((const char *)iov[i].data, iov[i].size);
+
+	return NET_SendPacket(gather, to);
+#else
+	struct sockaddr_in addr;
+	NetadrToSockadr (&to, &addr);
+
+#ifdef _WIN32
+	WSABUF bufs[NET_MAX_IOVEC];
+	DWORD sent = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		bufs[i].buf = (char *)iov[i].data;
+		bufs[i].len = iov[i].size;
+	}
+
+	ret = WSASendTo(inet_socket, bufs, count, &sent, 0, (struct sockaddr *)&addr,
+					sizeof(addr), NULL, NULL);
+	ret = (ret == 0) ? (int)sent : -1;
+#else
+	struct iovec vec[NET_MAX_IOVEC];
+	struct msghdr msg;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		vec[i].iov_base = (void *)iov[i].data;
+		vec[i].iov_len = iov[i].size;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = &addr;
+	msg.msg_namelen = sizeof(addr);
+	msg.msg_iov = vec;
+	msg.msg_iovlen = count;
+
+	ret = sendmsg(inet_socket, &msg, 0);
+#endif
+
+    if (ret == -1)
+    {
+#ifdef _WIN32
+          int err = WSAGetLastError();
+
+          // wouldblock is silent
+          if (err == WSAEWOULDBLOCK)
+              return 0;
+#else
+          if (errno == EWOULDBLOCK)
+              return 0;
+          if (errno == ECONNREFUSED)
+              return 0;
+          Printf (PRINT_HIGH, "NET_SendPacketv: %s\n", strerror(errno));
+#endif
+    }
+
+	return ret;
+#endif
+}
+
 #ifndef HOST_NAME_MAX
 #define HOST_NAME_MAX 256
 #endif
@@ -590,6 +674,7 @@ void SZ_Write (buf_t *b, const byte *data, int startpos, int length)
 // both client & server code.  Client has a stub function for SV_SendPackets.
 //
 void SV_SendPackets(void);
+void SV_NetStatsMarker(buf_t *b, svc_t c);
 
 void MSG_WriteMarker (buf_t *b, svc_t c)
 {
@@ -597,6 +682,7 @@ void MSG_WriteMarker (buf_t *b, svc_t c)
     if (b->cursize > 600)
         SV_SendPackets();
 
+	SV_NetStatsMarker(b, c);
 	b->WriteByte((byte)c);
 }
 
@@ -751,9 +837,6 @@ size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc)
 // Output buffer size for LZO compression, extra space in case uncompressable
 #define OUT_LEN(a)      ((a) + (a) / 16 + 64 + 3)
 
-// size above which packets get compressed (empirical), does not apply to adaptive compression
-#define MINILZO_COMPRESS_MINPACKETSIZE	0xFF
-
 //
 // MSG_DecompressMinilzo
 //
@@ -809,8 +892,11 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
 
 	memcpy(compressed.ptr(), buf.ptr(), start_offset);
 
-	SZ_Clear(&buf);
-	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+	// hand the compressed data over instead of copying it back
+	compressed.cursize = outlen + start_offset + write_gap;
+	compressed.readpos = 0;
+	compressed.overflowed = false;
+	buf.swap(compressed);
 
 	return true;
 }
@@ -863,12 +949,34 @@ bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_
 
 	memcpy(compressed.ptr(), buf.ptr(), start_offset);
 
-	SZ_Clear(&buf);
-	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+	// hand the compressed data over instead of copying it back
+	compressed.cursize = outlen + start_offset + write_gap;
+	compressed.readpos = 0;
+	compressed.overflowed = false;
+	buf.swap(compressed);
 
 	return true;
 }
 
+//
+// MSG_DecompressStatic
+//
+bool MSG_DecompressStatic ()
+{
+	return MSG_DecompressAdaptive(huffman_static_codec());
+}
+
+//
+// MSG_CompressStatic
+//
+// Huffman coding with the model trained offline by tools/hufftrain.  Unlike
+// minilzo it is worth trying on packets of any size.
+//
+bool MSG_CompressStatic (buf_t &buf, size_t start_offset, size_t write_gap)
+{
+	return MSG_CompressAdaptive(huffman_static_codec(), buf, start_offset, write_gap);
+}
+
 int MSG_ReadShort (void)
 {
     return net_message.ReadShort();
@@ -954,7 +1062,8 @@ void InitNetMessageFormats()
       MSG(clc_launcher_challenge, "x"),
       MSG(clc_challenge,          "x"),
       MSG(clc_spy,                "x"),
-      MSG(clc_privmsg,            "x")
+      MSG(clc_privmsg,            "x"),
+      MSG(clc_wadack,             "x")
    };
 
    msg_info_t svc_messages[] = {
@@ -1029,7 +1138,17 @@ void InitNetMessageFormats()
 	MSG(svc_mobjtranslation,	"x"),
 	MSG(svc_fullupdatedone,		"x"),
 	MSG(svc_railtrail,			"x"),
-	MSG(svc_playerstate,		"x")
+	MSG(svc_readystate,			"x"),
+	MSG(svc_playerstate,		"x"),
+	MSG(svc_warmupstate,		"x"),
+	MSG(svc_resetmap,			"x"),
+	MSG(svc_netdemocap,			"x"),
+	MSG(svc_netdemostop,		"x"),
+	MSG(svc_netdemoloadsnap,	"x"),
+	MSG(svc_vote_update,		"x"),
+	MSG(svc_maplist,			"x"),
+	MSG(svc_maplist_update,		"x"),
+	MSG(svc_maplist_index,		"x")
    };
 
    size_t i;
@@ -28,6 +28,7 @@
 #include "doomtype.h"
 #include "huffman.h"
 
+#include <algorithm>
 #include <string>
 
 // Max packet size to send and receive, in bytes
@@ -132,7 +133,7 @@ enum svc_t
 	svc_damagemobj,
 
 	// for downloading
-	svc_wadinfo,			// denis - [ulong:filesize]
+	svc_wadinfo,			// denis - [ulong:filesize], [ushort:chunksize]
 	svc_wadchunk,			// denis - [ulong:offset], [ushort:len], [byte[]:data]
 		
 	// netdemos - NullPoint
@@ -183,6 +184,7 @@ enum clc_t
 	clc_ready,				// [AM] Toggle ready state.
 	clc_spy,				// [SL] Tell server to send info about this player
 	clc_privmsg,			// [AM] Targeted chat to a specific player.
+	clc_wadack,				// [ulong:offset], [byte:len], [byte[]:later chunks received]
 
 	// for when launcher packets go astray
 	clc_launcher_challenge = 212,
@@ -198,7 +200,8 @@ enum svc_compressed_masks
 	adaptive_mask = 1,
 	adaptive_select_mask = 2,
 	adaptive_record_mask = 4,
-	minilzo_mask = 8
+	minilzo_mask = 8,
+	static_huffman_mask = 16
 };
 
 typedef struct
@@ -210,6 +213,18 @@ typedef struct
 
 extern  netadr_t  net_from;  // address of who sent the packet
 
+// One piece of a packet sent with NET_SendPacketv
+struct net_iovec_t
+{
+	const byte	*data;
+	size_t		size;
+};
+
+#define NET_MAX_IOVEC	4
+
+// size above which packets get compressed (empirical), does not apply to adaptive compression
+#define MINILZO_COMPRESS_MINPACKETSIZE	0xFF
+
 
 class buf_t
 {
@@ -483,6 +498,16 @@ public:
 		return ret;
 	}
 
+	// exchange storage with another buffer without copying the contents
+	void swap(buf_t &other)
+	{
+		std::swap(data, other.data);
+		std::swap(allocsize, other.allocsize);
+		std::swap(cursize, other.cursize);
+		std::swap(readpos, other.readpos);
+		std::swap(overflowed, other.overflowed);
+	}
+
 	buf_t &operator =(const buf_t &other)
 	{
 	    // Avoid self-assignment
@@ -539,6 +564,7 @@ bool NET_StringToAdr (const char *s, netadr_t *a);
 bool NET_CompareAdr (netadr_t a, netadr_t b);
 int  NET_GetPacket (void);
 int NET_SendPacket (buf_t &buf, netadr_t &to);
+int NET_SendPacketv (const net_iovec_t *iov, size_t count, netadr_t &to);
 std::string NET_GetLocalAddress (void);
 
 void SZ_Clear (buf_t *buf);
@@ -575,6 +601,9 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap);
 bool MSG_DecompressAdaptive (huffman &huff);
 bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap);
 
+bool MSG_DecompressStatic ();
+bool MSG_CompressStatic (buf_t &buf, size_t start_offset, size_t write_gap);
+
 #endif
 
 
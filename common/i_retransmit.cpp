@@ -0,0 +1,248 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Reference-counted store of reliable packet data for retransmission.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <vector>
+
+#include "i_retransmit.h"
+
+// Segments nobody refers to anymore, shared by every client.  Anything
+// beyond this many is given back to the system.
+static const size_t MAX_FREE_SEGMENTS = 1024;
+
+std::vector<RetransmitStore::segment_t *> &RetransmitStore::free_segments()
+{
+	static std::vector<segment_t *> segments;
+	return segments;
+}
+
+RetransmitStore::segment_t *RetransmitStore::alloc()
+{
+	std::vector<segment_t *> &pool = free_segments();
+	segment_t *segment;
+
+	if (pool.empty())
+	{
+		segment = new segment_t;
+	}
+	else
+	{
+		segment = pool.back();
+		pool.pop_back();
+	}
+
+	segment->buf.clear();
+	segment->refs = 1;
+
+	return segment;
+}
+
+void RetransmitStore::unref(segment_t *segment)
+{
+	if (segment == NULL || --segment->refs > 0)
+		return;
+
+	std::vector<segment_t *> &pool = free_segments();
+
+	if (pool.size() < MAX_FREE_SEGMENTS)
+		pool.push_back(segment);
+	else
+		delete segment;
+}
+
+RetransmitStore::RetransmitStore()
+{
+	for (size_t i = 0; i < NUM_SLOTS; i++)
+	{
+		slots[i].sequence = -1;
+		slots[i].segment = NULL;
+		slots[i].time = 0;
+		slots[i].pending = false;
+	}
+}
+
+RetransmitStore::RetransmitStore(const RetransmitStore &other)
+{
+	for (size_t i = 0; i < NUM_SLOTS; i++)
+		slots[i].segment = NULL;
+
+	copy(other);
+}
+
+RetransmitStore &RetransmitStore::operator=(const RetransmitStore &other)
+{
+	if (this != &other)
+	{
+		clear();
+		copy(other);
+	}
+
+	return *this;
+}
+
+RetransmitStore::~RetransmitStore()
+{
+	clear();
+}
+
+void RetransmitStore::copy(const RetransmitStore &other)
+{
+	for (size_t i = 0; i < NUM_SLOTS; i++)
+	{
+		slots[i] = other.slots[i];
+		if (slots[i].segment)
+			slots[i].segment->refs++;
+	}
+
+	order = other.order;
+}
+
+void RetransmitStore::clear()
+{
+	for (size_t i = 0; i < NUM_SLOTS; i++)
+	{
+		unref(slots[i].segment);
+		slots[i].sequence = -1;
+		slots[i].segment = NULL;
+		slots[i].time = 0;
+		slots[i].pending = false;
+	}
+
+	order.clear();
+}
+
+void RetransmitStore::release(size_t slot)
+{
+	if (slots[slot].segment == NULL)
+		return;
+
+	unref(slots[slot].segment);
+	slots[slot].segment = NULL;
+
+	// usually the oldest
+	std::deque<size_t>::iterator it = std::find(order.begin(), order.end(), slot);
+	if (it != order.end())
+		order.erase(it);
+}
+
+const RetransmitStore::slot_t *RetransmitStore::lookup(int sequence) const
+{
+	const slot_t *slot = &slots[sequence & (NUM_SLOTS - 1)];
+
+	if (sequence < 0 || slot->sequence != sequence)
+		return NULL;
+
+	return slot;
+}
+
+bool RetransmitStore::busy(int sequence) const
+{
+	return slots[sequence & (NUM_SLOTS - 1)].segment != NULL;
+}
+
+bool RetransmitStore::store(int sequence, buf_t &buf, dtime_t time)
+{
+	size_t slot = sequence & (NUM_SLOTS - 1);
+
+	if (busy(sequence))
+		return false;
+
+	slots[slot].sequence = sequence;
+	slots[slot].time = time;
+	slots[slot].pending = true;
+
+	if (buf.size() == 0)
+		return true;
+
+	segment_t *segment = alloc();
+	segment->buf.swap(buf);
+	buf.clear();
+
+	slots[slot].segment = segment;
+	order.push_back(slot);
+
+	return true;
+}
+
+bool RetransmitStore::find(int sequence, const byte *&data, size_t &size) const
+{
+	const slot_t *slot = lookup(sequence);
+
+	if (slot == NULL)
+		return false;
+
+	if (slot->segment)
+	{
+		data = slot->segment->buf.ptr();
+		size = slot->segment->buf.size();
+	}
+	else
+	{
+		data = NULL;
+		size = 0;
+	}
+
+	return true;
+}
+
+bool RetransmitStore::ack(int sequence, dtime_t &time)
+{
+	if (lookup(sequence) == NULL)
+		return false;
+
+	size_t slot = sequence & (NUM_SLOTS - 1);
+
+	if (!slots[slot].pending)
+		return false;
+
+	release(slot);
+	slots[slot].pending = false;
+	time = slots[slot].time;
+
+	return true;
+}
+
+void RetransmitStore::forget(int sequence)
+{
+	if (lookup(sequence) == NULL)
+		return;
+
+	size_t slot = sequence & (NUM_SLOTS - 1);
+
+	release(slot);
+	slots[slot].pending = false;
+}
+
+bool RetransmitStore::oldest(int &sequence, dtime_t &time) const
+{
+	if (order.empty())
+		return false;
+
+	const slot_t &slot = slots[order.front()];
+
+	sequence = slot.sequence;
+	time = slot.time;
+
+	return true;
+}
+
+VERSION_CONTROL (i_retransmit_cpp, "$Id$")
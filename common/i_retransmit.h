@@ -0,0 +1,113 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Reference-counted store of reliable packet data for retransmission.
+//
+//	Rather than copying each client's reliable buffer into a separate
+//	history buffer, the store takes over the memory the reliable messages
+//	were written into and hands the client a recycled buffer in exchange.
+//	Segments are shared, not copied, when a client_t is copied, and go
+//	back to a common free list once nothing refers to them.
+//
+//	Packets are kept in a ring indexed by their sequence number until
+//	the client acknowledges them or they are resent, along with the time
+//	they were sent for round trip time measurement.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __I_RETRANSMIT_H__
+#define __I_RETRANSMIT_H__
+
+#include "doomtype.h"
+#include "i_net.h"
+
+#include <deque>
+#include <vector>
+
+class RetransmitStore
+{
+public:
+	// packets that can be awaiting acknowledgement, must be a power of 2.
+	// Reliable data is kept until it is acknowledged or resent, so a client
+	// holds at most this many segments.
+	static const size_t NUM_SLOTS = 256;
+
+	RetransmitStore();
+	RetransmitStore(const RetransmitStore &other);
+	RetransmitStore &operator=(const RetransmitStore &other);
+	~RetransmitStore();
+
+	void clear();
+
+	// True if the slot packet [sequence] goes in still holds reliable data
+	// that has not been acknowledged or resent.
+	bool busy(int sequence) const;
+
+	// Record packet [sequence], sent at [time].  The contents of buf become
+	// the saved reliable data and buf is left empty.  Returns false and
+	// leaves buf alone if the slot is busy.
+	bool store(int sequence, buf_t &buf, dtime_t time);
+
+	// Find the reliable data sent with packet [sequence].  Returns false if
+	// the packet is no longer known.  Packets without reliable data are
+	// found with a size of zero.
+	bool find(int sequence, const byte *&data, size_t &size) const;
+
+	// Mark packet [sequence] as received by the client and drop its data.
+	// Returns false if it was not waiting for an acknowledgement, otherwise
+	// the time it was sent is returned in [time].
+	bool ack(int sequence, dtime_t &time);
+
+	// Drop the data of packet [sequence] after it has been resent.
+	void forget(int sequence);
+
+	// The oldest packet whose reliable data is waiting for an
+	// acknowledgement.  Returns false if there is none.
+	bool oldest(int &sequence, dtime_t &time) const;
+
+private:
+	struct segment_t
+	{
+		buf_t	buf;
+		int		refs;
+
+		segment_t() : buf(MAX_UDP_PACKET), refs(0) {}
+	};
+
+	struct slot_t
+	{
+		int			sequence;
+		segment_t	*segment;
+		dtime_t		time;
+		bool		pending;	// not yet acknowledged or resent
+	};
+
+	slot_t				slots[NUM_SLOTS];
+	std::deque<size_t>	order;		// slots holding a segment, oldest first
+
+	void release(size_t slot);
+	const slot_t *lookup(int sequence) const;
+	void copy(const RetransmitStore &other);
+
+	static segment_t *alloc();
+	static void unref(segment_t *segment);
+	static std::vector<segment_t *> &free_segments();
+};
+
+#endif	// __I_RETRANSMIT_H__
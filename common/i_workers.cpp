@@ -0,0 +1,218 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	A small pool of worker threads for splitting work inside a tic.
+//
+//-----------------------------------------------------------------------------
+
+#include "win32inc.h"
+#include "doomtype.h"
+#include "i_workers.h"
+
+#if defined(GEKKO) || defined(_XBOX)
+	#define WORKERS_NONE
+#elif defined(_WIN32)
+	#define WORKERS_WIN32
+#else
+	#include <pthread.h>
+	#define WORKERS_PTHREAD
+#endif
+
+// the calling thread always runs part 0
+static const int MAX_WORKERS = 15;
+
+static workerfunc_t job_func;
+static void *job_data;
+static int job_parts;
+
+static int num_workers = 0;
+static bool workers_failed = false;
+
+#if defined(WORKERS_PTHREAD)
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+
+static unsigned int job_generation = 0;		// bumped for every job
+static int job_remaining = 0;				// parts still running on workers
+static unsigned int worker_generation[MAX_WORKERS];
+
+static void *I_WorkerThread(void *arg)
+{
+	int index = (int)(size_t)arg;
+
+	pthread_mutex_lock(&job_lock);
+
+	for (;;)
+	{
+		while (worker_generation[index] == job_generation)
+			pthread_cond_wait(&job_wake, &job_lock);
+
+		worker_generation[index] = job_generation;
+
+		int part = index + 1;
+		if (part >= job_parts)
+			continue;
+
+		pthread_mutex_unlock(&job_lock);
+		job_func(part, job_parts, job_data);
+		pthread_mutex_lock(&job_lock);
+
+		if (--job_remaining == 0)
+			pthread_cond_signal(&job_done);
+	}
+
+	return NULL;
+}
+
+static bool I_StartWorkers(int count)
+{
+	while (num_workers < count)
+	{
+		pthread_t thread;
+
+		worker_generation[num_workers] = job_generation;
+		if (pthread_create(&thread, NULL, I_WorkerThread, (void *)(size_t)num_workers) != 0)
+			return false;
+
+		pthread_detach(thread);
+		num_workers++;
+	}
+
+	return true;
+}
+
+static void I_RunJob()
+{
+	pthread_mutex_lock(&job_lock);
+	job_remaining = job_parts - 1;
+	job_generation++;
+	pthread_cond_broadcast(&job_wake);
+	pthread_mutex_unlock(&job_lock);
+
+	job_func(0, job_parts, job_data);
+
+	pthread_mutex_lock(&job_lock);
+	while (job_remaining > 0)
+		pthread_cond_wait(&job_done, &job_lock);
+	pthread_mutex_unlock(&job_lock);
+}
+
+#elif defined(WORKERS_WIN32)
+
+static HANDLE worker_start[MAX_WORKERS];
+static HANDLE job_done = NULL;
+static volatile LONG job_remaining = 0;
+
+static DWORD WINAPI I_WorkerThread(LPVOID arg)
+{
+	int index = (int)(size_t)arg;
+
+	for (;;)
+	{
+		WaitForSingleObject(worker_start[index], INFINITE);
+
+		job_func(index + 1, job_parts, job_data);
+
+		if (InterlockedDecrement(&job_remaining) == 0)
+			SetEvent(job_done);
+	}
+
+	return 0;
+}
+
+static bool I_StartWorkers(int count)
+{
+	if (job_done == NULL && (job_done = CreateEvent(NULL, FALSE, FALSE, NULL)) == NULL)
+		return false;
+
+	while (num_workers < count)
+	{
+		worker_start[num_workers] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if (worker_start[num_workers] == NULL)
+			return false;
+
+		HANDLE thread = CreateThread(NULL, 0, I_WorkerThread, (LPVOID)(size_t)num_workers, 0, NULL);
+		if (thread == NULL)
+		{
+			CloseHandle(worker_start[num_workers]);
+			return false;
+		}
+
+		CloseHandle(thread);
+		num_workers++;
+	}
+
+	return true;
+}
+
+static void I_RunJob()
+{
+	job_remaining = job_parts - 1;
+
+	for (int i = 0; i < job_parts - 1; i++)
+		SetEvent(worker_start[i]);
+
+	job_func(0, job_parts, job_data);
+
+	WaitForSingleObject(job_done, INFINITE);
+}
+
+#endif
+
+//
+// I_RunParallel
+//
+// numparts is lowered to the number of threads that can be used, so func
+// has to go by the numparts it is called with.
+//
+void I_RunParallel(workerfunc_t func, void *data, int numparts)
+{
+	if (numparts > MAX_WORKERS + 1)
+		numparts = MAX_WORKERS + 1;
+
+#ifndef WORKERS_NONE
+	if (numparts > 1 && !workers_failed && !I_StartWorkers(numparts - 1))
+	{
+		// make do with the ones that did start
+		workers_failed = true;
+	}
+
+	if (workers_failed && numparts > num_workers + 1)
+		numparts = num_workers + 1;
+
+	if (numparts > 1)
+	{
+		job_func = func;
+		job_data = data;
+		job_parts = numparts;
+
+		I_RunJob();
+		return;
+	}
+#endif
+
+	if (numparts < 1)
+		numparts = 1;
+
+	for (int part = 0; part < numparts; part++)
+		func(part, numparts, data);
+}
+
+VERSION_CONTROL (i_workers_cpp, "$Id$")
@@ -0,0 +1,38 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	A small pool of worker threads for splitting work inside a tic.
+//
+//	The workers are started the first time they are needed and then wait
+//	for more work until the program exits.  Platforms without threads run
+//	every part on the calling thread.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __I_WORKERS_H__
+#define __I_WORKERS_H__
+
+typedef void (*workerfunc_t)(int part, int numparts, void *data);
+
+// Calls func once for every part in [0, numparts), spreading the parts over
+// the worker threads and the calling thread.  Returns once every part is
+// done.  func must not touch anything another part could be touching.
+void I_RunParallel(workerfunc_t func, void *data, int numparts);
+
+#endif	// __I_WORKERS_H__
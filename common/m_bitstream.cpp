@@ -0,0 +1,227 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Bit-level packed reading and writing on top of buf_t.
+//
+//-----------------------------------------------------------------------------
+
+#include "m_bitstream.h"
+
+// clamps a bit count to what fits in a uint32_t
+static inline int BitCount(int bits)
+{
+	return bits < 0 ? 0 : bits > 32 ? 32 : bits;
+}
+
+static inline uint32_t BitMask(int bits)
+{
+	return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+}
+
+//
+// BitWriter
+//
+
+BitWriter::BitWriter(buf_t &b) : buf(b), accum(0), accumbits(0), bitswritten(0)
+{
+}
+
+void BitWriter::WriteBits(uint32_t value, int bits)
+{
+	bits = BitCount(bits);
+	if (bits == 0)
+		return;
+
+	accum |= uint64_t(value & BitMask(bits)) << accumbits;
+	accumbits += bits;
+	bitswritten += bits;
+
+	while (accumbits >= 8)
+	{
+		MSG_WriteByte(&buf, byte(accum & 0xFF));
+		accum >>= 8;
+		accumbits -= 8;
+	}
+}
+
+void BitWriter::WriteBool(bool value)
+{
+	WriteBits(value ? 1 : 0, 1);
+}
+
+void BitWriter::WriteVarUInt(uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		WriteBits((value & 0x7F) | 0x80, 8);
+		value >>= 7;
+	}
+	WriteBits(value, 8);
+}
+
+void BitWriter::WriteVarInt(int32_t value)
+{
+	WriteVarUInt(ZigZagEncode(value));
+}
+
+void BitWriter::WriteDelta(int32_t value, int32_t base)
+{
+	WriteVarUInt(ZigZagEncode(int32_t(uint32_t(value) - uint32_t(base))));
+}
+
+void BitWriter::WriteAngle(angle_t angle, int bits)
+{
+	if (bits <= 0 || bits > 32)
+		bits = 32;
+
+	// round to the nearest representable angle rather than truncating
+	if (bits < 32)
+		angle += 1u << (31 - bits);
+
+	WriteBits(angle >> (32 - bits), bits);
+}
+
+//
+// BitWriter::WriteFixedRange
+//
+// Both the offset from min and the number of steps fit in 32 bits, so
+// their product can't overflow a uint64_t.
+//
+void BitWriter::WriteFixedRange(fixed_t value, fixed_t min, fixed_t max, int bits)
+{
+	bits = BitCount(bits);
+
+	if (value < min)
+		value = min;
+	if (value > max)
+		value = max;
+
+	const uint64_t range = uint64_t(int64_t(max) - int64_t(min));
+	const uint64_t steps = BitMask(bits);
+	uint32_t q = 0;
+
+	if (max > min)
+		q = uint32_t(((uint64_t(int64_t(value) - int64_t(min))) * steps + range / 2) / range);
+
+	WriteBits(q, bits);
+}
+
+void BitWriter::Flush()
+{
+	if (accumbits > 0)
+	{
+		bitswritten += 8 - accumbits;
+		MSG_WriteByte(&buf, byte(accum & 0xFF));
+	}
+
+	accum = 0;
+	accumbits = 0;
+}
+
+//
+// BitReader
+//
+
+BitReader::BitReader(buf_t &b) : buf(b), accum(0), accumbits(0)
+{
+}
+
+uint32_t BitReader::ReadBits(int bits)
+{
+	bits = BitCount(bits);
+	if (bits == 0)
+		return 0;
+
+	while (accumbits < bits)
+	{
+		int b = buf.ReadByte();
+		if (b < 0)
+			return 0;
+
+		accum |= uint64_t(b) << accumbits;
+		accumbits += 8;
+	}
+
+	uint32_t value = uint32_t(accum) & BitMask(bits);
+	accum >>= bits;
+	accumbits -= bits;
+
+	return value;
+}
+
+bool BitReader::ReadBool()
+{
+	return ReadBits(1) != 0;
+}
+
+uint32_t BitReader::ReadVarUInt()
+{
+	uint32_t value = 0;
+
+	// a uint32_t never needs more than five groups
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		uint32_t group = ReadBits(8);
+		value |= (group & 0x7F) << shift;
+
+		if (!(group & 0x80) || buf.overflowed)
+			break;
+	}
+
+	return value;
+}
+
+int32_t BitReader::ReadVarInt()
+{
+	return ZigZagDecode(ReadVarUInt());
+}
+
+int32_t BitReader::ReadDelta(int32_t base)
+{
+	return int32_t(uint32_t(base) + uint32_t(ReadVarInt()));
+}
+
+angle_t BitReader::ReadAngle(int bits)
+{
+	if (bits <= 0 || bits > 32)
+		bits = 32;
+
+	return bits == 32 ? ReadBits(32) : ReadBits(bits) << (32 - bits);
+}
+
+fixed_t BitReader::ReadFixedRange(fixed_t min, fixed_t max, int bits)
+{
+	bits = BitCount(bits);
+
+	const uint64_t range = uint64_t(int64_t(max) - int64_t(min));
+	const uint64_t steps = BitMask(bits);
+	uint32_t q = ReadBits(bits);
+
+	if (max <= min || steps == 0)
+		return min;
+
+	return fixed_t(int64_t(min) + int64_t((uint64_t(q) * range + steps / 2) / steps));
+}
+
+void BitReader::Align()
+{
+	accum = 0;
+	accumbits = 0;
+}
+
+VERSION_CONTROL (m_bitstream_cpp, "$Id$")
@@ -0,0 +1,117 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Bit-level packed reading and writing on top of buf_t.
+//
+//	The MSG_Write* functions are byte aligned, so a bool costs a whole byte
+//	and an angle always costs 32 bits.  BitWriter packs values LSB-first
+//	into a running accumulator and appends whole bytes to the underlying
+//	buf_t as they fill up.  Flush() has to be called once the message is
+//	complete to pad and append the final partial byte; nothing is written
+//	for it otherwise.  BitReader::Align() skips the same padding on the
+//	receiving end so that byte-aligned reads can resume.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __M_BITSTREAM_H__
+#define __M_BITSTREAM_H__
+
+#include "doomtype.h"
+#include "m_fixed.h"
+#include "tables.h"
+#include "i_net.h"
+
+class BitWriter
+{
+public:
+	BitWriter(buf_t &buf);
+
+	void WriteBits(uint32_t value, int bits);
+	void WriteBool(bool value);
+
+	// variable-length unsigned integer, 7 bits per group plus a
+	// continuation bit.  Values under 128 cost 8 bits.
+	void WriteVarUInt(uint32_t value);
+
+	// zig-zag encoded so that small negative values stay small
+	void WriteVarInt(int32_t value);
+
+	// delta against a value both ends already know, zig-zag encoded
+	void WriteDelta(int32_t value, int32_t base);
+
+	// the top [bits] bits of a binary angle
+	void WriteAngle(angle_t angle, int bits);
+
+	// a fixed_t clamped to [min, max] and quantized to [bits] bits
+	void WriteFixedRange(fixed_t value, fixed_t min, fixed_t max, int bits);
+
+	// pad the last partial byte with zeros and append it to the buffer
+	void Flush();
+
+	size_t BitsWritten() const { return bitswritten; }
+
+private:
+	buf_t		&buf;
+	uint64_t	accum;
+	int			accumbits;
+	size_t		bitswritten;
+
+	// not copyable
+	BitWriter(const BitWriter &);
+	BitWriter &operator=(const BitWriter &);
+};
+
+class BitReader
+{
+public:
+	BitReader(buf_t &buf);
+
+	uint32_t ReadBits(int bits);
+	bool ReadBool();
+	uint32_t ReadVarUInt();
+	int32_t ReadVarInt();
+	int32_t ReadDelta(int32_t base);
+	angle_t ReadAngle(int bits);
+	fixed_t ReadFixedRange(fixed_t min, fixed_t max, int bits);
+
+	// discard the padding bits of the current byte
+	void Align();
+
+	bool overflowed() const { return buf.overflowed; }
+
+private:
+	buf_t		&buf;
+	uint64_t	accum;
+	int			accumbits;
+
+	BitReader(const BitReader &);
+	BitReader &operator=(const BitReader &);
+};
+
+inline uint32_t ZigZagEncode(int32_t value)
+{
+	return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+inline int32_t ZigZagDecode(uint32_t value)
+{
+	return int32_t(value >> 1) ^ -int32_t(value & 1);
+}
+
+#endif	// __M_BITSTREAM_H__
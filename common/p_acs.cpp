@@ -421,6 +421,10 @@ FBehavior::FBehavior (BYTE *object, int len)
 	Arrays = NULL;
 	Chunks = NULL;
 
+	// anything that doesn't lead to code ends up at this terminate
+	Code.push_back (DLevelScript::PCD_TERMINATE);
+	CodeOfs.push_back (0);
+
 	if (object[0] != 'A' || object[1] != 'C' || object[2] != 'S')
 	{
 		Format = ACS_Unknown;
@@ -574,6 +578,8 @@ FBehavior::FBehavior (BYTE *object, int len)
 		}
 	}
 
+	CodeIndex.resize (DataSize, -1);
+
 	DPrintf ("Loaded %d scripts, %d Functions\n", NumScripts, NumFunctions);
 }
 
@@ -853,12 +859,435 @@ void FBehavior::StartTypedScripts (WORD type, AActor *activator, int arg0, int a
 	}
 }
 
+//
+// PCodeOperands
+//
+// The operands following each p-code: W is a word, B is a byte and V is
+// a byte in the little-endian enhanced format and a word otherwise.
+// PCD_PUSHBYTES is followed by its own byte count.
+//
+static const char *PCodeOperands (int pcd)
+{
+	switch (pcd)
+	{
+	case DLevelScript::PCD_PUSHNUMBER:
+	case DLevelScript::PCD_GOTO:
+	case DLevelScript::PCD_IFGOTO:
+	case DLevelScript::PCD_IFNOTGOTO:
+	case DLevelScript::PCD_DELAYDIRECT:
+	case DLevelScript::PCD_TAGWAITDIRECT:
+	case DLevelScript::PCD_POLYWAITDIRECT:
+	case DLevelScript::PCD_SCRIPTWAITDIRECT:
+	case DLevelScript::PCD_SETFONTDIRECT:
+	case DLevelScript::PCD_SETGRAVITYDIRECT:
+	case DLevelScript::PCD_SETAIRCONTROLDIRECT:
+	case DLevelScript::PCD_CHECKINVENTORYDIRECT:
+		return "W";
+
+	case DLevelScript::PCD_RANDOMDIRECT:
+	case DLevelScript::PCD_THINGCOUNTDIRECT:
+	case DLevelScript::PCD_CHANGEFLOORDIRECT:
+	case DLevelScript::PCD_CHANGECEILINGDIRECT:
+	case DLevelScript::PCD_GIVEINVENTORYDIRECT:
+	case DLevelScript::PCD_TAKEINVENTORYDIRECT:
+	case DLevelScript::PCD_CASEGOTO:
+		return "WW";
+
+	case DLevelScript::PCD_SETMUSICDIRECT:
+	case DLevelScript::PCD_LOCALSETMUSICDIRECT:
+		return "WWW";
+
+	case DLevelScript::PCD_SPAWNSPOTDIRECT:
+		return "WWWW";
+
+	case DLevelScript::PCD_SPAWNDIRECT:
+		return "WWWWWW";
+
+	case DLevelScript::PCD_PUSHBYTE:
+	case DLevelScript::PCD_DELAYDIRECTB:
+		return "B";
+
+	case DLevelScript::PCD_PUSH2BYTES:
+	case DLevelScript::PCD_RANDOMDIRECTB:
+	case DLevelScript::PCD_LSPEC1DIRECTB:
+		return "BB";
+
+	case DLevelScript::PCD_PUSH3BYTES:
+	case DLevelScript::PCD_LSPEC2DIRECTB:
+		return "BBB";
+
+	case DLevelScript::PCD_PUSH4BYTES:
+	case DLevelScript::PCD_LSPEC3DIRECTB:
+		return "BBBB";
+
+	case DLevelScript::PCD_PUSH5BYTES:
+	case DLevelScript::PCD_LSPEC4DIRECTB:
+		return "BBBBB";
+
+	case DLevelScript::PCD_LSPEC5DIRECTB:
+		return "BBBBBB";
+
+	case DLevelScript::PCD_LSPEC1DIRECT:	return "VW";
+	case DLevelScript::PCD_LSPEC2DIRECT:	return "VWW";
+	case DLevelScript::PCD_LSPEC3DIRECT:	return "VWWW";
+	case DLevelScript::PCD_LSPEC4DIRECT:	return "VWWWW";
+	case DLevelScript::PCD_LSPEC5DIRECT:	return "VWWWWW";
+
+	case DLevelScript::PCD_LSPEC1:
+	case DLevelScript::PCD_LSPEC2:
+	case DLevelScript::PCD_LSPEC3:
+	case DLevelScript::PCD_LSPEC4:
+	case DLevelScript::PCD_LSPEC5:
+	case DLevelScript::PCD_CALL:
+	case DLevelScript::PCD_CALLDISCARD:
+	case DLevelScript::PCD_ASSIGNSCRIPTVAR:
+	case DLevelScript::PCD_ASSIGNMAPVAR:
+	case DLevelScript::PCD_ASSIGNWORLDVAR:
+	case DLevelScript::PCD_ASSIGNGLOBALVAR:
+	case DLevelScript::PCD_ASSIGNMAPARRAY:
+	case DLevelScript::PCD_PUSHSCRIPTVAR:
+	case DLevelScript::PCD_PUSHMAPVAR:
+	case DLevelScript::PCD_PUSHWORLDVAR:
+	case DLevelScript::PCD_PUSHGLOBALVAR:
+	case DLevelScript::PCD_PUSHMAPARRAY:
+	case DLevelScript::PCD_ADDSCRIPTVAR:
+	case DLevelScript::PCD_ADDMAPVAR:
+	case DLevelScript::PCD_ADDWORLDVAR:
+	case DLevelScript::PCD_ADDGLOBALVAR:
+	case DLevelScript::PCD_ADDMAPARRAY:
+	case DLevelScript::PCD_SUBSCRIPTVAR:
+	case DLevelScript::PCD_SUBMAPVAR:
+	case DLevelScript::PCD_SUBWORLDVAR:
+	case DLevelScript::PCD_SUBGLOBALVAR:
+	case DLevelScript::PCD_SUBMAPARRAY:
+	case DLevelScript::PCD_MULSCRIPTVAR:
+	case DLevelScript::PCD_MULMAPVAR:
+	case DLevelScript::PCD_MULWORLDVAR:
+	case DLevelScript::PCD_MULGLOBALVAR:
+	case DLevelScript::PCD_MULMAPARRAY:
+	case DLevelScript::PCD_DIVSCRIPTVAR:
+	case DLevelScript::PCD_DIVMAPVAR:
+	case DLevelScript::PCD_DIVWORLDVAR:
+	case DLevelScript::PCD_DIVGLOBALVAR:
+	case DLevelScript::PCD_DIVMAPARRAY:
+	case DLevelScript::PCD_MODSCRIPTVAR:
+	case DLevelScript::PCD_MODMAPVAR:
+	case DLevelScript::PCD_MODWORLDVAR:
+	case DLevelScript::PCD_MODGLOBALVAR:
+	case DLevelScript::PCD_MODMAPARRAY:
+	case DLevelScript::PCD_INCSCRIPTVAR:
+	case DLevelScript::PCD_INCMAPVAR:
+	case DLevelScript::PCD_INCWORLDVAR:
+	case DLevelScript::PCD_INCGLOBALVAR:
+	case DLevelScript::PCD_INCMAPARRAY:
+	case DLevelScript::PCD_DECSCRIPTVAR:
+	case DLevelScript::PCD_DECMAPVAR:
+	case DLevelScript::PCD_DECWORLDVAR:
+	case DLevelScript::PCD_DECGLOBALVAR:
+	case DLevelScript::PCD_DECMAPARRAY:
+		return "V";
+
+	default:
+		return "";
+	}
+}
+
+//
+// FBehavior::Decode
+//
+// Translates the code starting at ofs into Code, up to the first
+// instruction that doesn't fall through to the next one.  Every operand
+// becomes a full int in native byte order, so the interpreter never has to
+// look at the format of the lump.  Jump targets stay offsets into Data and
+// are translated by Ofs2Insn when they are taken.
+//
+// Code is decoded the first time it is run rather than all at once, as
+// there is no telling where the code in a lump ends and the data begins.
+//
+void FBehavior::Decode (DWORD ofs)
+{
+	while (ofs < (DWORD)DataSize)
+	{
+		if (CodeIndex[ofs] >= 0)
+		{
+			// ran into code that is decoded already
+			Code.push_back (DLevelScript::PCD_GOTO);
+			Code.push_back (ofs);
+			CodeOfs.resize (Code.size(), ofs);
+			return;
+		}
+
+		size_t start = Code.size();
+		DWORD next = ofs;
+		int pcd;
+
+		if (Format == ACS_LittleEnhanced)
+		{
+			pcd = Data[next++];
+		}
+		else
+		{
+			if (next + 4 > (DWORD)DataSize)
+				break;
+			pcd = LELONG(*(int *)(Data + next));
+			next += 4;
+		}
+
+		Code.push_back (pcd);
+
+		bool complete = true;
+
+		if (pcd == DLevelScript::PCD_PUSHBYTES)
+		{
+			int count = (next < (DWORD)DataSize) ? Data[next++] : 0;
+
+			Code.push_back (count);
+			if (next + count > (DWORD)DataSize)
+				complete = false;
+			else
+				for (; count > 0; count--)
+					Code.push_back (Data[next++]);
+		}
+
+		for (const char *op = PCodeOperands (pcd); complete && *op; op++)
+		{
+			DWORD size = (*op == 'W' || (*op == 'V' && Format != ACS_LittleEnhanced)) ? 4 : 1;
+
+			if (next + size > (DWORD)DataSize)
+			{
+				complete = false;
+				break;
+			}
+
+			Code.push_back (size == 4 ? LELONG(*(int *)(Data + next)) : Data[next]);
+			next += size;
+		}
+
+		if (!complete)
+		{
+			// the operands run off the end of the code
+			Code.resize (start);
+			break;
+		}
+
+		CodeIndex[ofs] = start;
+		CodeOfs.resize (Code.size(), ofs);
+		ofs = next;
+
+		if (pcd == DLevelScript::PCD_TERMINATE ||
+			pcd == DLevelScript::PCD_RESTART ||
+			pcd == DLevelScript::PCD_GOTO ||
+			pcd == DLevelScript::PCD_RETURNVOID ||
+			pcd == DLevelScript::PCD_RETURNVAL ||
+			(unsigned)pcd >= DLevelScript::PCODE_COMMAND_COUNT)
+		{
+			return;
+		}
+	}
+
+	// ran off the end of the code
+	if (ofs < (DWORD)DataSize)
+		CodeIndex[ofs] = Code.size();
+	Code.push_back (DLevelScript::PCD_TERMINATE);
+	CodeOfs.push_back (ofs);
+}
+
+int *FBehavior::Ofs2Insn (DWORD ofs)
+{
+	if (ofs >= CodeIndex.size())
+		return &Code[0];
+
+	if (CodeIndex[ofs] < 0)
+		Decode (ofs);
+
+	return &Code[CodeIndex[ofs]];
+}
+
+DWORD FBehavior::Insn2Ofs (const int *insn) const
+{
+	size_t index = insn - &Code[0];
+
+	if (index >= CodeOfs.size())
+		return DataSize;
+
+	return CodeOfs[index];
+}
+
+//
+// FBehavior::IsInsn
+//
+// Whether insn is the start of a decoded instruction rather than one of
+// its operands.
+//
+bool FBehavior::IsInsn (const int *insn) const
+{
+	size_t index = insn - &Code[0];
+
+	if (index >= CodeOfs.size())
+		return false;
+
+	return index == 0 || CodeOfs[index] != CodeOfs[index - 1];
+}
+
+//
+// ReadLumpInsn
+//
+// Reads the instruction at p straight from the lump the way the
+// interpreter did before code was decoded, into the ints Decode should
+// have made of it.  Returns how many there are or 0 if the instruction
+// runs past end.
+//
+static int ReadLumpInsn (const BYTE *p, const BYTE *end, ACSFormat fmt, int *out)
+{
+	int n = 0;
+	int pcd;
+
+	if (fmt == ACS_LittleEnhanced)
+	{
+		if (p >= end)
+			return 0;
+		pcd = *p++;
+	}
+	else
+	{
+		if (p + 4 > end)
+			return 0;
+		pcd = LELONG(*(int *)p);
+		p += 4;
+	}
+
+	out[n++] = pcd;
+
+	if (pcd == DLevelScript::PCD_PUSHBYTES)
+	{
+		if (p >= end)
+			return 0;
+
+		int count = *p++;
+		out[n++] = count;
+
+		if (p + count > end)
+			return 0;
+		for (; count > 0; count--)
+			out[n++] = *p++;
+	}
+
+	for (const char *op = PCodeOperands (pcd); *op; op++)
+	{
+		if (*op == 'B' || (*op == 'V' && fmt == ACS_LittleEnhanced))
+		{
+			if (p >= end)
+				return 0;
+			out[n++] = *p++;
+		}
+		else
+		{
+			if (p + 4 > end)
+				return 0;
+			out[n++] = LELONG(*(int *)p);
+			p += 4;
+		}
+	}
+
+	return n;
+}
+
+void FBehavior::Benchmark (int passes)
+{
+	dtime_t start = I_GetTime ();
+
+	for (int i = 0; i < NumScripts; i++)
+		Ofs2Insn (((ScriptPtr *)Scripts)[i].Address);
+	for (int i = 0; i < NumFunctions; i++)
+		Ofs2Insn (((ScriptFunction *)Functions)[i].Address);
+
+	dtime_t decodetime = I_GetTime () - start;
+
+	// Every instruction that came from the lump.  This leaves out the
+	// terminate at 0 and the gotos that join code decoded at different
+	// times, which CodeIndex doesn't point to.
+	std::vector<size_t> insns;
+	std::vector<int> lengths;
+	int mismatched = 0;
+	int lump[2 + 255 + 6];
+
+	for (size_t i = 1; i < Code.size(); i++)
+	{
+		if (!IsInsn (&Code[i]) || CodeOfs[i] >= (DWORD)DataSize ||
+			CodeIndex[CodeOfs[i]] != (int)i)
+			continue;
+
+		int n = ReadLumpInsn (Data + CodeOfs[i], Data + DataSize, Format, lump);
+
+		// the terminate Decode puts where code runs off the end
+		if (n == 0)
+			continue;
+
+		if (i + n > Code.size() || (i + n < Code.size() && !IsInsn (&Code[i + n])) ||
+			memcmp (&Code[i], lump, n * sizeof(int)) != 0)
+		{
+			Printf (PRINT_HIGH, "P-Code %d at %u was decoded wrong\n", lump[0], CodeOfs[i]);
+			mismatched++;
+			continue;
+		}
+
+		insns.push_back (i);
+		lengths.push_back (n);
+	}
+
+	// the sums keep the loops from being optimized away and should match
+	int lumpsum = 0, codesum = 0;
+
+	start = I_GetTime ();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (size_t i = 0; i < insns.size(); i++)
+		{
+			int n = ReadLumpInsn (Data + CodeOfs[insns[i]], Data + DataSize, Format, lump);
+			for (int j = 0; j < n; j++)
+				lumpsum += lump[j];
+		}
+	}
+	dtime_t lumptime = I_GetTime () - start;
+
+	start = I_GetTime ();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (size_t i = 0; i < insns.size(); i++)
+		{
+			const int *insn = &Code[insns[i]];
+			for (int j = 0; j < lengths[i]; j++)
+				codesum += insn[j];
+		}
+	}
+	dtime_t codetime = I_GetTime () - start;
+
+	double ms = (double)I_ConvertTimeFromMs (1);
+	double count = (double)insns.size() * passes;
+
+	Printf (PRINT_HIGH, "%d instructions from %d bytes decoded to %d ints in %.3f ms\n",
+		(int)insns.size(), DataSize, (int)Code.size(), decodetime / ms);
+	Printf (PRINT_HIGH, "%d decoded wrong\n", mismatched);
+
+	if (count > 0)
+	{
+		Printf (PRINT_HIGH, "reading operands: %.2f ns from the lump, %.2f ns decoded%s\n",
+			lumptime / ms * 1000000.0 / count, codetime / ms * 1000000.0 / count,
+			lumpsum == codesum ? "" : " (sums differ)");
+	}
+}
+
 //---- The ACS Interpreter ----//
 
 
 
-#define NEXTWORD	(LELONG(*pc++))
-#define NEXTBYTE	(fmt==ACS_LittleEnhanced?getbyte(pc):NEXTWORD)
+// for acsstats
+static QWORD acs_pcodes = 0;
+static dtime_t acs_time = 0;
+
+// operands are all ints once the code is decoded
+#define NEXTWORD	(*pc++)
+#define NEXTBYTE	(*pc++)
 #define STACK(a)	(Stack[sp - (a)])
 #define PushToStack(a)	(Stack[sp++] = (a))
 
@@ -1536,13 +1965,6 @@ void DLevelScript::DoFadeRange(int r1, int g1, int b1, int a1,
 }
 
 
-inline int getbyte (int *&pc)
-{
-	int res = *(BYTE *)pc;
-	pc = (int *)((BYTE *)pc+1);
-	return res;
-}
-
 void DLevelScript::RunScript ()
 {
 	DACSThinker *controller = DACSThinker::ActiveThinker;
@@ -1604,9 +2026,9 @@ void DLevelScript::RunScript ()
 		break;
 	}
 
-	int *pc = this->pc;
+	dtime_t starttime = I_GetTime ();
+	int *pc = level.behavior->PC2Insn (this->pc);
 	int sp = this->sp;
-	const ACSFormat fmt = level.behavior->GetFormat();
 	int runaway = 0;	// used to prevent infinite loops
 	int pcd;
 	char work[4096], *workwhere = work;
@@ -1623,6 +2045,17 @@ void DLevelScript::RunScript ()
 			break;
 		}
 
+#ifdef ODAMEX_DEBUG
+		// the last p-code used a different number of operands than
+		// PCodeOperands gave it
+		if (!level.behavior->IsInsn (pc))
+		{
+			Printf (PRINT_HIGH, "P-Code %d in script %d misread its operands\n", pcd, script);
+			state = SCRIPT_PleaseRemove;
+			break;
+		}
+#endif
+
 		pcd = NEXTBYTE;
 		switch (pcd)
 		{
@@ -1645,50 +2078,50 @@ void DLevelScript::RunScript ()
 			break;
 
 		case PCD_PUSHBYTE:
-			PushToStack (*(BYTE *)pc);
-			pc = (int *)((BYTE *)pc + 1);
+			PushToStack (*pc);
+			pc += 1;
 			break;
 
 		case PCD_PUSH2BYTES:
-			Stack[sp] = ((BYTE *)pc)[0];
-			Stack[sp+1] = ((BYTE *)pc)[1];
+			Stack[sp] = pc[0];
+			Stack[sp+1] = pc[1];
 			sp += 2;
-			pc = (int *)((BYTE *)pc + 2);
+			pc += 2;
 			break;
 
 		case PCD_PUSH3BYTES:
-			Stack[sp] = ((BYTE *)pc)[0];
-			Stack[sp+1] = ((BYTE *)pc)[1];
-			Stack[sp+2] = ((BYTE *)pc)[2];
+			Stack[sp] = pc[0];
+			Stack[sp+1] = pc[1];
+			Stack[sp+2] = pc[2];
 			sp += 3;
-			pc = (int *)((BYTE *)pc + 3);
+			pc += 3;
 			break;
 
 		case PCD_PUSH4BYTES:
-			Stack[sp] = ((BYTE *)pc)[0];
-			Stack[sp+1] = ((BYTE *)pc)[1];
-			Stack[sp+2] = ((BYTE *)pc)[2];
-			Stack[sp+3] = ((BYTE *)pc)[3];
+			Stack[sp] = pc[0];
+			Stack[sp+1] = pc[1];
+			Stack[sp+2] = pc[2];
+			Stack[sp+3] = pc[3];
 			sp += 4;
-			pc = (int *)((BYTE *)pc + 4);
+			pc += 4;
 			break;
 
 		case PCD_PUSH5BYTES:
-			Stack[sp] = ((BYTE *)pc)[0];
-			Stack[sp+1] = ((BYTE *)pc)[1];
-			Stack[sp+2] = ((BYTE *)pc)[2];
-			Stack[sp+3] = ((BYTE *)pc)[3];
-			Stack[sp+4] = ((BYTE *)pc)[4];
+			Stack[sp] = pc[0];
+			Stack[sp+1] = pc[1];
+			Stack[sp+2] = pc[2];
+			Stack[sp+3] = pc[3];
+			Stack[sp+4] = pc[4];
 			sp += 5;
-			pc = (int *)((BYTE *)pc + 5);
+			pc += 5;
 			break;
 
 		case PCD_PUSHBYTES:
-			temp = *(BYTE *)pc;
-			pc = (int *)((BYTE *)pc + temp + 1);
+			temp = *pc;
+			pc += temp + 1;
 			for (temp = -temp; temp; temp++)
 			{
-				PushToStack (*((BYTE *)pc + temp));
+				PushToStack (pc[temp]);
 			}
 			break;
 
@@ -1769,35 +2202,35 @@ void DLevelScript::RunScript ()
 			break;
 
 		case PCD_LSPEC1DIRECTB:
-			LineSpecials[((BYTE *)pc)[0]] (activationline, activator,
-				((BYTE *)pc)[1], 0, 0, 0, 0);
-			pc = (int *)((BYTE *)pc + 2);
+			LineSpecials[pc[0]] (activationline, activator,
+				pc[1], 0, 0, 0, 0);
+			pc += 2;
 			break;
 
 		case PCD_LSPEC2DIRECTB:
-			LineSpecials[((BYTE *)pc)[0]] (activationline, activator,
-				((BYTE *)pc)[1], ((BYTE *)pc)[2], 0, 0, 0);
-			pc = (int *)((BYTE *)pc + 3);
+			LineSpecials[pc[0]] (activationline, activator,
+				pc[1], pc[2], 0, 0, 0);
+			pc += 3;
 			break;
 
 		case PCD_LSPEC3DIRECTB:
-			LineSpecials[((BYTE *)pc)[0]] (activationline, activator,
-				((BYTE *)pc)[1], ((BYTE *)pc)[2], ((BYTE *)pc)[3], 0, 0);
-			pc = (int *)((BYTE *)pc + 4);
+			LineSpecials[pc[0]] (activationline, activator,
+				pc[1], pc[2], pc[3], 0, 0);
+			pc += 4;
 			break;
 
 		case PCD_LSPEC4DIRECTB:
-			LineSpecials[((BYTE *)pc)[0]] (activationline, activator,
-				((BYTE *)pc)[1], ((BYTE *)pc)[2], ((BYTE *)pc)[3],
-				((BYTE *)pc)[4], 0);
-			pc = (int *)((BYTE *)pc + 5);
+			LineSpecials[pc[0]] (activationline, activator,
+				pc[1], pc[2], pc[3],
+				pc[4], 0);
+			pc += 5;
 			break;
 
 		case PCD_LSPEC5DIRECTB:
-			LineSpecials[((BYTE *)pc)[0]] (activationline, activator,
-				((BYTE *)pc)[1], ((BYTE *)pc)[2], ((BYTE *)pc)[3],
-				((BYTE *)pc)[4], ((BYTE *)pc)[5]);
-			pc = (int *)((BYTE *)pc + 6);
+			LineSpecials[pc[0]] (activationline, activator,
+				pc[1], pc[2], pc[3],
+				pc[4], pc[5]);
+			pc += 6;
 			break;
 
 		case PCD_CALL:
@@ -1829,11 +2262,11 @@ void DLevelScript::RunScript ()
 					Stack[sp+i] = 0;
 				}
 				sp += i;
-				((CallReturn *)&Stack[sp])->ReturnAddress = level.behavior->PC2Ofs (pc);
+				((CallReturn *)&Stack[sp])->ReturnAddress = level.behavior->Insn2Ofs (pc);
 				((CallReturn *)&Stack[sp])->ReturnFunction = activeFunction;
 				((CallReturn *)&Stack[sp])->bDiscardResult = (pcd == PCD_CALLDISCARD);
 				sp += sizeof(CallReturn)/sizeof(int);
-				pc = level.behavior->Ofs2PC (func->Address);
+				pc = level.behavior->Ofs2Insn (func->Address);
 				activeFunction = func;
 			}
 			break;
@@ -1854,7 +2287,7 @@ void DLevelScript::RunScript ()
 				}
 				sp -= sizeof(CallReturn)/sizeof(int);
 				retState = (CallReturn *)&Stack[sp];
-				pc = level.behavior->Ofs2PC (retState->ReturnAddress);
+				pc = level.behavior->Ofs2Insn (retState->ReturnAddress);
 				sp -= activeFunction->ArgCount + activeFunction->LocalCount;
 				activeFunction = retState->ReturnFunction;
 				if (activeFunction == NULL)
@@ -2176,12 +2609,12 @@ void DLevelScript::RunScript ()
 			break;
 
 		case PCD_GOTO:
-			pc = level.behavior->Ofs2PC (*pc);
+			pc = level.behavior->Ofs2Insn (*pc);
 			break;
 
 		case PCD_IFGOTO:
 			if (STACK(1))
-				pc = level.behavior->Ofs2PC (*pc);
+				pc = level.behavior->Ofs2Insn (*pc);
 			else
 				pc++;
 			sp--;
@@ -2204,8 +2637,8 @@ void DLevelScript::RunScript ()
 
 		case PCD_DELAYDIRECTB:
 			state = SCRIPT_Delayed;
-			statedata = *(BYTE *)pc;
-			pc = (int *)((BYTE *)pc + 1);
+			statedata = *pc;
+			pc += 1;
 			break;
 
 		case PCD_RANDOM:
@@ -2219,8 +2652,8 @@ void DLevelScript::RunScript ()
 			break;
 
 		case PCD_RANDOMDIRECTB:
-			PushToStack (Random (((BYTE *)pc)[0], ((BYTE *)pc)[1]));
-			pc = (int *)((BYTE *)pc + 2);
+			PushToStack (Random (pc[0], pc[1]));
+			pc += 2;
 			break;
 
 		case PCD_THINGCOUNT:
@@ -2276,7 +2709,7 @@ void DLevelScript::RunScript ()
 			break;
 
 		case PCD_RESTART:
-			pc = level.behavior->FindScript (script);
+			pc = level.behavior->PC2Insn (level.behavior->FindScript (script));
 			break;
 
 		case PCD_ANDLOGICAL:
@@ -2324,7 +2757,7 @@ void DLevelScript::RunScript ()
 
 		case PCD_IFNOTGOTO:
 			if (!STACK(1))
-				pc = level.behavior->Ofs2PC (*pc);
+				pc = level.behavior->Ofs2Insn (*pc);
 			else
 				pc++;
 			sp--;
@@ -2358,7 +2791,7 @@ void DLevelScript::RunScript ()
 		case PCD_CASEGOTO:
 			if (STACK(1) == NEXTWORD)
 			{
-				pc = level.behavior->Ofs2PC (*pc);
+				pc = level.behavior->Ofs2Insn (*pc);
 				sp--;
 			}
 			else
@@ -3113,9 +3546,12 @@ void DLevelScript::RunScript ()
 		}
 	}
 
-	this->pc = pc;
+	this->pc = level.behavior->Insn2PC (pc);
 	this->sp = sp;
 
+	acs_pcodes += runaway;
+	acs_time += I_GetTime () - starttime;
+
 	if (state == SCRIPT_PleaseRemove)
 	{
 		Unlink ();
@@ -3422,6 +3858,52 @@ BEGIN_COMMAND (scriptstat)
 }
 END_COMMAND (scriptstat)
 
+//
+// acsstats
+//
+// How fast the interpreter has been going, to compare builds against
+// each other on the same maps.
+//
+BEGIN_COMMAND (acsstats)
+{
+	if (argc > 1 && stricmp (argv[1], "reset") == 0)
+	{
+		acs_pcodes = 0;
+		acs_time = 0;
+		return;
+	}
+
+	double ms = (double)acs_time / I_ConvertTimeFromMs (1);
+
+	Printf (PRINT_HIGH, "%.0f p-codes run in %.3f ms", (double)acs_pcodes, ms);
+
+	if (acs_pcodes)
+		Printf (PRINT_HIGH, ", %.2f ns each", ms * 1000000.0 / acs_pcodes);
+
+	Printf (PRINT_HIGH, "\n");
+}
+END_COMMAND (acsstats)
+
+//
+// acsbench
+//
+// Checks the decoded code of the current map against its BEHAVIOR lump
+// and compares reading the operands from either.
+//
+BEGIN_COMMAND (acsbench)
+{
+	if (level.behavior == NULL)
+	{
+		Printf (PRINT_HIGH, "This map has no ACS\n");
+		return;
+	}
+
+	int passes = (argc > 1) ? atoi (argv[1]) : 1000;
+
+	level.behavior->Benchmark (MAX (passes, 1));
+}
+END_COMMAND (acsbench)
+
 void DACSThinker::DumpScriptStatus ()
 {
 	static const char *stateNames[] =
@@ -7,6 +7,8 @@
 #include "doomtype.h"
 #include "r_defs.h"
 
+#include <vector>
+
 #define LOCAL_SIZE	20
 #define STACK_SIZE 4096
 
@@ -75,6 +77,18 @@ public:
 	void StartTypedScripts (WORD type, AActor *activator, int arg0=0, int arg1=0, int arg2=0) const;
 	DWORD PC2Ofs (int *pc) const { return (BYTE *)pc - Data; }
 	int *Ofs2PC (DWORD ofs) const { return (int *)(Data + ofs); }
+
+	// The interpreter runs the decoded form of the code, see Decode.
+	// Pointers into it are only good until the next call to Ofs2Insn.
+	int *Ofs2Insn (DWORD ofs);
+	int *PC2Insn (int *pc) { return Ofs2Insn (PC2Ofs (pc)); }
+	DWORD Insn2Ofs (const int *insn) const;
+	int *Insn2PC (const int *insn) const { return Ofs2PC (Insn2Ofs (insn)); }
+	bool IsInsn (const int *insn) const;
+
+	// Decodes every script and function, checks the result against the
+	// lump and times reading the operands both ways.  See acsbench.
+	void Benchmark (int passes);
 	ACSFormat GetFormat() const { return Format; }
 	ScriptFunction *GetFunction (int funcnum) const;
 	int GetArrayVal (int arraynum, int index) const;
@@ -97,6 +111,12 @@ private:
 	DWORD LanguageNeutral;
 	DWORD Localized;
 
+	std::vector<int> Code;			// decoded instructions
+	std::vector<DWORD> CodeOfs;		// where in Data each entry of Code came from
+	std::vector<int> CodeIndex;		// entry in Code for each instruction in Data, or -1
+
+	void Decode (DWORD ofs);
+
 	static int STACK_ARGS SortScripts (const void *a, const void *b);
 	void AddLanguage (DWORD lang);
 	DWORD FindLanguage (DWORD lang, bool ignoreregion) const;
@@ -24,6 +24,8 @@
 //-----------------------------------------------------------------------------
 
 #include <math.h>
+#include <algorithm>
+#include <vector>
 #include "m_random.h"
 #include "m_alloc.h"
 #include "i_system.h"
@@ -46,6 +48,7 @@ EXTERN_CVAR (sv_allowexit)
 EXTERN_CVAR (sv_fastmonsters)
 EXTERN_CVAR (co_realactorheight)
 EXTERN_CVAR (co_zdoomphys)
+EXTERN_CVAR (sv_monstersleep)
 
 enum dirtype_t
 {
@@ -97,55 +100,98 @@ void A_Fall (AActor *actor);
 
 
 //
+// P_FloodSound
 // Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
+// Floods the sector adjacency built by P_GroupLines breadth first.  Sound
+// crosses at most one sound blocking line, so every sector reachable
+// without crossing one is flooded before those behind a blocking line.
+// Closed doors still cut off traversal.
 //
+// A sector whose stamp equals soundgeneration has been flooded already.
+//
+
+static std::vector<unsigned int> soundstamps;
+static unsigned int soundgeneration = 0;
+static std::vector<sector_t *> soundqueue;
+static std::vector<sector_t *> soundblocked;
 
-void P_RecursiveSound (sector_t *sec, int soundblocks, AActor *soundtarget)
+static void P_FloodSound (sector_t *sec, AActor *soundtarget)
 {
-	int 		i;
-	line_t* 	check;
-	sector_t*	other;
+	if (soundstamps.size() != (size_t)numsectors)
+		soundstamps.assign(numsectors, 0);
 
-	// wake up all monsters in this sector
-	if (sec->validcount == validcount
-		&& sec->soundtraversed <= soundblocks+1)
+	if (++soundgeneration == 0)
 	{
-		return; 		// already flooded
+		// wrapped around
+		std::fill(soundstamps.begin(), soundstamps.end(), 0);
+		soundgeneration = 1;
 	}
 
-	sec->validcount = validcount;
-	sec->soundtraversed = soundblocks+1;
+	soundqueue.clear();
+	soundblocked.clear();
+	soundqueue.push_back(sec);
+
+	soundstamps[sec - sectors] = soundgeneration;
+	sec->soundtraversed = 1;
 	sec->soundtarget = soundtarget->ptr();
 
-	for (i=0 ;i<sec->linecount ; i++)
+	for (int soundblocks = 0; ; soundblocks++)
 	{
-		check = sec->lines[i];
-		if (! (check->flags & ML_TWOSIDED) )
-			continue;
+		for (size_t head = 0; head < soundqueue.size(); head++)
+		{
+			sec = soundqueue[head];
 
-		if ( sides[ check->sidenum[0] ].sector == sec)
-			other = sides[ check->sidenum[1] ] .sector;
-		else
-			other = sides[ check->sidenum[0] ].sector;
+			const soundlink_t *link = &soundlinks[soundlinkstart[sec - sectors]];
+			const soundlink_t *end = &soundlinks[soundlinkstart[sec - sectors + 1]];
+
+			for (; link < end; link++)
+			{
+				sector_t *other = link->other;
+
+				if (soundstamps[other - sectors] == soundgeneration)
+					continue;	// already flooded
+
+				if (link->blocking && soundblocks)
+					continue;
+
+				// [SL] 2012-02-08 - FIXME: Currently only checks for a line opening at
+				// midpoint of a sloped linedef.  P_RecursiveSound() in ZDoom 1.23 causes
+				// demo desyncs.
+				P_LineOpening(link->line, link->midx, link->midy);
+
+				if (openrange <= 0)
+					continue;	// closed door
 
-		// [SL] 2012-02-08 - FIXME: Currently only checks for a line opening at
-		// midpoint of a sloped linedef.  P_RecursiveSound() in ZDoom 1.23 causes
-		// demo desyncs.
-		P_LineOpening(check, (check->v1->x >> 1) + (check->v2->x >> 1),
-							 (check->v1->y >> 1) + (check->v2->y >> 1));
+				if (link->blocking)
+				{
+					soundblocked.push_back(other);
+					continue;
+				}
+
+				soundstamps[other - sectors] = soundgeneration;
+				other->soundtraversed = soundblocks + 1;
+				other->soundtarget = soundtarget->ptr();
+				soundqueue.push_back(other);
+			}
+		}
 
-		if (openrange <= 0)
-			continue;	// closed door
+		if (soundblocks)
+			break;
 
-		if (check->flags & ML_SOUNDBLOCK)
+		// go on from the sectors behind sound blocking lines that
+		// could not be reached any other way
+		soundqueue.clear();
+		for (size_t i = 0; i < soundblocked.size(); i++)
 		{
-			if (!soundblocks)
-				P_RecursiveSound (other, 1, soundtarget);
+			sec = soundblocked[i];
+			if (soundstamps[sec - sectors] == soundgeneration)
+				continue;
+
+			soundstamps[sec - sectors] = soundgeneration;
+			sec->soundtraversed = 2;
+			sec->soundtarget = soundtarget->ptr();
+			soundqueue.push_back(sec);
 		}
-		else
-			P_RecursiveSound (other, soundblocks, soundtarget);
 	}
 }
 
@@ -161,8 +207,7 @@ void P_NoiseAlert (AActor *target, AActor *emmiter)
 	if (target->player && (!multiplayer && (target->player->cheats & CF_NOTARGET)))
 		return;
 
-	validcount++;
-	P_RecursiveSound (emmiter->subsector->sector, 0, target);
+	P_FloodSound (emmiter->subsector->sector, target);
 }
 
 
@@ -662,6 +707,44 @@ bool P_LookForPlayers(AActor *actor, bool allaround)
 }
 
 
+//
+// P_MonsterAsleep
+//
+// With sv_monstersleep set, an idle monster whose mapblock is more than
+// that many blocks away from every player's doesn't bother looking for
+// players.  A sound reaching its sector still wakes it up in A_Look, and
+// so does a player coming near.
+//
+static bool P_MonsterAsleep(AActor *actor)
+{
+	int range = sv_monstersleep.asInt();
+
+	if (range <= 0)
+		return false;
+
+	// [RH] monsters on their way to a goal have to keep walking
+	if (actor->goal)
+		return false;
+
+	int bx = (actor->x - bmaporgx) >> MAPBLOCKSHIFT;
+	int by = (actor->y - bmaporgy) >> MAPBLOCKSHIFT;
+
+	for (Players::iterator it = players.begin();it != players.end();++it)
+	{
+		if (!it->ingame() || it->spectator || !it->mo)
+			continue;
+
+		int dx = ((it->mo->x - bmaporgx) >> MAPBLOCKSHIFT) - bx;
+		int dy = ((it->mo->y - bmaporgy) >> MAPBLOCKSHIFT) - by;
+
+		if (abs(dx) <= range && abs(dy) <= range)
+			return false;
+	}
+
+	return true;
+}
+
+
 //
 // A_KeenDie
 // DOOM II special, map 32.
@@ -742,6 +825,9 @@ void A_Look (AActor *actor)
 	}
 
 
+	if (P_MonsterAsleep(actor))
+		return;
+
 	if (!P_LookForPlayers (actor, false))
 		return;
 
@@ -830,7 +916,13 @@ void A_Chase (AActor *actor)
 
 	if (!actor->target || !(actor->target->flags & MF_SHOOTABLE))
 	{
-		// look for a new target
+		// look for a new target, unless nobody is near enough to be found
+		if (!actor->target && P_MonsterAsleep(actor))
+		{
+			P_SetMobjState (actor, actor->info->spawnstate, true);
+			return;
+		}
+
 		if (P_LookForPlayers (actor, true) && actor->target != actor->goal)
 			return; 	// got a new target
 
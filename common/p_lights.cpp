@@ -29,10 +29,14 @@
 #include "p_local.h"
 
 #include "p_lnspec.h"
+#include "i_workers.h"
 
 // State.
 #include "r_state.h"
 
+EXTERN_CVAR (thinkerthreads)
+EXTERN_CVAR (thinkerthreadsminlights)
+
 // [RH] Make sure the light level is in bounds.
 #define CLIPLIGHT(l)	(((l) < 0) ? 0 : (((l) > 255) ? 255 : (l)))
 
@@ -48,8 +52,81 @@ void DLighting::Serialize (FArchive &arc)
 }
 
 DLighting::DLighting (sector_t *sector)
-	: DSectorEffect (sector)
+	: DSectorEffect (sector), m_Random(0)
+{
+	// new lights look at the light levels around them
+	FlushDeferred ();
+}
+
+void DLighting::Destroy ()
+{
+	// a deferred change would otherwise be lost or made after the thinker
+	// is gone
+	FlushDeferred ();
+	Super::Destroy ();
+}
+
+// Lights that have prepared but not applied their think this tic.
+static std::vector<DLighting *> DeferredLights;
+static bool DeferringLights = false;
+
+void DLighting::RunThink ()
+{
+	if (!PrepareThink ())
+		return;
+
+	if (DeferringLights)
+		DeferredLights.push_back(this);
+	else
+		ApplyThink ();
+}
+
+//
+// DLighting::StartDeferring
+//
+// Called by DThinker::RunThinkers before the thinkers of a tic run.
+//
+void DLighting::StartDeferring ()
 {
+	DeferringLights = (thinkerthreads > 0);
+}
+
+void DLighting::FinishDeferring ()
+{
+	FlushDeferred ();
+	DeferringLights = false;
+}
+
+void DLighting::ApplyPart (int part, int numparts, void *data)
+{
+	for (size_t i = 0; i < DeferredLights.size(); i++)
+	{
+		DLighting *light = DeferredLights[i];
+		if ((light->m_Sector - sectors) % numparts == part)
+			light->ApplyThink ();
+	}
+}
+
+//
+// DLighting::FlushDeferred
+//
+// Applies the light changes collected so far.  The lights of each sector
+// are applied in the order they ran, so the light levels come out the same
+// as if every light had run right away.
+//
+void DLighting::FlushDeferred ()
+{
+	if (DeferredLights.empty())
+		return;
+
+	// splitting a few lights over threads takes longer than running them
+	// right away
+	if (DeferredLights.size() < (size_t)thinkerthreadsminlights.asInt())
+		ApplyPart (0, 1, NULL);
+	else
+		I_RunParallel (ApplyPart, NULL, thinkerthreads + 1);
+
+	DeferredLights.clear();
 }
 
 //
@@ -75,21 +152,26 @@ void DFireFlicker::Serialize (FArchive &arc)
 //
 // T_FireFlicker
 //
-void DFireFlicker::RunThink ()
+bool DFireFlicker::PrepareThink ()
 {
-	int amount;
-		
 	if (--m_Count == 0)
 	{
-		amount = (P_Random () & 3) << 4;
-		
-		if (m_Sector->lightlevel - amount < m_MinLight)
-			m_Sector->lightlevel = m_MinLight;
-		else
-			m_Sector->lightlevel = m_MaxLight - amount;
-
+		m_Random = P_Random ();
 		m_Count = 4;
+		return true;
 	}
+
+	return false;
+}
+
+void DFireFlicker::ApplyThink ()
+{
+	int amount = (m_Random & 3) << 4;
+
+	if (m_Sector->lightlevel - amount < m_MinLight)
+		m_Sector->lightlevel = m_MinLight;
+	else
+		m_Sector->lightlevel = m_MaxLight - amount;
 }
 
 //
@@ -130,21 +212,30 @@ void DFlicker::Serialize (FArchive &arc)
 }
 
 
-void DFlicker::RunThink ()
+bool DFlicker::PrepareThink ()
 {
 	if (m_Count)
 	{
-		m_Count--;	
+		m_Count--;
+		return false;
 	}
-	else if (m_Sector->lightlevel == m_MaxLight)
+
+	// either way one number is drawn
+	m_Random = P_Random();
+	return true;
+}
+
+void DFlicker::ApplyThink ()
+{
+	if (m_Sector->lightlevel == m_MaxLight)
 	{
 		m_Sector->lightlevel = m_MinLight;
-		m_Count = (P_Random()&7)+1;
+		m_Count = (m_Random&7)+1;
 	}
 	else
 	{
 		m_Sector->lightlevel = m_MaxLight;
-		m_Count = (P_Random()&31)+1;
+		m_Count = (m_Random&31)+1;
 	}
 }
 
@@ -192,20 +283,28 @@ void DLightFlash::Serialize (FArchive &arc)
 // T_LightFlash
 // Do flashing lights.
 //
-void DLightFlash::RunThink ()
+bool DLightFlash::PrepareThink ()
 {
 	if (--m_Count == 0)
 	{
-		if (m_Sector->lightlevel == m_MaxLight)
-		{
-			m_Sector->lightlevel = m_MinLight;
-			m_Count = (P_Random () & m_MinTime) + 1;
-		}
-		else
-		{
-			m_Sector->lightlevel = m_MaxLight;
-			m_Count = (P_Random () & m_MaxTime) + 1;
-		}
+		m_Random = P_Random ();
+		return true;
+	}
+
+	return false;
+}
+
+void DLightFlash::ApplyThink ()
+{
+	if (m_Sector->lightlevel == m_MaxLight)
+	{
+		m_Sector->lightlevel = m_MinLight;
+		m_Count = (m_Random & m_MinTime) + 1;
+	}
+	else
+	{
+		m_Sector->lightlevel = m_MaxLight;
+		m_Count = (m_Random & m_MaxTime) + 1;
 	}
 }
 
@@ -257,20 +356,22 @@ void DStrobe::Serialize (FArchive &arc)
 //
 // T_StrobeFlash
 //
-void DStrobe::RunThink ()
+bool DStrobe::PrepareThink ()
 {
-	if (--m_Count == 0)
+	return --m_Count == 0;
+}
+
+void DStrobe::ApplyThink ()
+{
+	if (m_Sector->lightlevel == m_MinLight)
 	{
-		if (m_Sector->lightlevel == m_MinLight)
-		{
-			m_Sector->lightlevel = m_MaxLight;
-			m_Count = m_BrightTime;
-		}
-		else
-		{
-			m_Sector->lightlevel = m_MinLight;
-			m_Count = m_DarkTime;
-		}
+		m_Sector->lightlevel = m_MaxLight;
+		m_Count = m_BrightTime;
+	}
+	else
+	{
+		m_Sector->lightlevel = m_MinLight;
+		m_Count = m_DarkTime;
 	}
 }
 
@@ -351,6 +452,8 @@ void EV_TurnTagLightsOff (int tag)
 	int i;
 	int secnum;
 
+	DLighting::FlushDeferred ();
+
 	// [RH] Don't do a linear search
 	for (secnum = -1; (secnum = P_FindSectorFromTag (tag, secnum)) >= 0; ) 
 	{
@@ -378,6 +481,8 @@ void EV_LightTurnOn (int tag, int bright)
 {
 	int secnum = -1;
 
+	DLighting::FlushDeferred ();
+
 	// [RH] Don't do a linear search
 	while ((secnum = P_FindSectorFromTag (tag, secnum)) >= 0) 
 	{
@@ -423,6 +528,8 @@ int EV_LightTurnOnPartway(int tag, int level)
 {
     int i;
 
+	DLighting::FlushDeferred ();
+
     if (level < 0)          // clip at extremes
     {
         level = 0;
@@ -471,6 +578,8 @@ void EV_LightChange (int tag, int value)
 {
 	int secnum = -1;
 
+	DLighting::FlushDeferred ();
+
 	while ((secnum = P_FindSectorFromTag (tag, secnum)) >= 0) {
 		int newlight = sectors[secnum].lightlevel + value;
 		sectors[secnum].lightlevel = CLIPLIGHT(newlight);
@@ -496,7 +605,12 @@ void DGlow::Serialize (FArchive &arc)
 		arc >> m_Direction >> m_MaxLight >> m_MinLight;
 }
 
-void DGlow::RunThink ()
+bool DGlow::PrepareThink ()
+{
+	return m_Direction == -1 || m_Direction == 1;
+}
+
+void DGlow::ApplyThink ()
 {
 	switch (m_Direction)
 	{
@@ -550,23 +664,30 @@ void DGlow2::Serialize (FArchive &arc)
 		arc >> m_End >> m_MaxTics >> m_OneShot >> m_Start >> m_Tics;
 }
 
-void DGlow2::RunThink ()
+bool DGlow2::PrepareThink ()
+{
+	if (m_OneShot && m_Tics >= m_MaxTics)
+	{
+		// finished fading, can't be put off as the thinker goes away
+		FlushDeferred ();
+
+		m_Tics++;
+		m_Sector->lightlevel = m_End;
+		Destroy ();
+		return false;
+	}
+
+	return true;
+}
+
+void DGlow2::ApplyThink ()
 {
 	if (m_Tics++ >= m_MaxTics)
 	{
-		if (m_OneShot)
-		{
-			m_Sector->lightlevel = m_End;
-			Destroy ();
-			return;
-		}
-		else
-		{
-			int temp = m_Start;
-			m_Start = m_End;
-			m_End = temp;
-			m_Tics -= m_MaxTics;
-		}
+		int temp = m_Start;
+		m_Start = m_End;
+		m_End = temp;
+		m_Tics -= m_MaxTics;
 	}
 
 	m_Sector->lightlevel = ((m_End - m_Start) * m_Tics) / m_MaxTics + m_Start;
@@ -606,6 +727,8 @@ void EV_StartLightGlowing (int tag, int upper, int lower, int tics)
 void EV_StartLightFading (int tag, int value, int tics)
 {
 	int secnum;
+
+	DLighting::FlushDeferred ();
 		
 	secnum = -1;
 	while ((secnum = P_FindSectorFromTag (tag,secnum)) >= 0)
@@ -640,7 +763,12 @@ void DPhased::Serialize (FArchive &arc)
 		arc >> m_BaseLevel >> m_Phase;
 }
 
-void DPhased::RunThink ()
+bool DPhased::PrepareThink ()
+{
+	return true;
+}
+
+void DPhased::ApplyThink ()
 {
 	const int steps = 12;
 
@@ -189,6 +189,8 @@ void P_LineOpening (const line_t *linedef, fixed_t x, fixed_t y, fixed_t refx=MI
 BOOL P_BlockLinesIterator (int x, int y, BOOL(*func)(line_t*) );
 BOOL P_BlockThingsIterator (int x, int y, BOOL(*func)(AActor*), AActor *start=NULL);
 
+void P_RelinkStatsTicker ();
+
 #define PT_ADDLINES 	1
 #define PT_ADDTHINGS	2
 #define PT_EARLYOUT 	4
@@ -305,7 +307,32 @@ extern int				bmapwidth;
 extern int				bmapheight; 	// in mapblocks
 extern fixed_t			bmaporgx;
 extern fixed_t			bmaporgy;		// origin of block map
-extern AActor** 		blocklinks; 	// for thing chains
+
+// The actors in one mapblock, in the order they were linked.  The newest
+// actor is last but is iterated first, the same order the old per-actor
+// thing chains had.
+struct blockthings_t
+{
+	AActor		**actors;
+	int			count;
+	int			capacity;
+};
+
+extern blockthings_t*	blockthings;	// one per mapblock
+
+// A two-sided line sound can cross, seen from one of its sectors.  The
+// links of sector i are soundlinks[soundlinkstart[i]] up to
+// soundlinks[soundlinkstart[i+1]], in the order of the sector's lines.
+struct soundlink_t
+{
+	line_t		*line;
+	sector_t	*other;
+	fixed_t		midx, midy;		// where the opening is measured
+	bool		blocking;		// ML_SOUNDBLOCK
+};
+
+extern soundlink_t*		soundlinks;
+extern int*				soundlinkstart;	// numsectors+1 entries
 
 extern std::set<short>	movable_sectors;
 
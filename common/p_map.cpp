@@ -42,9 +42,14 @@
 #include "z_zone.h"
 #include "p_unlag.h"
 #include "m_vectors.h"
+#include "r_intrin.h"
 #include <math.h>
 #include <set>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 EXTERN_CVAR(sv_unblockplayers)
 
 fixed_t 		tmbbox[4];
@@ -491,6 +496,105 @@ BOOL PIT_CheckLine (line_t *ld)
 	return true;
 }
 
+//
+// The lines P_CheckPosition has to test, gathered from the blockmap in the
+// order P_BlockLinesIterator visits them.  Their bounding boxes are kept in
+// separate arrays so that several lines can be tested at once, leaving
+// only the few lines near the actor for PIT_CheckLine to look at.
+//
+static std::vector<line_t*> checklines;
+static std::vector<fixed_t> checkleft, checkright, checkbottom, checktop;
+static std::vector<size_t> checkhits;
+
+static BOOL PIT_GatherLine (line_t *ld)
+{
+	checklines.push_back(ld);
+	checkleft.push_back(ld->bbox[BOXLEFT]);
+	checkright.push_back(ld->bbox[BOXRIGHT]);
+	checkbottom.push_back(ld->bbox[BOXBOTTOM]);
+	checktop.push_back(ld->bbox[BOXTOP]);
+
+	return true;
+}
+
+static void P_ClearCheckLines ()
+{
+	checklines.clear();
+	checkleft.clear();
+	checkright.clear();
+	checkbottom.clear();
+	checktop.clear();
+	checkhits.clear();
+}
+
+//
+// P_CheckLineBoxes
+//
+// Finds the gathered lines whose bounding box overlaps box, the same test
+// PIT_CheckLine starts with, and appends their indices to checkhits in the
+// order they were gathered.
+//
+static void P_CheckLineBoxes (const fixed_t *box)
+{
+	const size_t count = checklines.size();
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256i left8 = _mm256_set1_epi32(box[BOXLEFT]);
+	const __m256i right8 = _mm256_set1_epi32(box[BOXRIGHT]);
+	const __m256i bottom8 = _mm256_set1_epi32(box[BOXBOTTOM]);
+	const __m256i top8 = _mm256_set1_epi32(box[BOXTOP]);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i *)&checkleft[i]);
+		__m256i r = _mm256_loadu_si256((const __m256i *)&checkright[i]);
+		__m256i b = _mm256_loadu_si256((const __m256i *)&checkbottom[i]);
+		__m256i t = _mm256_loadu_si256((const __m256i *)&checktop[i]);
+
+		__m256i hit = _mm256_and_si256(
+			_mm256_and_si256(_mm256_cmpgt_epi32(right8, l), _mm256_cmpgt_epi32(r, left8)),
+			_mm256_and_si256(_mm256_cmpgt_epi32(top8, b), _mm256_cmpgt_epi32(t, bottom8)));
+
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+		for (int j = 0; mask; j++, mask >>= 1)
+			if (mask & 1)
+				checkhits.push_back(i + j);
+	}
+#endif
+
+#if defined(__SSE2__)
+	const __m128i left4 = _mm_set1_epi32(box[BOXLEFT]);
+	const __m128i right4 = _mm_set1_epi32(box[BOXRIGHT]);
+	const __m128i bottom4 = _mm_set1_epi32(box[BOXBOTTOM]);
+	const __m128i top4 = _mm_set1_epi32(box[BOXTOP]);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i l = _mm_loadu_si128((const __m128i *)&checkleft[i]);
+		__m128i r = _mm_loadu_si128((const __m128i *)&checkright[i]);
+		__m128i b = _mm_loadu_si128((const __m128i *)&checkbottom[i]);
+		__m128i t = _mm_loadu_si128((const __m128i *)&checktop[i]);
+
+		__m128i hit = _mm_and_si128(
+			_mm_and_si128(_mm_cmpgt_epi32(right4, l), _mm_cmpgt_epi32(r, left4)),
+			_mm_and_si128(_mm_cmpgt_epi32(top4, b), _mm_cmpgt_epi32(t, bottom4)));
+
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+		for (int j = 0; mask; j++, mask >>= 1)
+			if (mask & 1)
+				checkhits.push_back(i + j);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		if (box[BOXRIGHT] > checkleft[i] && box[BOXLEFT] < checkright[i] &&
+			box[BOXTOP] > checkbottom[i] && box[BOXBOTTOM] < checktop[i])
+			checkhits.push_back(i);
+	}
+}
+
 //
 // PIT_CheckThing
 //
@@ -873,10 +977,21 @@ bool P_CheckPosition (AActor *thing, fixed_t x, fixed_t y)
 	yl = (tmbbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
 	yh = (tmbbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
 
+	// Lines are still checked in the same order, only the ones whose
+	// bounding box misses the actor are skipped up front.  PIT_CheckLine
+	// stops at the first blocking line, so none of the lines after it
+	// touch spechit either.
+	P_ClearCheckLines();
+
 	for (int bx=xl ; bx<=xh ; bx++)
 		for (int by=yl ; by<=yh ; by++)
-			if (!P_BlockLinesIterator (bx,by,PIT_CheckLine))
-				return false;
+			P_BlockLinesIterator (bx,by,PIT_GatherLine);
+
+	P_CheckLineBoxes(tmbbox);
+
+	for (size_t i = 0; i < checkhits.size(); i++)
+		if (!PIT_CheckLine (checklines[checkhits[i]]))
+			return false;
 
 	if (co_realactorheight)
 		return (BlockingMobj = thingblocker) == NULL;
@@ -1112,19 +1227,14 @@ BOOL P_TryMove (AActor *thing, fixed_t x, fixed_t y,
 	}
 
 	// the move is ok, so link the thing into its new position
-	thing->UnlinkFromWorld ();
-
 	fixed_t oldx = thing->x;
 	fixed_t oldy = thing->y;
 	thing->floorz = tmfloorz;
 	thing->ceilingz = tmceilingz;
 	thing->dropoffz = tmdropoffz;		// killough 11/98: keep track of dropoffs
 	thing->floorsector = tmfloorsector;
-	thing->x = x;
-	thing->y = y;
-	thing->z = testz;
 
-	thing->LinkToWorld ();
+	thing->SetOrigin (x, y, testz);
 
 	// if any special lines were hit, do the effect
 	if (! (thing->flags&(MF_TELEPORT|MF_NOCLIP)) )
@@ -2896,12 +3006,9 @@ void P_RadiusAttack(AActor *spot, AActor *source, int damage, int distance,
 		{
 			for (int x=xl ; x<=xh ; x++)
 			{
-				AActor *mobj = blocklinks[y*bmapwidth+x];
-				while (mobj)
-				{
-					actorset.insert(mobj);
-					mobj = mobj->bmapnode.Next(x, y);
-				}
+				const blockthings_t *cell = &blockthings[y*bmapwidth+x];
+				for (int i = cell->count - 1; i >= 0; i--)
+					actorset.insert(cell->actors[i]);
 			}
 		}
 
@@ -31,6 +31,8 @@
 #include "doomstat.h"
 #include "p_local.h"
 #include "r_data.h"
+#include "z_zone.h"
+#include "c_dispatch.h"
 
 // State.
 #include "r_state.h"
@@ -38,6 +40,12 @@
 EXTERN_CVAR (co_blockmapfix)
 EXTERN_CVAR (co_zdoomphys)
 
+// How many times actors were moved by SetOrigin, and how many of those
+// moves stayed within the same subsector and mapblocks.
+static int relinks_thistic, relinks_avoided_thistic;
+static int relinks_lasttic, relinks_avoided_lasttic;
+static int relinks_total, relinks_avoided_total;
+
 //
 //
 // P_PointOnSide
@@ -96,18 +104,107 @@ subsector_t* P_PointInSubsector(fixed_t x, fixed_t y)
 }
 
 
+//
+// P_BlockThingsAdd
+//
+// Appends an actor to a mapblock's list, growing it if necessary.  The
+// arrays live as long as the level does.
+//
+static void P_BlockThingsAdd(blockthings_t *cell, AActor *mo)
+{
+	if (cell->count == cell->capacity)
+	{
+		int capacity = cell->capacity ? cell->capacity * 2 : 4;
+		AActor **actors = (AActor **)Z_Malloc(capacity * sizeof(*actors), PU_LEVEL, 0);
+
+		if (cell->actors)
+		{
+			memcpy(actors, cell->actors, cell->count * sizeof(*actors));
+			Z_Free(cell->actors);
+		}
+
+		cell->actors = actors;
+		cell->capacity = capacity;
+	}
+
+	cell->actors[cell->count++] = mo;
+}
+
+//
+// P_BlockThingsFind
+//
+// Returns the position of an actor in a mapblock's list or -1.
+//
+static int P_BlockThingsFind(const blockthings_t *cell, const AActor *mo)
+{
+	for (int i = cell->count - 1; i >= 0; i--)
+	{
+		if (cell->actors[i] == mo)
+			return i;
+	}
+
+	return -1;
+}
+
+//
+// P_BlockThingsRemove
+//
+// Removes an actor from a mapblock's list.  The actors after it are moved
+// down rather than swapping the last one into its place, since the order
+// things are found in decides the outcome of collisions and demos must
+// play back the same.  Mapblocks rarely hold more than a handful of actors.
+//
+static void P_BlockThingsRemove(blockthings_t *cell, AActor *mo)
+{
+	int i = P_BlockThingsFind(cell, mo);
+
+	if (i < 0)
+		return;
+
+	cell->count--;
+	memmove(&cell->actors[i], &cell->actors[i + 1], (cell->count - i) * sizeof(*cell->actors));
+}
+
+//
+// P_BlockThingsRaise
+//
+// Moves an actor to the end of a mapblock's list, where removing and
+// adding it again would have put it.
+//
+static void P_BlockThingsRaise(blockthings_t *cell, AActor *mo)
+{
+	int i = P_BlockThingsFind(cell, mo);
+
+	if (i < 0)
+	{
+		P_BlockThingsAdd(cell, mo);
+		return;
+	}
+
+	if (i == cell->count - 1)
+		return;
+
+	memmove(&cell->actors[i], &cell->actors[i + 1], (cell->count - i - 1) * sizeof(*cell->actors));
+	cell->actors[cell->count - 1] = mo;
+}
+
+
 AActor::ActorBlockMapListNode::ActorBlockMapListNode(AActor *mo) :
 	actor(mo)
 {
 	clear();
 }
 
-void AActor::ActorBlockMapListNode::Link()
+//
+// Finds the range of mapblocks the actor overlaps, clamped to the
+// blockmap.  Returns false if the actor is entirely outside of it.
+//
+bool AActor::ActorBlockMapListNode::getBlocks(int &left, int &right, int &top, int &bottom) const
 {
-	int left    = (actor->x - actor->radius - bmaporgx) >> MAPBLOCKSHIFT;
-	int right   = (actor->x + actor->radius - bmaporgx) >> MAPBLOCKSHIFT;
-	int top     = (actor->y - actor->radius - bmaporgy) >> MAPBLOCKSHIFT;
-	int bottom  = (actor->y + actor->radius - bmaporgy) >> MAPBLOCKSHIFT;
+	left    = (actor->x - actor->radius - bmaporgx) >> MAPBLOCKSHIFT;
+	right   = (actor->x + actor->radius - bmaporgx) >> MAPBLOCKSHIFT;
+	top     = (actor->y - actor->radius - bmaporgy) >> MAPBLOCKSHIFT;
+	bottom  = (actor->y + actor->radius - bmaporgy) >> MAPBLOCKSHIFT;
 
 	if (!co_blockmapfix)
 	{
@@ -120,43 +217,34 @@ void AActor::ActorBlockMapListNode::Link()
 	// do not ignore actors only *partially* outside blockmap
 	// e.g. do not ignore an actor just because its left edge is off the left
 	// side of the blockmap - its *right* edge must be off the left side as well
-	if (right >= 0 && left < bmapwidth && bottom >= 0 && top < bmapheight)
-	{
-		// however, need to clamp a partially off-limits actor to the grid
-		if (left < 0) left = 0;
-		if (right >= bmapwidth) right = bmapwidth - 1;
-		if (top < 0) top = 0;
-		if (bottom >= bmapheight) bottom = bmapheight - 1;
+	if (right < 0 || left >= bmapwidth || bottom < 0 || top >= bmapheight)
+		return false;
+
+	// however, need to clamp a partially off-limits actor to the grid
+	if (left < 0) left = 0;
+	if (right >= bmapwidth) right = bmapwidth - 1;
+	if (top < 0) top = 0;
+	if (bottom >= bmapheight) bottom = bmapheight - 1;
 
+	return true;
+}
+
+void AActor::ActorBlockMapListNode::Link()
+{
+	int left, right, top, bottom;
+
+	if (getBlocks(left, right, top, bottom))
+	{
 		originx = left;
 		originy = top;
 		blockcntx = right - left + 1;
 		blockcnty = bottom - top + 1;
 
-		// [SL] 2012-05-15 - Add the actor to the blocklinks list for all of the
+		// [SL] 2012-05-15 - Add the actor to the blockthings list for all of the
 		// blockmaps it overlaps, not just the blockmap for the actor's center point.
 		for (int bmy = top; bmy <= bottom; bmy++)
-		{
 			for (int bmx = left; bmx <= right; bmx++)
-			{
-				// killough 8/11/98: simpler scheme using pointer-to-pointer prev
-				// pointers, allows head nodes to be treated like everything else
-
-				AActor **headptr = &blocklinks[bmy * bmapwidth + bmx];
-				AActor *headactor = *headptr;
-
-				size_t thisidx = getIndex(bmx, bmy);
-				
-		        if ((next[thisidx] = headactor))
-		        {
-		        	size_t nextidx = headactor->bmapnode.getIndex(bmx, bmy);
-					headactor->bmapnode.prev[nextidx] = &next[thisidx];
-				}
-				
-		        prev[thisidx] = headptr;
-		        *headptr = actor;
-			}
-		}
+				P_BlockThingsAdd(&blockthings[bmy * bmapwidth + bmx], actor);
 	}
 	else
 	{
@@ -166,59 +254,58 @@ void AActor::ActorBlockMapListNode::Link()
 
 void AActor::ActorBlockMapListNode::Unlink()
 {
+	// Doesn't depend on the current position for unlinking, so the actor
+	// can be moved before it is unlinked.
 	for (int bmy = originy; bmy < originy + blockcnty; bmy++)
-	{
 		for (int bmx = originx; bmx < originx + blockcntx; bmx++)
-		{
-			// killough 8/11/98: simpler scheme using pointers-to-pointers for prev
-			// pointers, allows head node pointers to be treated like everything else
-			//
-			// Also more robust, since it doesn't depend on current position for
-			// unlinking. Old method required computing head node based on position
-			// at time of unlinking, assuming it was the same position as during
-			// linking.
-
-			size_t thisidx = getIndex(bmx, bmy);
-			
-			AActor *nextactor = next[thisidx];
-			AActor **prevactor = prev[thisidx];
-			
-			if (prevactor && (*prevactor = nextactor))
-			{
-				size_t nextidx = nextactor->bmapnode.getIndex(bmx, bmy);
-				nextactor->bmapnode.prev[nextidx] = prevactor;
-			}
-		}
+			P_BlockThingsRemove(&blockthings[bmy * bmapwidth + bmx], actor);
+
+	clear();
+}
+
+//
+// Same as Unlink followed by Link for an actor that has moved.  If it still
+// overlaps the same mapblocks, it is only moved to the end of their lists
+// instead of being removed and added again.  Returns true in that case.
+//
+bool AActor::ActorBlockMapListNode::Relink()
+{
+	int left, right, top, bottom;
+
+	if (blockcntx == 0 || !getBlocks(left, right, top, bottom) ||
+		left != originx || top != originy ||
+		right - left + 1 != blockcntx || bottom - top + 1 != blockcnty)
+	{
+		Unlink();
+		Link();
+		return false;
 	}
+
+	for (int bmy = top; bmy <= bottom; bmy++)
+		for (int bmx = left; bmx <= right; bmx++)
+			P_BlockThingsRaise(&blockthings[bmy * bmapwidth + bmx], actor);
+
+	return true;
 }
 
+//
+// Returns the actor found after this one when iterating the mapblock.
+//
 AActor* AActor::ActorBlockMapListNode::Next(int bmx, int bmy)
 {
 	if (bmx < 0 || bmx >= bmapwidth || bmy < 0 || bmy >= bmapheight)
 		return NULL;
 
-	return next[getIndex(bmx, bmy)];
+	const blockthings_t *cell = &blockthings[bmy * bmapwidth + bmx];
+	int i = P_BlockThingsFind(cell, actor);
+
+	return i > 0 ? cell->actors[i - 1] : NULL;
 }
 
 void AActor::ActorBlockMapListNode::clear()
 {
 	originx = originy = 0;
 	blockcntx = blockcnty = 0;
-	memset(prev, 0, sizeof(prev));
-	memset(next, 0, sizeof(next));
-}
-
-size_t AActor::ActorBlockMapListNode::getIndex(int bmx, int bmy)
-{
-	if (!co_blockmapfix)
-		return 0;
-
-	// range check
-	if (bmx < originx || bmx > originx + blockcntx - 1 ||
-		bmy < originy || bmy > originy + blockcnty - 1)
-		return 0;
-		
-	return (bmy - originy) * BLOCKSX + bmx - originx;
 }
 
 
@@ -614,14 +701,93 @@ void AActor::LinkToWorld ()
 	}
 }
 
+//
+// AActor::SetOrigin
+//
+// Moves the actor and links it into the world at its new position.  Most
+// moves leave the actor in the same subsector and mapblocks, so only the
+// parts that did change are relinked.  The actor still ends up first in
+// its sector's thing list and last in its mapblocks, exactly where a full
+// unlink and link would put it, since the order of those lists decides
+// what happens in collisions and demos must play back the same.
+//
 void AActor::SetOrigin (fixed_t ix, fixed_t iy, fixed_t iz)
 {
-	UnlinkFromWorld ();
+	subsector_t *newsubsector = P_PointInSubsector (ix, iy);
+
+	relinks_thistic++;
+
+	if (subsector == NULL || newsubsector != subsector)
+	{
+		UnlinkFromWorld ();
+		x = ix;
+		y = iy;
+		z = iz;
+		LinkToWorld ();
+		return;
+	}
+
+	bool moved = (ix != x || iy != y);
+
 	x = ix;
 	y = iy;
 	z = iz;
-	LinkToWorld ();
+
+	if ( !(flags & MF_NOSECTOR) )
+	{
+		sector_t *sector = subsector->sector;
+
+		if (sprev != &sector->thinglist)
+		{
+			if ((*sprev = snext))
+				snext->sprev = sprev;
+			if ((snext = sector->thinglist))
+				snext->sprev = &snext;
+			sprev = &sector->thinglist;
+			sector->thinglist = this;
+		}
+
+		// the sectors touched can only change if the actor moved sideways
+		if (moved)
+		{
+			sector_list = touching_sectorlist;
+			touching_sectorlist = NULL;
+			P_CreateSecNodeList (this, x, y);
+			touching_sectorlist = sector_list;
+			sector_list = NULL;
+		}
+	}
+
+	if ( !(flags & MF_NOBLOCKMAP) && !bmapnode.Relink() )
+		return;
+
+	relinks_avoided_thistic++;
+}
+
+//
+// P_RelinkStatsTicker
+//
+// Called once per tic to keep track of how many relinks SetOrigin avoided.
+//
+void P_RelinkStatsTicker ()
+{
+	relinks_lasttic = relinks_thistic;
+	relinks_avoided_lasttic = relinks_avoided_thistic;
+	relinks_total += relinks_thistic;
+	relinks_avoided_total += relinks_avoided_thistic;
+
+	relinks_thistic = relinks_avoided_thistic = 0;
+}
+
+BEGIN_COMMAND (relinkstats)
+{
+	Printf (PRINT_HIGH, "Relinks avoided last tic: %d of %d\n",
+			relinks_avoided_lasttic, relinks_lasttic);
+	Printf (PRINT_HIGH, "Relinks avoided in total: %d of %d (%.1f%%)\n",
+			relinks_avoided_total, relinks_total,
+			relinks_total ? 100.0 * relinks_avoided_total / relinks_total : 0.0);
 }
+END_COMMAND (relinkstats)
 
 
 //
@@ -715,17 +881,43 @@ BOOL P_BlockThingsIterator (int x, int y, BOOL(*func)(AActor*), AActor *actor)
 {
 	if (x<0 || y<0 || x>=bmapwidth || y>=bmapheight)
 		return true;
-	else
- 	{
-		AActor *mobj = (actor != NULL ? actor : blocklinks[y*bmapwidth+x]);
-		while (mobj)
- 		{
- 			if (!func (mobj))
- 				return false;
-
-			mobj = mobj->bmapnode.Next(x, y);
+
+	const blockthings_t *cell = &blockthings[y*bmapwidth+x];
+
+	// newest first
+	int i = (actor != NULL ? P_BlockThingsFind(cell, actor) : cell->count - 1);
+
+	while (i >= 0 && i < cell->count)
+	{
+		AActor *mobj = cell->actors[i];
+		AActor *next = (i > 0 ? cell->actors[i - 1] : NULL);
+
+		if (!func (mobj))
+			return false;
+
+		// Like the thing chains, look up what follows mobj after func has
+		// run, since func can add and remove actors.  If mobj is still in
+		// the block, carry on with whatever is behind it now; if func moved
+		// it back into this block, that starts over from the newest actor
+		// just as relinking it at the head of the chain did.  New actors are
+		// appended and so are not visited otherwise.
+		if (i < cell->count && cell->actors[i] == mobj)
+			i--;
+		else if ((i = P_BlockThingsFind(cell, mobj)) >= 0)
+			i--;
+		else if (next != NULL)
+		{
+			// mobj was unlinked, which left its chain pointer at the actor
+			// that followed it.  The chains would also visit that actor if
+			// func unlinked it too; no callback removes anything other than
+			// the actor it is given, so stopping there instead cannot
+			// change a demo.
+			i = P_BlockThingsFind(cell, next);
 		}
+		else
+			break;
 	}
+
 	return true;
 }
 
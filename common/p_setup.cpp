@@ -108,7 +108,10 @@ int				*blockmaplump;	// offsets in blockmap are from here
 fixed_t 		bmaporgx;		// origin of block map
 fixed_t 		bmaporgy;
 
-AActor**		blocklinks;		// for thing chains
+blockthings_t*	blockthings;	// for thing chains
+
+soundlink_t*	soundlinks;		// for P_NoiseAlert
+int*			soundlinkstart;
 
 
 
@@ -1417,9 +1420,9 @@ void P_LoadBlockMap (int lump)
 	bmapheight = blockmaplump[3];
 
 	// clear out mobj chains
-	count = sizeof(*blocklinks) * bmapwidth*bmapheight;
-	blocklinks = (AActor **)Z_Malloc (count, PU_LEVEL, 0);
-	memset (blocklinks, 0, count);
+	count = sizeof(*blockthings) * bmapwidth*bmapheight;
+	blockthings = (blockthings_t *)Z_Malloc (count, PU_LEVEL, 0);
+	memset (blockthings, 0, count);
 	blockmap = blockmaplump+4;
 }
 
@@ -1515,6 +1518,46 @@ void P_GroupLines (void)
 		sector->blockbox[BOXLEFT]=block;
 	}
 
+	// build the sector adjacency sound travels through, following the
+	// same sides P_RecursiveSound used to look at
+	total = 0;
+	for (i = 0; i < numsectors; i++)
+	{
+		for (j = 0; j < sectors[i].linecount; j++)
+		{
+			li = sectors[i].lines[j];
+			if ((li->flags & ML_TWOSIDED) && li->sidenum[1] != R_NOSIDE)
+				total++;
+		}
+	}
+
+	soundlinks = (soundlink_t *)Z_Malloc ((total ? total : 1)*sizeof(soundlink_t), PU_LEVEL, 0);
+	soundlinkstart = (int *)Z_Malloc ((numsectors+1)*sizeof(int), PU_LEVEL, 0);
+
+	total = 0;
+	for (i = 0; i < numsectors; i++)
+	{
+		sector = &sectors[i];
+		soundlinkstart[i] = total;
+
+		for (j = 0; j < sector->linecount; j++)
+		{
+			li = sector->lines[j];
+			if (!(li->flags & ML_TWOSIDED) || li->sidenum[1] == R_NOSIDE)
+				continue;
+
+			soundlink_t *link = &soundlinks[total++];
+			link->line = li;
+			if (sides[li->sidenum[0]].sector == sector)
+				link->other = sides[li->sidenum[1]].sector;
+			else
+				link->other = sides[li->sidenum[0]].sector;
+			link->midx = (li->v1->x >> 1) + (li->v2->x >> 1);
+			link->midy = (li->v1->y >> 1) + (li->v2->y >> 1);
+			link->blocking = (li->flags & ML_SOUNDBLOCK) != 0;
+		}
+	}
+	soundlinkstart[numsectors] = total;
 }
 
 //
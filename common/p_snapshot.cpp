@@ -25,6 +25,7 @@
 
 
 #include <math.h>
+#include <algorithm>
 #include "actor.h"
 #include "d_player.h"
 #include "p_local.h"
@@ -40,6 +41,89 @@ static const fixed_t SECTOR_LERP_THRESHOLD = 2 * FRACUNIT;
 
 extern bool predicting;
 
+// ============================================================================
+//
+// SnapshotTimeIndex implementation
+//
+// ============================================================================
+
+//
+// SnapshotTimeIndex::insert()
+//
+// Adds a time to the index if it is not already present.  The managers
+// erase the time a ring slot held before storing a new time in it, so the
+// index never holds more than one time per slot.
+//
+void SnapshotTimeIndex::insert(int time)
+{
+	int *pos = std::lower_bound(mTimes, mTimes + mCount, time);
+	if (pos != mTimes + mCount && *pos == time)
+		return;
+
+	if (mCount == NUM_SNAPSHOTS)
+	{
+		// should not happen, but make room by forgetting the oldest time
+		if (pos == mTimes)
+			return;
+		std::copy(mTimes + 1, pos, mTimes);
+		*(pos - 1) = time;
+		return;
+	}
+
+	std::copy_backward(pos, mTimes + mCount, mTimes + mCount + 1);
+	*pos = time;
+	mCount++;
+}
+
+//
+// SnapshotTimeIndex::erase()
+//
+void SnapshotTimeIndex::erase(int time)
+{
+	int *pos = std::lower_bound(mTimes, mTimes + mCount, time);
+	if (pos == mTimes + mCount || *pos != time)
+		return;
+
+	std::copy(pos + 1, mTimes + mCount, pos);
+	mCount--;
+}
+
+//
+// SnapshotTimeIndex::findFirst()
+//
+// Returns the earliest time in the index between mintime and maxtime
+// inclusive, or -1 if there is none.
+//
+int SnapshotTimeIndex::findFirst(int mintime, int maxtime) const
+{
+	if (mintime > maxtime)
+		return -1;
+
+	const int *pos = std::lower_bound(mTimes, mTimes + mCount, mintime);
+	if (pos == mTimes + mCount || *pos > maxtime)
+		return -1;
+
+	return *pos;
+}
+
+//
+// SnapshotTimeIndex::findLast()
+//
+// Returns the latest time in the index between mintime and maxtime
+// inclusive, or -1 if there is none.
+//
+int SnapshotTimeIndex::findLast(int mintime, int maxtime) const
+{
+	if (mintime > maxtime)
+		return -1;
+
+	const int *pos = std::upper_bound(mTimes, mTimes + mCount, maxtime);
+	if (pos == mTimes || *(pos - 1) < mintime)
+		return -1;
+
+	return *(pos - 1);
+}
+
 // ============================================================================
 //
 // Snapshot implementation
@@ -311,6 +395,7 @@ void PlayerSnapshotManager::clearSnapshots()
 	for (int i = 0; i < NUM_SNAPSHOTS; i++)
 		mSnaps[i].setTime(-1);
 		
+	mTimes.clear();
 	mMostRecent = 0;
 }
 
@@ -403,13 +488,21 @@ void PlayerSnapshotManager::addSnapshot(const PlayerSnapshot &snap)
 	}
 	else
 	{
+		mTimes.erase(dest.getTime());
 		dest = snap;
+		mTimes.insert(time);
 	}
 
 	if (time > mMostRecent)
 		mMostRecent = time;
 }
 
+//
+// PlayerSnapshotManager::mFindValidSnapshot()
+//
+// Returns the time of the valid snapshot closest to starttime, searching
+// towards endtime, or -1 if there is none between the two.
+//
 int PlayerSnapshotManager::mFindValidSnapshot(int starttime, int endtime) const
 {
 	if (starttime < mMostRecent - NUM_SNAPSHOTS || 
@@ -418,20 +511,23 @@ int PlayerSnapshotManager::mFindValidSnapshot(int starttime, int endtime) const
 		return -1;
 	
 	if (endtime >= starttime)
-	{
-		for (int t = starttime; t <= endtime; t++)
-			if (mValidSnapshot(t))
-				return t;
-	}
+		return mTimes.findFirst(MAX(starttime, 1), endtime);
 	else
-	{
-		for (int t = starttime; t >= endtime; t--)
-			if (mValidSnapshot(t))
-				return t;	
-	}
-	
-	// Did not find any valid snapshots
-	return -1;
+		return mTimes.findLast(MAX(endtime, 1), starttime);
+}
+
+//
+// PlayerSnapshotManager::findSnapshot()
+//
+// Returns the snapshot stored in the container for the given time without
+// copying it, or NULL if there is none.
+//
+const PlayerSnapshot *PlayerSnapshotManager::findSnapshot(int time) const
+{
+	if (!mValidSnapshot(time))
+		return NULL;
+
+	return &mSnaps[time % NUM_SNAPSHOTS];
 }
 
 //
@@ -1034,6 +1130,7 @@ void SectorSnapshotManager::clearSnapshots()
 	for (int i = 0; i < NUM_SNAPSHOTS; i++)
 		mSnaps[i].clear();
 		
+	mTimes.clear();
 	mMostRecent = 0;
 }
 
@@ -1087,13 +1184,35 @@ void SectorSnapshotManager::addSnapshot(const SectorSnapshot &newsnap)
 		return;
 	}
 
-	mSnaps[time % NUM_SNAPSHOTS] = newsnap;
+	SectorSnapshot &dest = mSnaps[time % NUM_SNAPSHOTS];
+	mTimes.erase(dest.getTime());
+	dest = newsnap;
+
+	// only snapshots of a moving sector can be used to find the sector's
+	// position at a later time
+	if (dest.getCeilingMoverType() != SEC_INVALID ||
+		dest.getFloorMoverType() != SEC_INVALID)
+		mTimes.insert(time);
 
 	if (time > mMostRecent)
 		mMostRecent = time;
 }
 
 
+//
+// SectorSnapshotManager::findSnapshot()
+//
+// Returns the snapshot stored in the container for the given time without
+// copying it, or NULL if there is none.
+//
+const SectorSnapshot *SectorSnapshotManager::findSnapshot(int time) const
+{
+	if (!mValidSnapshot(time))
+		return NULL;
+
+	return &mSnaps[time % NUM_SNAPSHOTS];
+}
+
 //
 // SectorSnapshotManager::getSnapshot()
 //
@@ -1111,72 +1230,69 @@ SectorSnapshot SectorSnapshotManager::getSnapshot(int time) const
 		return mSnaps[time % NUM_SNAPSHOTS];
 	
 	// Find the snapshot in the container that preceeds the desired time
-	int prevsnaptime = time;
-	while (--prevsnaptime > mMostRecent - NUM_SNAPSHOTS)
-	{
-		if (mValidSnapshot(prevsnaptime))
-		{
-			const SectorSnapshot *snap = &mSnaps[prevsnaptime % NUM_SNAPSHOTS];
-			
-			// turn off any sector movement sounds from RunThink()
-			bool oldpredicting = predicting;
-			predicting = true;
-		
-			// create a temporary sector for the snapshot and run the
-			// sector movement til we get to the desired time
-			sector_t tempsector;
-			P_CopySector(&tempsector, snap->getSector());
-			
-			// set values for the Z parameter of the sector's planes so that
-			// P_SetCeilingHeight/P_SetFloorHeight will work properly
-			tempsector.floorplane.c = tempsector.floorplane.invc = FRACUNIT;
-			tempsector.ceilingplane.c = tempsector.ceilingplane.invc = -FRACUNIT;
-						
-			snap->toSector(&tempsector);
-
-			for (int i = 0; i < time - prevsnaptime; i++)
-			{
-				if (tempsector.ceilingdata)
-					tempsector.ceilingdata->RunThink();			
-				if (tempsector.floordata && 
-					tempsector.floordata != tempsector.ceilingdata)
-					tempsector.floordata->RunThink();
-			}
-			
-			SectorSnapshot newsnap(time, &tempsector);
-
-			// clean up allocated memory
-			if (tempsector.ceilingdata)
-			{
-				tempsector.ceilingdata->Destroy();
-				delete tempsector.ceilingdata;
-			}
+	int prevsnaptime = mTimes.findLast(MAX(mMostRecent - NUM_SNAPSHOTS + 1, 1),
+									   MIN(time - 1, mMostRecent));
+
+	// Could not find a valid snapshot so return a blank (invalid) one
+	if (prevsnaptime <= 0)
+		return SectorSnapshot();
+
+	const SectorSnapshot *snap = &mSnaps[prevsnaptime % NUM_SNAPSHOTS];
+	
+	// turn off any sector movement sounds from RunThink()
+	bool oldpredicting = predicting;
+	predicting = true;
+
+	// create a temporary sector for the snapshot and run the
+	// sector movement til we get to the desired time
+	sector_t tempsector;
+	P_CopySector(&tempsector, snap->getSector());
+	
+	// set values for the Z parameter of the sector's planes so that
+	// P_SetCeilingHeight/P_SetFloorHeight will work properly
+	tempsector.floorplane.c = tempsector.floorplane.invc = FRACUNIT;
+	tempsector.ceilingplane.c = tempsector.ceilingplane.invc = -FRACUNIT;
 				
-			if (tempsector.floordata)
-			{
-				tempsector.floordata->Destroy();
-				delete tempsector.floordata;
-			}
-
-			if (tempsector.lightingdata)
-			{
-				tempsector.lightingdata->Destroy();
-				delete tempsector.lightingdata;
-			}
-
-			// restore sector movement sounds
-			predicting = oldpredicting;
-			
-			return newsnap;
-		}
+	snap->toSector(&tempsector);
+
+	for (int i = 0; i < time - prevsnaptime; i++)
+	{
+		if (tempsector.ceilingdata)
+			tempsector.ceilingdata->RunThink();			
+		if (tempsector.floordata && 
+			tempsector.floordata != tempsector.ceilingdata)
+			tempsector.floordata->RunThink();
+	}
+	
+	SectorSnapshot newsnap(time, &tempsector);
+
+	// clean up allocated memory
+	if (tempsector.ceilingdata)
+	{
+		tempsector.ceilingdata->Destroy();
+		delete tempsector.ceilingdata;
 	}
 		
-	// Could not find a valid snapshot so return a blank (invalid) one
-	return SectorSnapshot();
+	if (tempsector.floordata)
+	{
+		tempsector.floordata->Destroy();
+		delete tempsector.floordata;
+	}
+
+	if (tempsector.lightingdata)
+	{
+		tempsector.lightingdata->Destroy();
+		delete tempsector.lightingdata;
+	}
+
+	// restore sector movement sounds
+	predicting = oldpredicting;
+	
+	return newsnap;
 }
 
 
-bool P_CeilingSnapshotDone(SectorSnapshot *snap)
+bool P_CeilingSnapshotDone(const SectorSnapshot *snap)
 {
 	if (!snap || !snap->isValid() || snap->getCeilingMoverType() == SEC_INVALID)
 		return true;
@@ -1194,7 +1310,7 @@ bool P_CeilingSnapshotDone(SectorSnapshot *snap)
 	return false;
 }
 
-bool P_FloorSnapshotDone(SectorSnapshot *snap)
+bool P_FloorSnapshotDone(const SectorSnapshot *snap)
 {
 	if (!snap || !snap->isValid() || snap->getFloorMoverType() == SEC_INVALID)
 		return true;
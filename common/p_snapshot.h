@@ -47,6 +47,36 @@ extern int gametic;
 //#define _WORLD_INDEX_DEBUG_
 //#define _SNAPSHOT_DEBUG_
 
+// ============================================================================
+//
+// SnapshotTimeIndex Interface
+//
+// Keeps the times of the snapshots stored in a manager's ring in sorted
+// order so that the nearest stored snapshot to a given time can be found
+// with a binary search instead of probing every slot of the ring.
+//
+// ============================================================================
+
+class SnapshotTimeIndex
+{
+public:
+	SnapshotTimeIndex() : mCount(0) {}
+
+	void clear() { mCount = 0; }
+
+	void insert(int time);
+	void erase(int time);
+
+	// earliest / latest time in [mintime, maxtime], or -1 if there is none
+	int findFirst(int mintime, int maxtime) const;
+	int findLast(int mintime, int maxtime) const;
+
+private:
+	int		mTimes[NUM_SNAPSHOTS];
+	int		mCount;
+};
+
+
 // ============================================================================
 //
 // Snapshot Base Class Interface
@@ -494,14 +524,18 @@ public:
 	void addSnapshot(const PlayerSnapshot &snap);
 	PlayerSnapshot getSnapshot(int time) const;
 
+	// the stored snapshot for exactly this time, or NULL if there is none
+	const PlayerSnapshot *findSnapshot(int time) const;
+
 private:
 	bool mValidSnapshot(int time) const;
 	int mFindValidSnapshot(int starttime, int endtime) const;
 	PlayerSnapshot mInterpolateSnapshots(int from, int to, int time) const;
 	PlayerSnapshot mExtrapolateSnapshot(int from, int time) const;
 	
-	PlayerSnapshot	mSnaps[NUM_SNAPSHOTS];
-	int				mMostRecent;
+	PlayerSnapshot		mSnaps[NUM_SNAPSHOTS];
+	int					mMostRecent;
+	SnapshotTimeIndex	mTimes;
 };
 
 
@@ -708,12 +742,16 @@ public:
 	
 	void addSnapshot(const SectorSnapshot &snap);
 	SectorSnapshot getSnapshot(int time) const;
+
+	// the stored snapshot for exactly this time, or NULL if there is none
+	const SectorSnapshot *findSnapshot(int time) const;
 	
 private:
 	bool mValidSnapshot(int time) const;
 	
-	SectorSnapshot	mSnaps[NUM_SNAPSHOTS];
-	int				mMostRecent;
+	SectorSnapshot		mSnaps[NUM_SNAPSHOTS];
+	int					mMostRecent;
+	SnapshotTimeIndex	mTimes;
 };
 
 
@@ -731,8 +769,8 @@ ActorSnapshot P_ExtrapolateActorPosition(const ActorSnapshot &from, float amount
 PlayerSnapshot P_LerpPlayerPosition(const PlayerSnapshot &from, const PlayerSnapshot &to, float amount);
 PlayerSnapshot P_ExtrapolatePlayerPosition(const PlayerSnapshot &from, float amount);
 
-bool P_CeilingSnapshotDone(SectorSnapshot *snap);
-bool P_FloorSnapshotDone(SectorSnapshot *snap);
+bool P_CeilingSnapshotDone(const SectorSnapshot *snap);
+bool P_FloorSnapshotDone(const SectorSnapshot *snap);
 
 #endif	// __P_SNAPSHOT_H__
 
@@ -67,49 +67,81 @@
 EXTERN_CVAR(sv_allowexit)
 EXTERN_CVAR(sv_fragexitswitch)
 
-std::list<movingsector_t> movingsectors;
+std::vector<movingsector_t> movingsectors;
 
 //
 // P_FindMovingSector
 //
-std::list<movingsector_t>::iterator P_FindMovingSector(sector_t *sector)
+// Every sector remembers where its entry in movingsectors is.  The index
+// is left behind when the sector stops moving or the list is cleared, so
+// it only counts if the entry there is still this sector's.
+//
+std::vector<movingsector_t>::iterator P_FindMovingSector(sector_t *sector)
 {
-	std::list<movingsector_t>::iterator itr;
-	for (itr = movingsectors.begin(); itr != movingsectors.end(); ++itr)
-		if (sector == itr->sector)
-			return itr;
+	size_t index = sector->movingindex;
+
+	if (index < movingsectors.size() && movingsectors[index].sector == sector)
+		return movingsectors.begin() + index;
 
 	// not found
 	return movingsectors.end();
 }
 
 //
-// P_AddMovingCeiling
+// P_EraseMovingSector
 //
-// Updates the movingsectors list to include the passed sector, which
-// tracks which sectors currently have a moving ceiling/floor
+// Removes an entry from movingsectors by moving the last entry into its
+// place.  Returns the iterator to look at next when walking the list.
 //
-void P_AddMovingCeiling(sector_t *sector)
+std::vector<movingsector_t>::iterator P_EraseMovingSector(std::vector<movingsector_t>::iterator itr)
 {
-	if (!sector)
-		return;
+	size_t index = itr - movingsectors.begin();
+
+	if (index + 1 < movingsectors.size())
+	{
+		movingsectors[index] = movingsectors.back();
+		movingsectors[index].sector->movingindex = index;
+	}
 
-	movingsector_t *movesec;
+	movingsectors.pop_back();
+	return movingsectors.begin() + index;
+}
 
+//
+// P_AddMovingSector
+//
+// Finds the entry for the passed sector in movingsectors, adding one if
+// there is none yet
+//
+static movingsector_t *P_AddMovingSector(sector_t *sector)
+{
 	// Check if this already exists
-	std::list<movingsector_t>::iterator itr = P_FindMovingSector(sector);
+	std::vector<movingsector_t>::iterator itr = P_FindMovingSector(sector);
 	if (itr != movingsectors.end())
 	{
 		// this sector already is moving
-		movesec = &(*itr);
-	}
-	else
-	{
-		movingsectors.push_back(movingsector_t());
-		movesec = &(movingsectors.back());
+		return &(*itr);
 	}
 
-	movesec->sector = sector;
+	sector->movingindex = movingsectors.size();
+	movingsectors.push_back(movingsector_t());
+	movingsectors.back().sector = sector;
+
+	return &(movingsectors.back());
+}
+
+//
+// P_AddMovingCeiling
+//
+// Updates the movingsectors list to include the passed sector, which
+// tracks which sectors currently have a moving ceiling/floor
+//
+void P_AddMovingCeiling(sector_t *sector)
+{
+	if (!sector)
+		return;
+
+	movingsector_t *movesec = P_AddMovingSector(sector);
 	movesec->moving_ceiling = true;
 
 	sector->moveable = true;
@@ -129,22 +161,7 @@ void P_AddMovingFloor(sector_t *sector)
 	if (!sector)
 		return;
 
-	movingsector_t *movesec;
-
-	// Check if this already exists
-	std::list<movingsector_t>::iterator itr = P_FindMovingSector(sector);
-	if (itr != movingsectors.end())
-	{
-		// this sector already is moving
-		movesec = &(*itr);
-	}
-	else
-	{
-		movingsectors.push_back(movingsector_t());
-		movesec = &(movingsectors.back());
-	}
-
-	movesec->sector = sector;
+	movingsector_t *movesec = P_AddMovingSector(sector);
 	movesec->moving_floor = true;
 
 	sector->moveable = true;
@@ -164,7 +181,7 @@ void P_RemoveMovingCeiling(sector_t *sector)
 	if (!sector)
 		return;
 
-	std::list<movingsector_t>::iterator itr = P_FindMovingSector(sector);
+	std::vector<movingsector_t>::iterator itr = P_FindMovingSector(sector);
 	if (itr != movingsectors.end())
 	{
 		itr->moving_ceiling = false;
@@ -172,7 +189,7 @@ void P_RemoveMovingCeiling(sector_t *sector)
 		// Does this sector have a moving floor as well?  If so, just
 		// mark the ceiling as invalid but don't remove from the list
 		if (!itr->moving_floor)
-			movingsectors.erase(itr);
+			P_EraseMovingSector(itr);
 
 		return;
 	}
@@ -189,7 +206,7 @@ void P_RemoveMovingFloor(sector_t *sector)
 	if (!sector)
 		return;
 
-	std::list<movingsector_t>::iterator itr = P_FindMovingSector(sector);
+	std::vector<movingsector_t>::iterator itr = P_FindMovingSector(sector);
 	if (itr != movingsectors.end())
 	{
 		itr->moving_floor = false;
@@ -197,7 +214,7 @@ void P_RemoveMovingFloor(sector_t *sector)
 		// Does this sector have a moving ceiling as well?  If so, just
 		// mark the floor as invalid but don't remove from the list
 		if (!itr->moving_ceiling)
-			movingsectors.erase(itr);
+			P_EraseMovingSector(itr);
 
 		return;
 	}
@@ -1194,6 +1211,9 @@ int P_FindMinSurroundingLight (sector_t *sector, int max)
 	line_t* 	line;
 	sector_t*	check;
 
+	// lights may not have changed the light levels yet
+	DLighting::FlushDeferred ();
+
 	min = max;
 	for (i=0 ; i < sector->linecount ; i++)
 	{
@@ -28,7 +28,7 @@
 #ifndef __P_SPEC__
 #define __P_SPEC__
 
-#include <list>
+#include <vector>
 #include "dsectoreffect.h"
 
 typedef struct movingsector_s
@@ -42,9 +42,12 @@ typedef struct movingsector_s
 	bool		moving_floor;
 } movingsector_t;
 
-extern std::list<movingsector_t> movingsectors;
+// The sectors with a moving floor or ceiling.  Removing one moves the last
+// entry into its place, so the order is not kept.
+extern std::vector<movingsector_t> movingsectors;
 
-std::list<movingsector_t>::iterator P_FindMovingSector(sector_t *sector);
+std::vector<movingsector_t>::iterator P_FindMovingSector(sector_t *sector);
+std::vector<movingsector_t>::iterator P_EraseMovingSector(std::vector<movingsector_t>::iterator itr);
 void P_AddMovingCeiling(sector_t *sector);
 void P_AddMovingFloor(sector_t *sector);
 void P_RemoveMovingCeiling(sector_t *sector);
@@ -272,13 +275,37 @@ sector_t *P_NextSpecialSector (sector_t *sec, int type, sector_t *back2);	// [RH
 // P_LIGHTS
 //
 
+//
+// Light thinkers only ever change the light level of their own sector.
+// Each one runs in two steps: PrepareThink draws its random numbers at its
+// turn in the thinker list, and ApplyThink changes the light level.  With
+// thinkerthreads set, the ApplyThink calls of a tic are collected and run
+// on several threads, split by sector so the lights of one sector still
+// run in order.  Anything else that looks at light levels during the tic
+// has to call DLighting::FlushDeferred first.
+//
 class DLighting : public DSectorEffect
 {
 	DECLARE_SERIAL (DLighting, DSectorEffect);
 public:
 	DLighting (sector_t *sector);
+	void		RunThink ();
+	void		Destroy ();
+
+	static void	StartDeferring ();
+	static void	FlushDeferred ();
+	static void	FinishDeferring ();
 protected:
 	DLighting ();
+
+	// Returns true if ApplyThink has anything to do this tic.
+	virtual bool PrepareThink () { return true; }
+	virtual void ApplyThink () {}
+
+	int			m_Random;	// drawn by PrepareThink for ApplyThink
+
+private:
+	static void	ApplyPart (int part, int numparts, void *data);
 };
 
 class DFireFlicker : public DLighting
@@ -287,8 +314,10 @@ class DFireFlicker : public DLighting
 public:
 	DFireFlicker (sector_t *sector);
 	DFireFlicker (sector_t *sector, int upper, int lower);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	int 		m_Count;
 	int 		m_MaxLight;
 	int 		m_MinLight;
@@ -301,8 +330,10 @@ class DFlicker : public DLighting
 	DECLARE_SERIAL (DFlicker, DLighting)
 public:
 	DFlicker (sector_t *sector, int upper, int lower);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	int 		m_Count;
 	int 		m_MaxLight;
 	int 		m_MinLight;
@@ -316,8 +347,10 @@ class DLightFlash : public DLighting
 public:
 	DLightFlash (sector_t *sector);
 	DLightFlash (sector_t *sector, int min, int max);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	int 		m_Count;
 	int 		m_MaxLight;
 	int 		m_MinLight;
@@ -333,8 +366,10 @@ class DStrobe : public DLighting
 public:
 	DStrobe (sector_t *sector, int utics, int ltics, bool inSync);
 	DStrobe (sector_t *sector, int upper, int lower, int utics, int ltics);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	int 		m_Count;
 	int 		m_MinLight;
 	int 		m_MaxLight;
@@ -349,8 +384,10 @@ class DGlow : public DLighting
 	DECLARE_SERIAL (DGlow, DLighting)
 public:
 	DGlow (sector_t *sector);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	int 		m_MinLight;
 	int 		m_MaxLight;
 	int 		m_Direction;
@@ -364,8 +401,10 @@ class DGlow2 : public DLighting
 	DECLARE_SERIAL (DGlow2, DLighting)
 public:
 	DGlow2 (sector_t *sector, int start, int end, int tics, bool oneshot);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	int			m_Start;
 	int			m_End;
 	int			m_MaxTics;
@@ -382,8 +421,10 @@ class DPhased : public DLighting
 public:
 	DPhased (sector_t *sector);
 	DPhased (sector_t *sector, int baselevel, int phase);
-	void		RunThink ();
 protected:
+	bool		PrepareThink ();
+	void		ApplyThink ();
+
 	byte		m_BaseLevel;
 	byte		m_Phase;
 private:
@@ -59,6 +59,8 @@ void P_Ticker (void)
 		return;
 #endif
 
+	P_RelinkStatsTicker ();
+
 	if (clientside)
 		P_ThinkParticles ();	// [RH] make the particles think
 
@@ -1054,8 +1054,10 @@ static BOOL CheckMobjBlocking (seg_t *seg, polyobj_t *po)
 	{
 		for (i = left; i <= right; i++)
 		{
-			for (mobj = blocklinks[j+i]; mobj; mobj = mobj->bmapnode.Next(i, j/bmapwidth))
+			const blockthings_t *cell = &blockthings[j+i];
+			for (int k = cell->count - 1; k >= 0; k--)
 			{
+				mobj = cell->actors[k];
 				if ((mobj->flags&MF_SOLID) && !(mobj->flags&MF_NOCLIP))
 				{
 					tmbbox[BOXTOP] = mobj->y+mobj->radius;
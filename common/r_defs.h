@@ -180,6 +180,9 @@ struct sector_s
                     // If (sector->moveable) the server sends information
                     // about this sector when a client connects.
 
+	int movingindex;	// where in movingsectors this sector would be, only
+						// valid if the entry there points back at it
+
 	// jff 2/26/98 lockout machinery for stairbuilding
 	int stairlock;		// -2 on first locked -1 after thinker done 0 normally
 	int prevsec;		// -1 or number of sector for previous step
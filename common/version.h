@@ -26,7 +26,10 @@
 
 // Lots of different representations for the version number
 #define CONFIGVERSIONSTR "81"
-#define GAMEVER (0*256+81)
+// GAMEVER is also the network protocol version the server checks when a
+// client connects.  It is ahead of DOTVERSIONSTR because the clc_ack
+// format changed; the next release catches the other numbers up.
+#define GAMEVER (0*256+82)
 
 #define DOTVERSIONSTR "0.8.1"
 
@@ -44,7 +47,9 @@
 // earlier than this version.
 #define SAVESIG "ODAMEXSAVE081   "	// Needs to be exactly 16 chars long
 
-#define NETDEMOVER 3
+// Version 4 added compressed netdemos
+// Version 5 bit-packed svc_mobjspeedangle
+#define NETDEMOVER 5
 
 // denis - per-file svn version stamps
 class file_version
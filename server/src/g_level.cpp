@@ -58,6 +58,7 @@
 #include "s_sndseq.h"
 #include "sc_man.h"
 #include "sv_main.h"
+#include "sv_demo.h"
 #include "sv_maplist.h"
 #include "sv_vote.h"
 #include "v_video.h"
@@ -285,6 +286,8 @@ void SV_CheckTeam(player_t &pl);
 //
 void G_DoNewGame (void)
 {
+	SV_NetDemoNewMap();
+
 	for (Players::iterator it = players.begin();it != players.end();++it)
 	{
 		if(!(it->ingame()))
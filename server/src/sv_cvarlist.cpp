@@ -36,6 +36,21 @@ CVAR(			log_fulltimestamps, "0", "Extended timestamp info (dd/mm/yyyy hh:mm:ss)"
 CVAR(			log_packetdebug, "0", "Print debugging messages for each packet sent",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
 
+CVAR(			sv_netstats, "0", "Keep track of the bandwidth used by each type of server message",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR(			sv_netstatsfile, "", "File to periodically dump bandwidth statistics to as JSON, %m is replaced by the map name",
+				CVARTYPE_STRING, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE)
+
+CVAR_RANGE(		sv_netstatsinterval, "60", "Number of seconds between bandwidth statistics dumps",
+				CVARTYPE_WORD, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 1.0f, 3600.0f)
+
+CVAR_RANGE(		sv_netdemosnapshotspacing, "20", "Number of seconds between the snapshots in netdemos recorded by the server",
+				CVARTYPE_WORD, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 1.0f, 1800.0f)
+
+CVAR_RANGE(		sv_netdemocompression, "1", "Compression used for netdemos recorded by the server (0 = none, 1 = LZO)",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 1.0f)
+
 // Server administrative settings
 // ------------------------------
 
@@ -117,6 +132,9 @@ CVAR_RANGE_FUNC_DECL(sv_maxrate, "200", "Forces clients to be on or below this r
 CVAR_RANGE_FUNC_DECL(sv_waddownloadcap, "200", "Cap wad file downloading to a specific rate",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 7.0f, 100000.0f)
 
+CVAR(			sv_statichuffman, "0", "Use the static huffman model on packets minilzo can not compress (older clients can not decode these packets)",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
 #ifdef ODA_HAVE_MINIUPNP
 CVAR(			sv_upnp, "1", "Enable UPnP support",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
@@ -244,8 +262,6 @@ CVAR(			sv_dmfarspawn, "0", "EXPERIMENTAL: When enabled in DM, players will spaw
                 "from each other.",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE | CVAR_LATCH | CVAR_SERVERINFO)
 
-CVAR(sv_download_test, "0", "Experimental download optimization testing",
-	CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
 
 // Hacky abominations that should be purged with fire and brimstone
 // =================================================================
@@ -0,0 +1,511 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Serverside netdemo recording.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <time.h>
+
+#include "doomstat.h"
+#include "c_console.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "d_main.h"
+#include "g_level.h"
+#include "d_netdemo.h"
+#include "i_system.h"
+#include "m_fileio.h"
+#include "m_swap.h"
+#include "p_ctf.h"
+#include "p_saveg.h"
+#include "version.h"
+#include "sv_main.h"
+#include "sv_netstats.h"
+#include "sv_demo.h"
+
+EXTERN_CVAR(sv_netdemosnapshotspacing)
+EXTERN_CVAR(sv_netdemocompression)
+
+// has to match NetDemo::MAX_SNAPSHOT_SIZE in client/src/cl_demo.h
+static const size_t NETDEMO_MAX_SNAPSHOT_SIZE = 131072;
+
+// What has been sent to one client during the current tic
+struct netdemo_pov_t
+{
+	bool						started;	// the client's stream can be played back
+	std::vector<std::string>	messages;
+};
+
+typedef std::map<byte, netdemo_pov_t> NetDemoPOVs;
+
+static std::string demo_filename;
+static bool demo_pending = false;		// waiting for the next map to start
+static bool demo_recording = false;
+static bool demo_newmap = false;
+
+static NetDemoWriter demo_writer;
+static std::vector<netdemo_index_entry_t> demo_snapshot_index;
+static std::vector<netdemo_index_entry_t> demo_map_index;
+static uint32_t demo_starting_gametic;
+static uint32_t demo_ending_gametic;
+
+static NetDemoPOVs demo_povs;
+
+bool SV_NetDemoRecording()
+{
+	return demo_recording;
+}
+
+//
+// SV_NetDemoSnapshot
+//
+// Writes the state of the world in the same form as the snapshots the
+// client records, so the client can seek to it.
+//
+static void SV_NetDemoSnapshot(bool mapchange)
+{
+	G_SnapshotLevel();
+
+	FLZOMemFile memfile;
+	memfile.Open();
+
+	FArchive arc(memfile);
+
+	byte vars[4096], *vars_p = vars;
+	cvar_t::C_WriteCVars(&vars_p, CVAR_SERVERINFO);
+	arc.WriteCount(vars_p - vars);
+	arc.Write(vars, vars_p - vars);
+
+	arc << (byte)(wadfiles.size() - 1);
+	for (size_t i = 1; i < wadfiles.size(); i++)
+		arc << D_CleanseFileName(wadfiles[i]).c_str();
+	arc << (byte)patchfiles.size();
+	for (size_t i = 0; i < patchfiles.size(); i++)
+		arc << D_CleanseFileName(patchfiles[i]).c_str();
+
+	arc << level.mapname;
+	arc << (BYTE)(gamestate == GS_INTERMISSION);
+
+	G_SerializeSnapshots(arc);
+	P_SerializeRNGState(arc);
+	P_SerializeACSDefereds(arc);
+
+	for (int i = 0; i < NUMFLAGS; i++)
+		arc << CTFdata[i];
+
+	for (int i = 0; i < NUMTEAMS; i++)
+		arc << TEAMpoints[i];
+
+	arc << level.time;
+
+	for (int i = 0; i < NUM_WORLDVARS; i++)
+		arc << ACS_WorldVars[i];
+
+	for (int i = 0; i < NUM_GLOBALVARS; i++)
+		arc << ACS_GlobalVars[i];
+
+	byte check = 0x1d;
+	arc << check;
+
+	arc.Close();
+
+	delete level.info->snapshot;
+	level.info->snapshot = NULL;
+
+	static byte snapbuf[NETDEMO_MAX_SNAPSHOT_SIZE];
+	size_t length = memfile.Length();
+	if (length > sizeof(snapbuf))
+	{
+		Printf(PRINT_HIGH, "Netdemo snapshot too large, skipping it.\n");
+		return;
+	}
+
+	memfile.WriteToBuffer(snapbuf, sizeof(snapbuf));
+
+	netdemo_index_entry_t entry;
+	entry.ticnum = gametic;
+	entry.offset = demo_writer.tell();
+
+	if (mapchange)
+		demo_map_index.push_back(entry);
+	demo_snapshot_index.push_back(entry);
+
+	demo_writer.writeChunk(NETDEMO_MSG_SNAPSHOT, snapbuf, length, gametic);
+}
+
+//
+// SV_NetDemoSplit
+//
+// Adds the messages in buf to the client's messages for this tic, split
+// where SV_NetStatsMarker saw each message start.
+//
+static void SV_NetDemoSplit(netdemo_pov_t &pov, const buf_t *buf)
+{
+	if (buf == NULL || buf->cursize == 0)
+		return;
+
+	std::vector<size_t> offsets;
+	SV_NetStatsMarkers(buf, offsets);
+	offsets.push_back(0);
+	offsets.push_back(buf->cursize);
+	std::sort(offsets.begin(), offsets.end());
+
+	for (size_t i = 0; i + 1 < offsets.size(); i++)
+	{
+		size_t start = offsets[i], end = MIN<size_t>(offsets[i + 1], buf->cursize);
+		if (start < end)
+			pov.messages.push_back(std::string((const char *)buf->data + start, end - start));
+	}
+}
+
+//
+// SV_NetDemoConnection
+//
+// The start of a stream for a client that was already connected when the
+// recording started, standing in for what SV_ConnectClient sent it.  The
+// map and everything else about the world follow when the map loads.
+//
+static void SV_NetDemoConnection(player_t &player, netdemo_pov_t &pov)
+{
+	static buf_t buf(MAX_UDP_PACKET);
+	SZ_Clear(&buf);
+
+	// the packet sequence number that tells the client it is connected
+	MSG_WriteLong(&buf, 0);
+
+	MSG_WriteByte(&buf, svc_consoleplayer);
+	MSG_WriteByte(&buf, player.id);
+	MSG_WriteString(&buf, player.client.digest.c_str());
+
+	MSG_WriteByte(&buf, svc_serversettings);
+	for (cvar_t *var = GetFirstCvar(); var; var = var->GetNext())
+	{
+		if (var->flags() & CVAR_SERVERINFO)
+		{
+			MSG_WriteByte(&buf, 1);
+			MSG_WriteString(&buf, var->name());
+			MSG_WriteString(&buf, var->cstring());
+		}
+	}
+	MSG_WriteByte(&buf, 2);
+
+	pov.messages.push_back(std::string((const char *)buf.data, buf.cursize));
+	pov.started = true;
+}
+
+//
+// SV_NetDemoLocalCmd
+//
+// The client records its own position every tic since the server does not
+// send a player where they are.  Write the same message for each player.
+//
+static void SV_NetDemoLocalCmd(player_t &player, netdemo_pov_t &pov)
+{
+	if (!player.mo)
+		return;
+
+	static buf_t buf(MAX_UDP_PACKET);
+	SZ_Clear(&buf);
+
+	NetDemo_WriteLocalCmd(&buf, player);
+
+	pov.messages.push_back(std::string((const char *)buf.data, buf.cursize));
+}
+
+//
+// SV_NetDemoWritePOVs
+//
+// Writes everything sent this tic as one chunk:
+//
+//   WORD count, then count messages of LONG length and data
+//   BYTE number of clients, then for each client
+//     BYTE player id, WORD count, then count WORD message numbers
+//
+// A message sent to several clients is only stored once.
+//
+static void SV_NetDemoWritePOVs()
+{
+	std::map<std::string, size_t> lookup;
+	std::vector<const std::string *> messages;
+	std::vector<std::pair<byte, std::vector<size_t> > > refs;
+
+	for (NetDemoPOVs::iterator it = demo_povs.begin(); it != demo_povs.end(); ++it)
+	{
+		netdemo_pov_t &pov = it->second;
+		if (!pov.started)
+			continue;
+
+		player_t &player = idplayer(it->first);
+		if (validplayer(player))
+			SV_NetDemoLocalCmd(player, pov);
+
+		if (pov.messages.empty())
+			continue;
+
+		refs.push_back(std::make_pair(it->first, std::vector<size_t>()));
+		std::vector<size_t> &list = refs.back().second;
+
+		for (size_t i = 0; i < pov.messages.size() && list.size() < 0xFFFF; i++)
+		{
+			std::map<std::string, size_t>::iterator found = lookup.find(pov.messages[i]);
+			if (found == lookup.end())
+			{
+				if (messages.size() >= 0xFFFF)
+					break;
+
+				found = lookup.insert(std::make_pair(pov.messages[i], messages.size())).first;
+				messages.push_back(&found->first);
+			}
+
+			list.push_back(found->second);
+		}
+	}
+
+	if (!refs.empty())
+	{
+		static std::vector<byte> chunk;
+		chunk.clear();
+
+		#define PUT_SHORT(v) { uint16_t s = LESHORT((uint16_t)(v)); \
+			chunk.insert(chunk.end(), (byte *)&s, (byte *)&s + 2); }
+		#define PUT_LONG(v) { uint32_t l = LELONG((uint32_t)(v)); \
+			chunk.insert(chunk.end(), (byte *)&l, (byte *)&l + 4); }
+
+		PUT_SHORT(messages.size());
+		for (size_t i = 0; i < messages.size(); i++)
+		{
+			PUT_LONG(messages[i]->size());
+			chunk.insert(chunk.end(), messages[i]->begin(), messages[i]->end());
+		}
+
+		chunk.push_back((byte)refs.size());
+		for (size_t i = 0; i < refs.size(); i++)
+		{
+			chunk.push_back(refs[i].first);
+			PUT_SHORT(refs[i].second.size());
+			for (size_t j = 0; j < refs[i].second.size(); j++)
+				PUT_SHORT(refs[i].second[j]);
+		}
+
+		#undef PUT_SHORT
+		#undef PUT_LONG
+
+		demo_writer.writeChunk(NETDEMO_MSG_POVPACKET, &chunk[0], chunk.size(), gametic);
+	}
+
+	for (NetDemoPOVs::iterator it = demo_povs.begin(); it != demo_povs.end(); ++it)
+		it->second.messages.clear();
+}
+
+//
+// SV_NetDemoBegin
+//
+static bool SV_NetDemoBegin()
+{
+	demo_pending = false;
+
+	byte compression = sv_netdemocompression ? NETDEMO_COMP_LZO : NETDEMO_COMP_NONE;
+
+	if (!demo_writer.open(demo_filename, compression))
+	{
+		Printf(PRINT_HIGH, "Unable to create netdemo file %s.\n", demo_filename.c_str());
+		return false;
+	}
+
+	demo_snapshot_index.clear();
+	demo_map_index.clear();
+	demo_starting_gametic = demo_ending_gametic = gametic;
+
+	demo_povs.clear();
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->ingame())
+			SV_NetDemoConnection(*it, demo_povs[it->id]);
+	}
+
+	demo_recording = true;
+
+	Printf(PRINT_HIGH, "Recording netdemo %s.\n", demo_filename.c_str());
+	return true;
+}
+
+static void STACK_ARGS SV_NetDemoShutdown()
+{
+	SV_StopNetDemo();
+}
+
+bool SV_StartNetDemo(const std::string &filename)
+{
+	if (demo_recording || demo_pending)
+	{
+		Printf(PRINT_HIGH, "Already recording a netdemo.\n");
+		return false;
+	}
+
+	static bool shutdown_registered = false;
+	if (!shutdown_registered)
+	{
+		atterm(SV_NetDemoShutdown);
+		shutdown_registered = true;
+	}
+
+	demo_filename = filename;
+	demo_pending = true;
+
+	Printf(PRINT_HIGH, "Netdemo %s will be recorded from the start of the next map.\n",
+		demo_filename.c_str());
+	return true;
+}
+
+void SV_StopNetDemo()
+{
+	if (demo_pending)
+	{
+		demo_pending = false;
+		Printf(PRINT_HIGH, "Netdemo recording cancelled.\n");
+		return;
+	}
+
+	if (!demo_recording)
+		return;
+
+	demo_recording = false;
+
+	// anything still waiting to be written, then the end-of-demo marker
+	// every client's view shares
+	SV_NetDemoWritePOVs();
+
+	byte marker = svc_netdemostop;
+	demo_writer.writeChunk(NETDEMO_MSG_PACKET, &marker, sizeof(marker), gametic);
+	demo_ending_gametic = gametic;
+
+	netdemo_header_t header;
+	memset(&header, 0, sizeof(header));
+	header.snapshot_spacing = sv_netdemosnapshotspacing.asInt() * TICRATE;
+	header.starting_gametic = demo_starting_gametic;
+	header.ending_gametic = demo_ending_gametic;
+
+	header.snapshot_index_offset = demo_writer.tell();
+	header.snapshot_index_size = demo_snapshot_index.size();
+	demo_writer.writeIndex(demo_snapshot_index);
+
+	header.map_index_offset = demo_writer.tell();
+	header.map_index_size = demo_map_index.size();
+	demo_writer.writeIndex(demo_map_index);
+
+	demo_povs.clear();
+
+	if (!demo_writer.finish(header))
+		Printf(PRINT_HIGH, "Unable to write netdemo file %s.\n", demo_filename.c_str());
+	else
+		Printf(PRINT_HIGH, "Netdemo recording has stopped.\n");
+}
+
+void SV_NetDemoCapture(player_t &player, const buf_t *reliable, const buf_t *unreliable)
+{
+	if (!demo_recording)
+		return;
+
+	netdemo_pov_t &pov = demo_povs[player.id];
+
+	if (!pov.started)
+	{
+		// clients that connect while recording can be followed from the
+		// start of their connection
+		if (reliable == NULL || reliable->cursize == 0 ||
+			reliable->data[0] != svc_consoleplayer)
+			return;
+
+		pov.messages.push_back(std::string(4, '\0'));
+		pov.started = true;
+	}
+
+	SV_NetDemoSplit(pov, reliable);
+	SV_NetDemoSplit(pov, unreliable);
+}
+
+void SV_NetDemoNewMap()
+{
+	if (demo_pending && !SV_NetDemoBegin())
+		return;
+
+	if (demo_recording)
+		demo_newmap = true;
+}
+
+void SV_NetDemoTicker()
+{
+	if (!demo_recording)
+		return;
+
+	SV_NetDemoWritePOVs();
+	demo_ending_gametic = gametic;
+
+	int spacing = sv_netdemosnapshotspacing.asInt() * TICRATE;
+
+	if (demo_newmap)
+	{
+		demo_newmap = false;
+		SV_NetDemoSnapshot(true);
+	}
+	else if (gamestate == GS_LEVEL && !demo_map_index.empty() &&
+			 (gametic - (int)demo_map_index.back().ticnum) % spacing == 0)
+	{
+		SV_NetDemoSnapshot(false);
+	}
+
+	if (demo_writer.failed())
+	{
+		Printf(PRINT_HIGH, "Unable to write netdemo file %s.\n", demo_filename.c_str());
+		SV_StopNetDemo();
+	}
+}
+
+BEGIN_COMMAND(netrecord)
+{
+	std::string filename;
+
+	if (argc > 1 && strlen(argv[1]) > 0)
+	{
+		filename = argv[1];
+	}
+	else
+	{
+		char name[64];
+		time_t now = time(NULL);
+		strftime(name, sizeof(name), "odasrv-%Y%m%d-%H%M%S", localtime(&now));
+		filename = name;
+	}
+
+	M_AppendExtension(filename, ".odd");
+	SV_StartNetDemo(filename);
+}
+END_COMMAND(netrecord)
+
+BEGIN_COMMAND(stopnetdemo)
+{
+	SV_StopNetDemo();
+}
+END_COMMAND(stopnetdemo)
+
+VERSION_CONTROL (sv_demo_cpp, "$Id$")
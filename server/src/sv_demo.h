@@ -0,0 +1,58 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Serverside netdemo recording.
+//
+//	Records what is sent to every client into a single netdemo that the
+//	client can play back from any of those players' point of view.  Each
+//	tic is one chunk holding the messages sent that tic, split at the
+//	markers SV_NetStatsMarker keeps, with every distinct message stored
+//	once and each client's packet stored as a list of messages.  Full
+//	snapshots of the world are written at map changes and every
+//	sv_netdemosnapshotspacing seconds for seeking.
+//
+//	The file layout matches the netdemos recorded by the client, see
+//	client/src/cl_demo.h.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __SV_DEMO_H__
+#define __SV_DEMO_H__
+
+#include <string>
+
+#include "d_player.h"
+#include "i_net.h"
+
+// Starts recording to filename when the next map is loaded.
+bool SV_StartNetDemo(const std::string &filename);
+void SV_StopNetDemo();
+bool SV_NetDemoRecording();
+
+// Called by SV_SendPacket with the data about to be sent to a client,
+// either buffer is NULL when that part is not being sent.
+void SV_NetDemoCapture(player_t &player, const buf_t *reliable, const buf_t *unreliable);
+
+// Called before a new map is sent to the clients.
+void SV_NetDemoNewMap();
+
+// Called once per tic after the packets have been sent.
+void SV_NetDemoTicker();
+
+#endif	// __SV_DEMO_H__
@@ -0,0 +1,423 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Windowed WAD downloads.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "d_player.h"
+#include "i_net.h"
+#include "i_system.h"
+#include "m_fileio.h"
+#include "sv_main.h"
+#include "sv_download.h"
+
+EXTERN_CVAR(sv_waddownloadcap)
+
+// Data per svc_wadchunk.  Small enough for the packet carrying it to fit
+// in a 1500 byte MTU, so it won't get fragmented or dropped.
+#define WADCHUNK_SIZE		1400
+
+// Chunks that can be in flight, which is also how many the client
+// acknowledges at once.
+#define MAX_WINDOW			256
+#define INITIAL_WINDOW		4
+
+// later sends that must be acknowledged before a chunk counts as lost
+#define DOWNLOAD_REORDER	3
+
+typedef player_t::client_t::download_t download_t;
+
+// Files are read into memory in blocks of this size the first time any
+// client needs them, then shared by everyone downloading the file.  A
+// whole number of chunks, so no chunk straddles two blocks.
+#define CACHE_BLOCK_SIZE	(WADCHUNK_SIZE * 47)
+
+// ms a file stays cached after its last downloader is gone
+#define CACHE_IDLE_TIME		60000
+
+struct cached_file_t
+{
+	FILE				*file;
+	unsigned int		length;
+	std::vector<byte *>	blocks;		// NULL until read
+	int					refs;		// clients downloading the file
+	dtime_t				last_used;
+};
+
+typedef std::map<std::string, cached_file_t> DownloadCache;
+static DownloadCache download_cache;
+
+static void SV_FreeCachedFile(cached_file_t &cached)
+{
+	for (size_t i = 0; i < cached.blocks.size(); i++)
+		delete[] cached.blocks[i];
+
+	cached.blocks.clear();
+
+	if (cached.file)
+		fclose(cached.file);
+
+	cached.file = NULL;
+}
+
+//
+// SV_GetCachedFile
+//
+static cached_file_t *SV_GetCachedFile(const std::string &filename)
+{
+	DownloadCache::iterator it = download_cache.find(filename);
+	if (it != download_cache.end())
+		return &it->second;
+
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return NULL;
+
+	cached_file_t &cached = download_cache[filename];
+
+	cached.file = file;
+	cached.length = M_FileLength(file);
+	cached.blocks.assign((cached.length + CACHE_BLOCK_SIZE - 1) / CACHE_BLOCK_SIZE, (byte *)NULL);
+	cached.refs = 0;
+	cached.last_used = I_MSTime();
+
+	return &cached;
+}
+
+//
+// SV_GetCachedChunk
+//
+// Returns the chunk of filename at offset, reading it from disk only if no
+// other client needed that part of the file before.
+//
+static const byte *SV_GetCachedChunk(const std::string &filename, unsigned int offset, size_t &len)
+{
+	cached_file_t *cached = SV_GetCachedFile(filename);
+
+	if (!cached || offset >= cached->length)
+		return NULL;
+
+	size_t block = offset / CACHE_BLOCK_SIZE;
+	size_t blockstart = block * CACHE_BLOCK_SIZE;
+	size_t blocklen = cached->length - blockstart < CACHE_BLOCK_SIZE ?
+		cached->length - blockstart : CACHE_BLOCK_SIZE;
+
+	if (cached->blocks[block] == NULL)
+	{
+		byte *data = new byte[blocklen];
+
+		if (fseek(cached->file, blockstart, SEEK_SET) != 0 ||
+			fread(data, 1, blocklen, cached->file) != blocklen)
+		{
+			delete[] data;
+			return NULL;
+		}
+
+		cached->blocks[block] = data;
+	}
+
+	len = blockstart + blocklen - offset < WADCHUNK_SIZE ?
+		blockstart + blocklen - offset : WADCHUNK_SIZE;
+
+	return cached->blocks[block] + (offset - blockstart);
+}
+
+//
+// SV_UpdateDownloadCache
+//
+// Count the clients downloading each file, and drop files nobody has
+// needed for a while.
+//
+static void SV_UpdateDownloadCache(dtime_t now)
+{
+	for (DownloadCache::iterator it = download_cache.begin(); it != download_cache.end(); ++it)
+		it->second.refs = 0;
+
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->playerstate != PST_DOWNLOAD || it->client.download.name.empty())
+			continue;
+
+		DownloadCache::iterator cached = download_cache.find(it->client.download.name);
+		if (cached != download_cache.end())
+			cached->second.refs++;
+	}
+
+	DownloadCache::iterator it = download_cache.begin();
+	while (it != download_cache.end())
+	{
+		if (it->second.refs)
+			it->second.last_used = now;
+
+		if (now - it->second.last_used >= CACHE_IDLE_TIME)
+		{
+			SV_FreeCachedFile(it->second);
+			download_cache.erase(it++);
+		}
+		else
+			++it;
+	}
+}
+
+//
+// SV_DownloadStart
+//
+void SV_DownloadStart(player_t &player, const std::string &filename, unsigned int offset)
+{
+	download_t &dl = player.client.download;
+
+	dl.name = filename;
+
+	cached_file_t *cached = SV_GetCachedFile(filename);
+	dl.length = cached ? cached->length : 0;
+
+	// resume from the start of a chunk
+	dl.acked_offset = dl.next_offset = offset - offset % WADCHUNK_SIZE;
+	dl.started = false;
+
+	dl.window.clear();
+	dl.sendseq = 0;
+	dl.acked_sendseq = 0;
+	dl.recovery_sendseq = 0;
+
+	dl.cwnd = INITIAL_WINDOW;
+	dl.ssthresh = MAX_WINDOW;
+	dl.credit = 0;
+}
+
+//
+// SV_DownloadAcked
+//
+// Every chunk that gets through opens the window a bit further, quickly
+// until the first loss and slowly afterwards.
+//
+static void SV_DownloadAcked(download_t &dl, download_t::chunk_t &chunk)
+{
+	if (chunk.acked)
+		return;
+
+	chunk.acked = true;
+
+	if (chunk.sendseq > dl.acked_sendseq)
+		dl.acked_sendseq = chunk.sendseq;
+
+	if (dl.cwnd < dl.ssthresh)
+		dl.cwnd += 1;
+	else
+		dl.cwnd += 1 / dl.cwnd;
+
+	if (dl.cwnd > MAX_WINDOW)
+		dl.cwnd = MAX_WINDOW;
+}
+
+//
+// SV_DownloadAck
+//
+// The client sends how much of the file it has from the start, and a
+// bitfield of which of the chunks after the first missing one it has.
+//
+void SV_DownloadAck(player_t &player)
+{
+	unsigned int offset = MSG_ReadLong();
+	size_t len = MSG_ReadByte();
+
+	byte received[MAX_WINDOW / 8];
+	for (size_t i = 0; i < len; i++)
+	{
+		byte b = MSG_ReadByte();
+		if (i < sizeof(received))
+			received[i] = b;
+	}
+
+	if (len > sizeof(received))
+		len = sizeof(received);
+
+	download_t &dl = player.client.download;
+
+	if (player.playerstate != PST_DOWNLOAD || dl.name.empty())
+		return;
+
+	// the client can't have more than has been sent, the ack is bogus
+	if (offset > dl.next_offset)
+		return;
+
+	dl.started = true;
+
+	while (dl.acked_offset < offset && !dl.window.empty())
+	{
+		SV_DownloadAcked(dl, dl.window.front());
+		dl.window.pop_front();
+		dl.acked_offset += WADCHUNK_SIZE;
+	}
+
+	size_t base = offset / WADCHUNK_SIZE + 1;
+	size_t first = dl.acked_offset / WADCHUNK_SIZE;
+
+	for (size_t i = 0; i < len * 8; i++)
+	{
+		if (!(received[i / 8] & (1 << (i % 8))))
+			continue;
+
+		if (base + i >= first && base + i - first < dl.window.size())
+			SV_DownloadAcked(dl, dl.window[base + i - first]);
+	}
+
+	// drop acknowledged chunks off the front of the window
+	while (!dl.window.empty() && dl.window.front().acked)
+	{
+		dl.window.pop_front();
+		dl.acked_offset += WADCHUNK_SIZE;
+	}
+}
+
+//
+// SV_SendDownloadChunk
+//
+static bool SV_SendDownloadChunk(player_t &player, unsigned int offset)
+{
+	client_t *cl = &player.client;
+	download_t &dl = cl->download;
+
+	size_t read;
+	const byte *data = SV_GetCachedChunk(dl.name, offset, read);
+	if (!data)
+		return false;
+
+	// [SL] 2011-08-09 - Always send the data in netbuf and reliablebuf prior
+	// to writing a wadchunk to netbuf to keep packet sizes below the MTU.
+	// This prevents packets from getting dropped due to size on some networks.
+	if (cl->netbuf.size() + cl->reliablebuf.size())
+		SV_SendPacket(player);
+
+	// repeated until the client acknowledges something
+	if (!dl.started)
+	{
+		MSG_WriteMarker(&cl->netbuf, svc_wadinfo);
+		MSG_WriteLong(&cl->netbuf, dl.length);
+		MSG_WriteShort(&cl->netbuf, WADCHUNK_SIZE);
+	}
+
+	MSG_WriteMarker(&cl->netbuf, svc_wadchunk);
+	MSG_WriteLong(&cl->netbuf, offset);
+	MSG_WriteShort(&cl->netbuf, read);
+	MSG_WriteChunk(&cl->netbuf, data, read);
+
+	// Make double-sure the wadchunk is sent in its own packet
+	SV_SendPacket(player);
+
+	dl.credit -= read;
+
+	return true;
+}
+
+//
+// SV_DownloadTicker
+//
+static void SV_DownloadTicker(player_t &player, dtime_t now)
+{
+	client_t *cl = &player.client;
+	download_t &dl = cl->download;
+
+	// maximum rate client can download at (in bytes per second)
+	int download_rate = (sv_waddownloadcap > cl->rate) ? cl->rate * 1000 : sv_waddownloadcap * 1000;
+
+	// unused allowance doesn't pile up beyond a chunk
+	dl.credit += download_rate / TICRATE;
+	if (dl.credit > download_rate / TICRATE + WADCHUNK_SIZE)
+		dl.credit = download_rate / TICRATE + WADCHUNK_SIZE;
+
+	dtime_t timeout = SV_RetransmitTimeout(cl);
+	size_t inflight = 0;
+
+	// send lost chunks again first
+	for (size_t i = 0; i < dl.window.size(); i++)
+	{
+		download_t::chunk_t &chunk = dl.window[i];
+
+		if (chunk.acked)
+			continue;
+
+		inflight++;
+
+		if (dl.credit < WADCHUNK_SIZE)
+			continue;
+
+		bool timedout = now - chunk.time >= timeout;
+
+		if (!timedout && chunk.sendseq + DOWNLOAD_REORDER > dl.acked_sendseq)
+			continue;
+
+		// back off, once for all the chunks lost in the same window
+		if (chunk.sendseq > dl.recovery_sendseq)
+		{
+			dl.ssthresh = dl.cwnd / 2 > 2 ? dl.cwnd / 2 : 2;
+			dl.cwnd = timedout ? 2 : dl.ssthresh;
+			dl.recovery_sendseq = dl.sendseq;
+		}
+
+		if (!SV_SendDownloadChunk(player, dl.acked_offset + i * WADCHUNK_SIZE))
+			return;
+
+		chunk.time = now;
+		chunk.sendseq = ++dl.sendseq;
+	}
+
+	// then new ones, as far as the window allows
+	while (dl.credit >= WADCHUNK_SIZE && inflight < dl.cwnd && dl.next_offset < dl.length)
+	{
+		if (!SV_SendDownloadChunk(player, dl.next_offset))
+			return;
+
+		download_t::chunk_t chunk;
+		chunk.time = now;
+		chunk.sendseq = ++dl.sendseq;
+		chunk.acked = false;
+
+		dl.window.push_back(chunk);
+		dl.next_offset += WADCHUNK_SIZE;
+		inflight++;
+	}
+}
+
+//
+// SV_WadDownloads
+//
+void SV_WadDownloads()
+{
+	dtime_t now = I_MSTime();
+
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->playerstate != PST_DOWNLOAD || it->client.download.name.empty())
+			continue;
+
+		SV_DownloadTicker(*it, now);
+	}
+
+	SV_UpdateDownloadCache(now);
+}
+
+VERSION_CONTROL (sv_download_cpp, "$Id$")
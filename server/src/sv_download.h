@@ -0,0 +1,51 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Windowed WAD downloads.
+//
+//	The server keeps a window of svc_wadchunks in flight to every
+//	downloading client.  The client acknowledges the chunks it has with
+//	clc_wadack, chunks that go missing are sent again, and the size of
+//	the window grows and shrinks with packet loss the way TCP does, up to
+//	the rate allowed by sv_waddownloadcap.
+//
+//	Files are read from disk once, a block at a time as the first client
+//	gets to it, and every client downloading the same file is served from
+//	that copy.  Files are dropped from memory after nobody has downloaded
+//	them for a minute.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __SV_DOWNLOAD_H__
+#define __SV_DOWNLOAD_H__
+
+#include <string>
+
+#include "d_player.h"
+
+// Start sending filename to the player from offset on.
+void SV_DownloadStart(player_t &player, const std::string &filename, unsigned int offset);
+
+// Parse a clc_wadack.
+void SV_DownloadAck(player_t &player);
+
+// Called once per tic to send chunks to every downloading client.
+void SV_WadDownloads();
+
+#endif	// __SV_DOWNLOAD_H__
@@ -64,6 +64,10 @@
 #include "sv_maplist.h"
 #include "g_warmup.h"
 #include "sv_banlist.h"
+#include "sv_netstats.h"
+#include "m_bitstream.h"
+#include "sv_demo.h"
+#include "sv_download.h"
 #include "d_main.h"
 #include "m_fileio.h"
 
@@ -500,6 +504,8 @@ Players::iterator SV_GetFreeClient(void)
 	players.back().id = *id;
 	free_player_ids.erase(id);
 
+	SV_NetStatsRegisterClient(players.back());
+
 	// update tracking cvar
 	sv_clientcount.ForceSet(players.size());
 
@@ -572,6 +578,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 		it->mo = AActor::AActorPtr();
 	}
 
+	SV_NetStatsUnregisterClient(*it);
+
 	// remove this player from the global players vector
 	Players::iterator next;
 	next = players.erase(it);
@@ -1364,7 +1372,7 @@ void SV_UpdateSectors(client_t* cl)
 //
 void SV_DestroyFinishedMovingSectors()
 {
-	std::list<movingsector_t>::iterator itr;
+	std::vector<movingsector_t>::iterator itr;
 	itr = movingsectors.begin();
 
 	while (itr != movingsectors.end())
@@ -1387,7 +1395,7 @@ void SV_DestroyFinishedMovingSectors()
 		}
 
 		if (!itr->moving_ceiling && !itr->moving_floor)
-			movingsectors.erase(itr++);
+			itr = P_EraseMovingSector(itr);
 		else
 			++itr;
 	}
@@ -1549,7 +1557,7 @@ void SV_SendMovingSectorUpdate(player_t &player, sector_t *sector)
 //
 void SV_UpdateMovingSectors(player_t &player)
 {
-	std::list<movingsector_t>::iterator itr;
+	std::vector<movingsector_t>::iterator itr;
 	for (itr = movingsectors.begin(); itr != movingsectors.end(); ++itr)
 	{
 		sector_t *sector = itr->sector;
@@ -1923,15 +1931,12 @@ void SV_ConnectClient()
 
 	SZ_Clear(&cl->netbuf);
 	SZ_Clear(&cl->reliablebuf);
-	SZ_Clear(&cl->relpackets);
-
-	memset(cl->packetseq, -1, sizeof(cl->packetseq));
-	memset(cl->packetbegin, 0, sizeof(cl->packetbegin));
-	memset(cl->packetsize, 0, sizeof(cl->packetsize));
+	cl->relstore.clear();
 
 	cl->sequence = 0;
 	cl->last_sequence = -1;
-	cl->packetnum = 0;
+	cl->srtt = 0;
+	cl->rttvar = 0;
 	
 	// generate a random string
 	std::stringstream ss;
@@ -2886,6 +2891,33 @@ bool SV_PrivMsg(player_t &player)
 	return true;
 }
 
+//
+// SV_WriteMobjSpeedAngle
+//
+// Writes svc_mobjspeedangle for mo.  The angle is cut to 16 bits, like the
+// angle of a ticcmd, and the momentum is only sent when the actor moves,
+// as zig-zag varints since most of it is small.
+//
+static void SV_WriteMobjSpeedAngle(buf_t *buf, AActor *mo)
+{
+	MSG_WriteMarker(buf, svc_mobjspeedangle);
+
+	BitWriter bits(*buf);
+	bits.WriteBits(mo->netid, 16);
+	bits.WriteAngle(mo->angle, 16);
+
+	bool moving = mo->momx || mo->momy || mo->momz;
+	bits.WriteBool(moving);
+	if (moving)
+	{
+		bits.WriteVarInt(mo->momx);
+		bits.WriteVarInt(mo->momy);
+		bits.WriteVarInt(mo->momz);
+	}
+
+	bits.Flush();
+}
+
 //
 // SV_UpdateMissiles
 // Updates missiles position sometimes.
@@ -2921,12 +2953,7 @@ void SV_UpdateMissiles(player_t &pl)
 			MSG_WriteLong (&cl->netbuf, mo->y);
 			MSG_WriteLong (&cl->netbuf, mo->z);
 
-			MSG_WriteMarker (&cl->netbuf, svc_mobjspeedangle);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteLong (&cl->netbuf, mo->angle);
-			MSG_WriteLong (&cl->netbuf, mo->momx);
-			MSG_WriteLong (&cl->netbuf, mo->momy);
-			MSG_WriteLong (&cl->netbuf, mo->momz);
+			SV_WriteMobjSpeedAngle(&cl->netbuf, mo);
 
 			if (mo->tracer)
 			{
@@ -2993,12 +3020,7 @@ void SV_UpdateMonsters(player_t &pl)
 			MSG_WriteLong(&cl->netbuf, mo->y);
 			MSG_WriteLong(&cl->netbuf, mo->z);
 
-			MSG_WriteMarker(&cl->netbuf, svc_mobjspeedangle);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteLong(&cl->netbuf, mo->angle);
-			MSG_WriteLong(&cl->netbuf, mo->momx);
-			MSG_WriteLong(&cl->netbuf, mo->momy);
-			MSG_WriteLong(&cl->netbuf, mo->momz);
+			SV_WriteMobjSpeedAngle(&cl->netbuf, mo);
 
 			MSG_WriteMarker(&cl->netbuf, svc_actor_movedir);
 			MSG_WriteShort(&cl->netbuf, mo->netid);
@@ -4088,9 +4110,8 @@ void SV_WantWad(player_t &player)
 	if (player.playerstate != PST_DOWNLOAD || cl->download.name != wadfiles[i])
 		Printf(PRINT_HIGH, "> client %d is downloading %s\n", player.id, filename.c_str());
 
-	cl->download.name = wadfiles[i];
-	cl->download.next_offset = next_offset;
 	player.playerstate = PST_DOWNLOAD;
+	SV_DownloadStart(player, wadfiles[i], next_offset);
 }
 
 //
@@ -4153,6 +4174,10 @@ void SV_ParseCommands(player_t &player)
 			SV_AcknowledgePacket(player);
 			break;
 
+		case clc_wadack:
+			SV_DownloadAck(player);
+			break;
+
 		case clc_rcon:
 			{
 				std::string str(MSG_ReadString());
@@ -4284,165 +4309,6 @@ void SV_WinCheck (void)
 	}
 }
 
-EXTERN_CVAR (sv_waddownloadcap)
-EXTERN_CVAR (sv_download_test)
-
-void SV_OptimizedDownloadTest()
-{
-	// nobody around?
-	if (players.empty())
-		return;
-
-	FILE* file = NULL;
-	std::string lastDownloadName;
-
-	// wad downloading
-	for (Players::iterator it = players.begin(); it != players.end(); ++it)
-	{
-		if (it->playerstate != PST_DOWNLOAD)
-			continue;
-
-		client_t *cl = &(it->client);
-
-		if (!cl->download.name.length())
-			continue;
-
-		static char buff[1024];
-		// Smaller buffer for slower clients
-		int chunk_size = (sizeof(buff) > (unsigned)cl->rate * 1000 / TICRATE) ? cl->rate * 1000 / TICRATE : sizeof(buff);
-
-		// maximum rate client can download at (in bytes per second)
-		int download_rate = (sv_waddownloadcap > cl->rate) ? cl->rate * 1000 : sv_waddownloadcap * 1000;
-
-		//Try to open/close the download file as little as possible.
-		//Too many fopen/fclose calls is inefficient and can choke out the game loop causing the server to be choppy with multiple clients downloading
-		if (lastDownloadName != cl->download.name)
-		{
-			if (file)
-				fclose(file);
-			file = fopen(cl->download.name.c_str(), "rb");
-			lastDownloadName = cl->download.name;
-		}
-
-		if (!file)
-			return;
-
-		do
-		{
-			// [SL] 2011-08-09 - Always send the data in netbuf and reliablebuf prior
-			// to writing a wadchunk to netbuf to keep packet sizes below the MTU.
-			// This prevents packets from getting dropped due to size on some networks.
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			if (!cl->download.next_offset)
-			{
-				MSG_WriteMarker(&cl->netbuf, svc_wadinfo);
-				MSG_WriteLong(&cl->netbuf, M_FileLength(file));
-			}
-
-			fseek(file, cl->download.next_offset, SEEK_SET);
-			size_t read = fread(buff, 1, chunk_size, file);
-
-			if (!read)
-				break;
-
-			MSG_WriteMarker(&cl->netbuf, svc_wadchunk);
-			MSG_WriteLong(&cl->netbuf, cl->download.next_offset);
-			MSG_WriteShort(&cl->netbuf, read);
-			MSG_WriteChunk(&cl->netbuf, buff, read);
-
-			// Make double-sure the wadchunk is sent in its own packet
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			cl->download.next_offset += read;
-		} while (
-			(double)(cl->reliable_bps + cl->unreliable_bps) * TICRATE
-			/ (double)(gametic % TICRATE)	// bps already used
-			+ (double)chunk_size / TICRATE 	// bps this chunk will use
-			< (double)download_rate);
-	}
-
-	if (file)
-		fclose(file);
-}
-
-void SV_DownloadOriginal()
-{
-	// nobody around?
-	if (players.empty())
-		return;
-
-	// wad downloading
-	for (Players::iterator it = players.begin(); it != players.end(); ++it)
-	{
-		if (it->playerstate != PST_DOWNLOAD)
-			continue;
-
-		client_t *cl = &(it->client);
-
-		if (!cl->download.name.length())
-			continue;
-
-		static char buff[1024];
-		// Smaller buffer for slower clients
-		int chunk_size = (sizeof(buff) > (unsigned)cl->rate * 1000 / TICRATE) ? cl->rate * 1000 / TICRATE : sizeof(buff);
-
-		// maximum rate client can download at (in bytes per second)
-		int download_rate = (sv_waddownloadcap > cl->rate) ? cl->rate * 1000 : sv_waddownloadcap * 1000;
-
-		do
-		{
-			// read next bit of wad
-			unsigned int read;
-			unsigned int filelen = 0;
-			read = W_ReadChunk(cl->download.name.c_str(), cl->download.next_offset, chunk_size, buff, filelen);
-
-			if (!read)
-				break;
-
-			// [SL] 2011-08-09 - Always send the data in netbuf and reliablebuf prior
-			// to writing a wadchunk to netbuf to keep packet sizes below the MTU.
-			// This prevents packets from getting dropped due to size on some networks.
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			if (!cl->download.next_offset)
-			{
-				MSG_WriteMarker(&cl->netbuf, svc_wadinfo);
-				MSG_WriteLong(&cl->netbuf, filelen);
-			}
-
-			MSG_WriteMarker(&cl->netbuf, svc_wadchunk);
-			MSG_WriteLong(&cl->netbuf, cl->download.next_offset);
-			MSG_WriteShort(&cl->netbuf, read);
-			MSG_WriteChunk(&cl->netbuf, buff, read);
-
-			// Make double-sure the wadchunk is sent in its own packet
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			cl->download.next_offset += read;
-		} while (
-			(double)(cl->reliable_bps + cl->unreliable_bps) * TICRATE
-			/ (double)(gametic % TICRATE)	// bps already used
-			+ (double)chunk_size / TICRATE 	// bps this chunk will use
-			< (double)download_rate);
-	}
-}
-
-//
-// SV_WadDownloads
-//
-void SV_WadDownloads (void)
-{
-	if (sv_download_test)
-		SV_OptimizedDownloadTest();
-	else
-		SV_DownloadOriginal();
-}
-
 //
 //	SV_WinningTeam					[Toke - teams]
 //
@@ -4630,8 +4496,11 @@ void SV_StepTics(QWORD count)
 		G_Ticker();
 
 		SV_WriteCommands();
+		SV_RetransmitPackets();
 		SV_SendPackets();
+		SV_NetDemoTicker();
 		SV_ClearClientsBPS();
+		SV_NetStatsTicker();
 		SV_CheckTimeouts();
 		SV_DestroyFinishedMovingSectors();
 
@@ -5068,12 +4937,7 @@ void SV_SendDamageMobj(AActor *target, int pain)
 		MSG_WriteLong (&cl->netbuf, target->y);
 		MSG_WriteLong (&cl->netbuf, target->z);
 
-		MSG_WriteMarker (&cl->netbuf, svc_mobjspeedangle);
-		MSG_WriteShort(&cl->netbuf, target->netid);
-		MSG_WriteLong (&cl->netbuf, target->angle);
-		MSG_WriteLong (&cl->netbuf, target->momx);
-		MSG_WriteLong (&cl->netbuf, target->momy);
-		MSG_WriteLong (&cl->netbuf, target->momz);
+		SV_WriteMobjSpeedAngle(&cl->netbuf, target);
 	}
 }
 
@@ -5108,12 +4972,7 @@ void SV_SendKillMobj(AActor *source, AActor *target, AActor *inflictor,
 		MSG_WriteLong(&cl->reliablebuf, target->y + yoffs);
 		MSG_WriteLong(&cl->reliablebuf, target->z + zoffs);
 
-		MSG_WriteMarker (&cl->reliablebuf, svc_mobjspeedangle);
-		MSG_WriteShort(&cl->reliablebuf, target->netid);
-		MSG_WriteLong (&cl->reliablebuf, target->angle);
-		MSG_WriteLong (&cl->reliablebuf, target->momx);
-		MSG_WriteLong (&cl->reliablebuf, target->momy);
-		MSG_WriteLong (&cl->reliablebuf, target->momz);
+		SV_WriteMobjSpeedAngle(&cl->reliablebuf, target);
 
 		MSG_WriteMarker(&cl->reliablebuf, svc_killmobj);
 		if (source)
@@ -68,6 +68,8 @@ void SV_WriteCommands(void);
 void SV_ClearClientsBPS(void);
 bool SV_SendPacket(player_t &pl);
 void SV_AcknowledgePacket(player_t &player);
+void SV_RetransmitPackets();
+dtime_t SV_RetransmitTimeout(client_t *cl);
 void SV_DisplayTics();
 void SV_RunTics();
 void SV_ParseCommands(player_t &player);
@@ -0,0 +1,429 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-message-type bandwidth accounting.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "doomstat.h"
+#include "c_console.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "cmdlib.h"
+#include "g_level.h"
+#include "sv_main.h"
+#include "sv_demo.h"
+#include "sv_netstats.h"
+
+EXTERN_CVAR(sv_netstats)
+EXTERN_CVAR(sv_netstatsfile)
+EXTERN_CVAR(sv_netstatsinterval)
+
+enum netstats_channel_t
+{
+	NETSTATS_RELIABLE,
+	NETSTATS_UNRELIABLE,
+	NUM_NETSTATS_CHANNELS
+};
+
+struct netstats_counter_t
+{
+	uint64_t	messages;
+	uint64_t	bytes;
+};
+
+struct netstats_t
+{
+	netstats_counter_t	msg[NUM_NETSTATS_CHANNELS][256];
+	uint64_t			packets;
+	uint64_t			rawbytes;	// before compression
+	uint64_t			sentbytes;	// after compression
+
+	netstats_t() { clear(); }
+
+	void clear()
+	{
+		memset(msg, 0, sizeof(msg));
+		packets = rawbytes = sentbytes = 0;
+	}
+
+	uint64_t totalbytes(byte type) const
+	{
+		return msg[NETSTATS_RELIABLE][type].bytes + msg[NETSTATS_UNRELIABLE][type].bytes;
+	}
+};
+
+struct netstats_marker_t
+{
+	byte	type;
+	size_t	offset;
+};
+
+// A client buffer whose messages are being tracked
+struct netstats_buf_t
+{
+	byte							player_id;
+	netstats_channel_t				channel;
+	std::vector<netstats_marker_t>	markers;
+};
+
+typedef std::map<const buf_t*, netstats_buf_t> NetStatsBuffers;
+typedef std::map<byte, netstats_t> NetStatsClients;
+
+static NetStatsBuffers netstats_bufs;
+static NetStatsClients netstats_clients;
+static netstats_t netstats_map;			// all clients, current map
+static std::string netstats_mapname;
+static int netstats_lastdump = 0;
+
+static std::string SV_NetStatsName(byte type)
+{
+	if (type < svc_max && svc_info[type].msgName)
+		return svc_info[type].msgName;
+
+	char str[16];
+	sprintf(str, "svc_%d", (int)type);
+	return str;
+}
+
+static double SV_NetStatsRatio(const netstats_t &stats)
+{
+	if (stats.rawbytes == 0)
+		return 1.0;
+	return (double)stats.sentbytes / (double)stats.rawbytes;
+}
+
+void SV_NetStatsRegisterClient(player_t &player)
+{
+	netstats_buf_t rel, unrel;
+
+	rel.player_id = unrel.player_id = player.id;
+	rel.channel = NETSTATS_RELIABLE;
+	unrel.channel = NETSTATS_UNRELIABLE;
+
+	netstats_bufs[&player.client.reliablebuf] = rel;
+	netstats_bufs[&player.client.netbuf] = unrel;
+	netstats_clients[player.id].clear();
+}
+
+void SV_NetStatsUnregisterClient(player_t &player)
+{
+	netstats_bufs.erase(&player.client.reliablebuf);
+	netstats_bufs.erase(&player.client.netbuf);
+	netstats_clients.erase(player.id);
+}
+
+//
+// SV_NetStatsMarker
+//
+// Remember where a message of the given type starts.  Buffers that do not
+// belong to a client (such as temporary buffers) are ignored.  The netdemo
+// recorder uses the same markers to split packets into messages.
+//
+void SV_NetStatsMarker(buf_t *buf, svc_t type)
+{
+	if (!sv_netstats && !SV_NetDemoRecording())
+		return;
+
+	NetStatsBuffers::iterator it = netstats_bufs.find(buf);
+	if (it == netstats_bufs.end())
+		return;
+
+	std::vector<netstats_marker_t> &markers = it->second.markers;
+
+	// the buffer was cleared without being sent
+	if (!markers.empty() && buf->cursize < markers.back().offset)
+		markers.clear();
+
+	netstats_marker_t marker;
+	marker.type = (byte)type;
+	marker.offset = buf->cursize;
+	markers.push_back(marker);
+}
+
+void SV_NetStatsMarkers(const buf_t *buf, std::vector<size_t> &offsets)
+{
+	NetStatsBuffers::const_iterator it = netstats_bufs.find(buf);
+	if (it == netstats_bufs.end())
+		return;
+
+	const std::vector<netstats_marker_t> &markers = it->second.markers;
+	for (size_t i = 0; i < markers.size(); i++)
+		offsets.push_back(markers[i].offset);
+}
+
+void SV_NetStatsFlush(buf_t *buf)
+{
+	NetStatsBuffers::iterator it = netstats_bufs.find(buf);
+	if (it == netstats_bufs.end())
+		return;
+
+	std::vector<netstats_marker_t> &markers = it->second.markers;
+
+	if (sv_netstats && !markers.empty())
+	{
+		netstats_t &client = netstats_clients[it->second.player_id];
+		netstats_channel_t channel = it->second.channel;
+
+		for (size_t i = 0; i < markers.size(); i++)
+		{
+			size_t start = markers[i].offset;
+			size_t end = (i + 1 < markers.size()) ? markers[i + 1].offset : buf->cursize;
+
+			if (start > end || end > buf->cursize)
+				break;
+
+			netstats_counter_t &cc = client.msg[channel][markers[i].type];
+			netstats_counter_t &mc = netstats_map.msg[channel][markers[i].type];
+			cc.messages++;
+			cc.bytes += end - start;
+			mc.messages++;
+			mc.bytes += end - start;
+		}
+	}
+
+	markers.clear();
+}
+
+void SV_NetStatsDiscard(buf_t *buf)
+{
+	NetStatsBuffers::iterator it = netstats_bufs.find(buf);
+	if (it != netstats_bufs.end())
+		it->second.markers.clear();
+}
+
+void SV_NetStatsPacket(player_t &player, size_t rawsize, size_t sentsize)
+{
+	if (!sv_netstats)
+		return;
+
+	netstats_t &client = netstats_clients[player.id];
+
+	client.packets++;
+	client.rawbytes += rawsize;
+	client.sentbytes += sentsize;
+
+	netstats_map.packets++;
+	netstats_map.rawbytes += rawsize;
+	netstats_map.sentbytes += sentsize;
+}
+
+void SV_NetStatsReset()
+{
+	netstats_map.clear();
+
+	for (NetStatsClients::iterator it = netstats_clients.begin();
+		 it != netstats_clients.end(); ++it)
+		it->second.clear();
+
+	for (NetStatsBuffers::iterator it = netstats_bufs.begin();
+		 it != netstats_bufs.end(); ++it)
+		it->second.markers.clear();
+
+	netstats_lastdump = gametic;
+}
+
+static void SV_NetStatsJSON(Json::Value &json, const netstats_t &stats)
+{
+	static const char *channels[NUM_NETSTATS_CHANNELS] = { "reliable", "unreliable" };
+
+	json["packets"] = Json::Value((Json::UInt64)stats.packets);
+	json["rawbytes"] = Json::Value((Json::UInt64)stats.rawbytes);
+	json["sentbytes"] = Json::Value((Json::UInt64)stats.sentbytes);
+	json["ratio"] = SV_NetStatsRatio(stats);
+
+	Json::Value &messages = json["messages"] = Json::Value(Json::objectValue);
+
+	for (int type = 0; type < 256; type++)
+	{
+		if (stats.totalbytes(type) == 0)
+			continue;
+
+		Json::Value &msg = messages[SV_NetStatsName(type)];
+		for (int ch = 0; ch < NUM_NETSTATS_CHANNELS; ch++)
+		{
+			msg[channels[ch]]["count"] = Json::Value((Json::UInt64)stats.msg[ch][type].messages);
+			msg[channels[ch]]["bytes"] = Json::Value((Json::UInt64)stats.msg[ch][type].bytes);
+		}
+	}
+}
+
+static bool SV_NetStatsDump(const std::string &filename)
+{
+	Json::Value json(Json::objectValue);
+
+	json["map"] = netstats_mapname;
+	json["gametic"] = gametic;
+	SV_NetStatsJSON(json["total"], netstats_map);
+
+	Json::Value &clients = json["clients"] = Json::Value(Json::arrayValue);
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		NetStatsClients::const_iterator stats = netstats_clients.find(it->id);
+		if (stats == netstats_clients.end())
+			continue;
+
+		Json::Value client(Json::objectValue);
+		client["id"] = it->id;
+		client["name"] = it->userinfo.netname;
+		SV_NetStatsJSON(client, stats->second);
+		clients.append(client);
+	}
+
+	// "%m" in the filename is replaced by the name of the map
+	std::string path = filename;
+	size_t pos = path.find("%m");
+	if (pos != std::string::npos)
+		path.replace(pos, 2, netstats_mapname);
+
+	return M_WriteJSON(path.c_str(), json, true);
+}
+
+//
+// SV_NetStatsTicker
+//
+// Dumps the statistics every sv_netstatsinterval seconds and starts over
+// whenever the map changes, so every dump describes one map.
+//
+void SV_NetStatsTicker()
+{
+	if (!sv_netstats)
+		return;
+
+	const std::string filename = sv_netstatsfile.str();
+
+	if (netstats_mapname != level.mapname)
+	{
+		if (!netstats_mapname.empty() && !filename.empty())
+			SV_NetStatsDump(filename);
+
+		SV_NetStatsReset();
+		netstats_mapname = level.mapname;
+	}
+
+	if (!filename.empty() &&
+		gametic - netstats_lastdump >= sv_netstatsinterval.asInt() * TICRATE)
+	{
+		if (!SV_NetStatsDump(filename))
+			Printf(PRINT_HIGH, "netstats: could not write %s.\n", filename.c_str());
+		netstats_lastdump = gametic;
+	}
+}
+
+static bool SV_NetStatsCompare(const std::pair<byte, uint64_t> &a,
+							   const std::pair<byte, uint64_t> &b)
+{
+	return a.second > b.second;
+}
+
+static void SV_NetStatsPrint(const netstats_t &stats)
+{
+	std::vector<std::pair<byte, uint64_t> > sorted;
+	uint64_t total = 0;
+
+	for (int type = 0; type < 256; type++)
+	{
+		uint64_t bytes = stats.totalbytes(type);
+		if (bytes == 0)
+			continue;
+
+		sorted.push_back(std::make_pair((byte)type, bytes));
+		total += bytes;
+	}
+
+	std::sort(sorted.begin(), sorted.end(), SV_NetStatsCompare);
+
+	Printf(PRINT_HIGH, "%-24s %10s %12s %10s %12s %6s\n",
+		   "message", "rel msgs", "rel bytes", "unrel msgs", "unrel bytes", "share");
+
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		byte type = sorted[i].first;
+		const netstats_counter_t &rel = stats.msg[NETSTATS_RELIABLE][type];
+		const netstats_counter_t &unrel = stats.msg[NETSTATS_UNRELIABLE][type];
+
+		Printf(PRINT_HIGH, "%-24s %10llu %12llu %10llu %12llu %5.1f%%\n",
+			   SV_NetStatsName(type).c_str(),
+			   (unsigned long long)rel.messages, (unsigned long long)rel.bytes,
+			   (unsigned long long)unrel.messages, (unsigned long long)unrel.bytes,
+			   100.0 * (double)sorted[i].second / (double)total);
+	}
+
+	Printf(PRINT_HIGH, "%llu packets, %llu bytes before compression, %llu sent (%.1f%%)\n",
+		   (unsigned long long)stats.packets, (unsigned long long)stats.rawbytes,
+		   (unsigned long long)stats.sentbytes, 100.0 * SV_NetStatsRatio(stats));
+}
+
+BEGIN_COMMAND (netstats)
+{
+	std::vector<std::string> arguments = VectorArgs(argc, argv);
+
+	if (!sv_netstats)
+	{
+		Printf(PRINT_HIGH, "netstats: set sv_netstats to 1 to collect statistics.\n");
+		return;
+	}
+
+	if (arguments.empty())
+	{
+		Printf(PRINT_HIGH, "Bandwidth by message type on %s:\n", netstats_mapname.c_str());
+		SV_NetStatsPrint(netstats_map);
+		return;
+	}
+
+	if (arguments[0] == "reset")
+	{
+		SV_NetStatsReset();
+		Printf(PRINT_HIGH, "netstats: statistics reset.\n");
+		return;
+	}
+
+	if (arguments[0] == "dump")
+	{
+		std::string filename = arguments.size() > 1 ? arguments[1] : sv_netstatsfile.str();
+		if (filename.empty())
+		{
+			Printf(PRINT_HIGH, "Usage: netstats dump <filename>\n");
+			return;
+		}
+
+		if (!SV_NetStatsDump(filename))
+			Printf(PRINT_HIGH, "netstats: could not write %s.\n", filename.c_str());
+		return;
+	}
+
+	int pid = atoi(arguments[0].c_str());
+	NetStatsClients::const_iterator it = netstats_clients.find(pid);
+	if (pid <= 0 || pid >= MAXPLAYERS || it == netstats_clients.end())
+	{
+		Printf(PRINT_HIGH, "Usage: netstats [player id | reset | dump <filename>]\n");
+		return;
+	}
+
+	Printf(PRINT_HIGH, "Bandwidth by message type for %s:\n",
+		   idplayer(pid).userinfo.netname.c_str());
+	SV_NetStatsPrint(it->second);
+}
+END_COMMAND (netstats)
+
+VERSION_CONTROL (sv_netstats_cpp, "$Id$")
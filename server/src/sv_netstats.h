@@ -0,0 +1,60 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-message-type bandwidth accounting.
+//
+//	MSG_WriteMarker records where each svc message starts in a client's
+//	reliable or unreliable buffer.  When SV_SendPacket flushes the buffers,
+//	the distance between markers is charged to the message type, giving
+//	the number of bytes and messages of every svc type sent to every
+//	client, along with the compression ratio of the packets themselves.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __SV_NETSTATS_H__
+#define __SV_NETSTATS_H__
+
+#include <vector>
+
+#include "d_player.h"
+#include "i_net.h"
+
+void SV_NetStatsRegisterClient(player_t &player);
+void SV_NetStatsUnregisterClient(player_t &player);
+
+// Called by MSG_WriteMarker before the marker byte is written.
+void SV_NetStatsMarker(buf_t *buf, svc_t type);
+
+// Adds the offsets of the messages marked in buf so far.
+void SV_NetStatsMarkers(const buf_t *buf, std::vector<size_t> &offsets);
+
+// Charge every message marked in buf to its client, or forget them if the
+// buffer is being thrown away.
+void SV_NetStatsFlush(buf_t *buf);
+void SV_NetStatsDiscard(buf_t *buf);
+
+// Record a packet that was rawsize bytes before compression.
+void SV_NetStatsPacket(player_t &player, size_t rawsize, size_t sentsize);
+
+// Called once per tic to handle periodic dumps and map changes.
+void SV_NetStatsTicker();
+
+void SV_NetStatsReset();
+
+#endif	// __SV_NETSTATS_H__
@@ -27,6 +27,8 @@
 #include "doomstat.h"
 #include "p_local.h"
 #include "sv_main.h"
+#include "sv_netstats.h"
+#include "sv_demo.h"
 #include "huffman.h"
 #include "i_net.h"
 
@@ -35,9 +37,10 @@
 #include <chrono>
 #endif
 
-QWORD I_MSTime (void);
+dtime_t I_MSTime (void);
 
 EXTERN_CVAR (log_packetdebug)
+EXTERN_CVAR (sv_statichuffman)
 #ifdef SIMULATE_LATENCY
 EXTERN_CVAR (sv_latency)
 #endif
@@ -53,6 +56,10 @@ buf_t sendd(MAX_UDP_PACKET);
 // if 0'd sections
 void SV_CompressPacket(buf_t &send, unsigned int reserved, client_t *cl)
 {
+	byte method = 0;
+
+	int need_gap = 2; // for svc_compressed and method, below
+#if 0
 	if(plain.maxsize() < send.maxsize())
 		plain.resize(send.maxsize());
 	
@@ -60,10 +67,6 @@ void SV_CompressPacket(buf_t &send, unsigned int reserved, client_t *cl)
 	
 	memcpy(plain.ptr(), send.ptr(), send.size());
 
-	byte method = 0;
-
-	int need_gap = 2; // for svc_compressed and method, below
-#if 0
 	if(MSG_CompressAdaptive(cl->compressor.get_codec(), send, reserved, need_gap))
 	{
 		reserved += need_gap;
@@ -79,8 +82,10 @@ void SV_CompressPacket(buf_t &send, unsigned int reserved, client_t *cl)
 
 	if(MSG_CompressMinilzo(send, reserved, need_gap))
 		method |= minilzo_mask;
+	else if(sv_statichuffman && MSG_CompressStatic(send, reserved, need_gap))
+		method |= static_huffman_mask;
 
-	if((method & adaptive_mask) || (method & minilzo_mask))
+	if((method & adaptive_mask) || (method & minilzo_mask) || (method & static_huffman_mask))
 	{
 #if 0
 		if(cl->compressor.packet_sent(cl->sequence - 1, plain.ptr() + sizeof(int), plain.size() - sizeof(int)))
@@ -153,6 +158,8 @@ bool SV_SendPacket(player_t &pl)
 
 	if (cl->reliablebuf.overflowed)
 	{ 
+		SV_NetStatsDiscard(&cl->netbuf);
+		SV_NetStatsDiscard(&cl->reliablebuf);
 		SZ_Clear(&cl->netbuf);
 		SZ_Clear(&cl->reliablebuf);
 	    SV_DropClient(pl);
@@ -160,135 +167,258 @@ bool SV_SendPacket(player_t &pl)
 	}
 	else
 		if (cl->netbuf.overflowed)
+		{
+			SV_NetStatsDiscard(&cl->netbuf);
 			SZ_Clear(&cl->netbuf);
+		}
+
+	// The retransmit slot this packet would use still holds reliable data
+	// the client hasn't acknowledged after NUM_SLOTS packets.  Hold the
+	// reliable messages back for a later packet rather than lose that data.
+	size_t relsize = cl->reliablebuf.cursize;
+	if (relsize && cl->relstore.busy(cl->sequence))
+		relsize = 0;
 
 	// [SL] 2012-05-04 - Don't send empty packets - they still have overhead
-	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0)
+	if (relsize + cl->netbuf.cursize == 0)
 		return true;
 
-	sendd.clear();
+	// add the unreliable part if space is available and rate value
+	// allows it
+	if (gametic % 35)
+	    bps = (int)((double)( (cl->unreliable_bps + cl->reliable_bps) * TICRATE)/(double)(gametic%35));
 
-	// save the reliable message 
-	// it will be retransmited, if it's missed
+	bool unreliable = cl->netbuf.cursize && bps < cl->rate*1000 &&
+		sizeof(int) + relsize + cl->netbuf.cursize < MAX_UDP_PACKET;
 
-	// the end of the buffer is reached
-	if (cl->relpackets.cursize + cl->reliablebuf.cursize >= cl->relpackets.maxsize())
-		cl->relpackets.cursize = 0;
+	if (relsize + (unreliable ? cl->netbuf.cursize : 0) == 0)
+		return true;
 
-	// copy the beginning and the size of a packet to the buffer
-	cl->packetbegin[cl->packetnum] = cl->relpackets.cursize;
-	cl->packetsize[cl->packetnum] = cl->reliablebuf.cursize;
-	cl->packetseq[cl->packetnum] = cl->sequence;
+	SV_NetDemoCapture(pl, relsize ? &cl->reliablebuf : NULL, unreliable ? &cl->netbuf : NULL);
 
-	if (cl->reliablebuf.cursize)
-		SZ_Write (&cl->relpackets, cl->reliablebuf.data, cl->reliablebuf.cursize);
+	size_t rawsize = sizeof(int) + relsize;
+	if (unreliable)
+		rawsize += cl->netbuf.cursize;
 
+	int sequence = cl->sequence++;
 
-	cl->packetnum++; // packetnum will never be more than 255
-	                 // because sizeof(packetnum) == 1. Don't need
-	                 // to use &0xff. Cool, eh? ;-)
-	// copy sequence
-	MSG_WriteLong(&sendd, cl->sequence++);
-    
-	// copy the reliable message to the packet first
-    if (cl->reliablebuf.cursize)
-    {
-		SZ_Write (&sendd, cl->reliablebuf.data, cl->reliablebuf.cursize);
-		cl->reliable_bps += cl->reliablebuf.cursize;
-    }
+	byte header[sizeof(int)];
+	header[0] = sequence & 0xff;
+	header[1] = (sequence >> 8) & 0xff;
+	header[2] = (sequence >> 16) & 0xff;
+	header[3] = sequence >> 24;
 
-	// add the unreliable part if space is available and rate value
-	// allows it
-	if (gametic % 35)
-	    bps = (int)((double)( (cl->unreliable_bps + cl->reliable_bps) * TICRATE)/(double)(gametic%35));
+	if (relsize)
+	{
+		cl->reliable_bps += relsize;
+		SV_NetStatsFlush(&cl->reliablebuf);
+	}
 
-    if (bps < cl->rate*1000)
+	if (unreliable)
+	{
+		cl->unreliable_bps += cl->netbuf.cursize;
+		SV_NetStatsFlush(&cl->netbuf);
+	}
 
-	  if (cl->netbuf.cursize && (sendd.maxsize() - sendd.cursize > cl->netbuf.cursize) )
-	  {
-         SZ_Write (&sendd, cl->netbuf.data, cl->netbuf.cursize);
-	     cl->unreliable_bps += cl->netbuf.cursize;
-	  }
-    
-	SZ_Clear(&cl->netbuf);
-	SZ_Clear(&cl->reliablebuf);
-	
-	// compress the packet, but not the sequence id
-	if (sendd.size() > sizeof(int))
-		SV_CompressPacket(sendd, sizeof(int), cl);
+	size_t sentsize = rawsize;
 
-	if (log_packetdebug)
+#ifndef SIMULATE_LATENCY
+	// Packets that won't be compressed go out straight from the client's
+	// buffers, everything else has to be assembled for the compressor.
+	if (rawsize < MINILZO_COMPRESS_MINPACKETSIZE && !sv_statichuffman)
 	{
-		Printf(PRINT_HIGH, "ply %03u, pkt %06u, size %04u, tic %07u, time %011u\n",
-			   pl.id, cl->sequence - 1, sendd.cursize, gametic, I_MSTime());
+		net_iovec_t iov[3];
+		size_t count = 0;
+
+		iov[count].data = header;
+		iov[count++].size = sizeof(header);
+
+		if (relsize)
+		{
+			iov[count].data = cl->reliablebuf.data;
+			iov[count++].size = relsize;
+		}
+
+		if (unreliable)
+		{
+			iov[count].data = cl->netbuf.data;
+			iov[count++].size = cl->netbuf.cursize;
+		}
+
+		NET_SendPacketv(iov, count, cl->address);
 	}
+	else
+#endif
+	{
+		sendd.clear();
+		SZ_Write(&sendd, header, sizeof(header));
+		if (relsize)
+			SZ_Write(&sendd, cl->reliablebuf.data, relsize);
+		if (unreliable)
+			SZ_Write(&sendd, cl->netbuf.data, cl->netbuf.cursize);
+
+		// compress the packet, but not the sequence id
+		if (sendd.size() > sizeof(int))
+			SV_CompressPacket(sendd, sizeof(int), cl);
+
+		sentsize = sendd.size();
 
 #ifdef SIMULATE_LATENCY
-	SV_SendPacketDelayed(sendd, pl);
+		SV_SendPacketDelayed(sendd, pl);
 #else
-
-	NET_SendPacket(sendd, cl->address);
+		NET_SendPacket(sendd, cl->address);
 #endif
+	}
+
+	SV_NetStatsPacket(pl, rawsize, sentsize);
+
+	if (log_packetdebug)
+	{
+		Printf(PRINT_HIGH, "ply %03u, pkt %06u, size %04u, tic %07u, time %011u\n",
+			   pl.id, sequence, sentsize, gametic, I_MSTime());
+	}
+
+	// save the reliable message, it will be retransmitted if it's missed.
+	// The store takes the buffer over and leaves reliablebuf empty, unless
+	// the slot is busy and the reliable messages were held back.
+	cl->relstore.store(sequence, cl->reliablebuf, I_MSTime());
+
+	SV_NetStatsDiscard(&cl->netbuf);
+	SZ_Clear(&cl->netbuf);
+
 	return true;
 }
 
+// later packets that must be acknowledged before a packet counts as lost
+#define RETRANSMIT_REORDER		3
+
+// bounds of the retransmit timeout in ms
+#define RETRANSMIT_MIN_TIMEOUT	100
+#define RETRANSMIT_MAX_TIMEOUT	1000
+#define RETRANSMIT_INIT_TIMEOUT	500
+
+//
+// SV_UpdateRoundTripTime
+//
+// Smoothed round trip time and its variation, as TCP measures them.
+//
+static void SV_UpdateRoundTripTime(client_t *cl, int rtt)
+{
+	if (cl->srtt == 0)
+	{
+		cl->srtt = rtt > 0 ? rtt : 1;
+		cl->rttvar = rtt / 2;
+		return;
+	}
+
+	cl->rttvar = (3 * cl->rttvar + abs(cl->srtt - rtt)) / 4;
+	cl->srtt = (7 * cl->srtt + rtt) / 8;
+	if (cl->srtt == 0)
+		cl->srtt = 1;
+}
+
+//
+// SV_RetransmitTimeout
+//
+dtime_t SV_RetransmitTimeout(client_t *cl)
+{
+	if (cl->srtt == 0)
+		return RETRANSMIT_INIT_TIMEOUT;
+
+	int timeout = cl->srtt + 4 * cl->rttvar;
+
+	if (timeout < RETRANSMIT_MIN_TIMEOUT)
+		return RETRANSMIT_MIN_TIMEOUT;
+	if (timeout > RETRANSMIT_MAX_TIMEOUT)
+		return RETRANSMIT_MAX_TIMEOUT;
+
+	return timeout;
+}
+
 //
 // SV_AcknowledgePacket
 //
+// The client acknowledges the highest sequence it has received, followed
+// by a bitfield of which of the 32 packets before it also arrived.
+//
 void SV_AcknowledgePacket(player_t &player)
 {
 	client_t *cl = &player.client;
 
 	int sequence = MSG_ReadLong();
+	unsigned int received = MSG_ReadLong();
 
 	cl->compressor.packet_acked(sequence);
 
-	// packet is missed
-	if (sequence - cl->last_sequence > 1)
+	dtime_t now = I_MSTime();
+	dtime_t sent;
+
+	if (cl->relstore.ack(sequence, sent))
+		SV_UpdateRoundTripTime(cl, (int)(now - sent));
+
+	for (int i = 0; i < 32; i++)
 	{
-		// resend
-		for (int seq = cl->last_sequence+1; seq < sequence; seq++)
-		{
-			int  n;
-			bool needfullupdate = true;
-
-			for (n=0; n<256; n++)
-				if (cl->packetseq[n] == seq)
-				{
-					needfullupdate = false;
-					break;
-				}
-
-			if  (needfullupdate)
-			{
-				// do full update
-				DPrintf("need full update\n");
-				cl->last_sequence = sequence;
-				return;
-			}
-
-			MSG_WriteMarker(&cl->reliablebuf, svc_missedpacket);
-			MSG_WriteLong(&cl->reliablebuf, seq);
-			MSG_WriteShort(&cl->reliablebuf, cl->packetsize[n]);
-			if (cl->packetsize[n])
-				SZ_Write (&cl->reliablebuf, cl->relpackets.data, 
-					cl->packetbegin[n], cl->packetsize[n]);
-
-			if (cl->reliablebuf.overflowed)
-			{
-				// do full update
-				DPrintf("reliablebuf overflowed, need full update\n");
-				cl->last_sequence = sequence;
-				return;
-			}
-
-			if (cl->reliablebuf.cursize > 600)
-				SV_SendPacket(player);
+		if ((received & (1u << i)) && cl->relstore.ack(sequence - 1 - i, sent))
+			SV_UpdateRoundTripTime(cl, (int)(now - sent));
+	}
+
+	if (sequence > cl->last_sequence)
+		cl->last_sequence = sequence;
+}
+
+//
+// SV_RetransmitLost
+//
+// Resend the reliable data of packets that are considered lost, either
+// because packets sent after them have been acknowledged or because no
+// acknowledgement came back within the retransmit timeout.  Resends are
+// spread out to about one packet per tic instead of all at once.
+//
+static void SV_RetransmitLost(player_t &player, dtime_t now)
+{
+	client_t *cl = &player.client;
+	dtime_t timeout = SV_RetransmitTimeout(cl);
+
+	int seq;
+	dtime_t sent;
 
+	while (cl->reliablebuf.cursize <= 600 && cl->relstore.oldest(seq, sent))
+	{
+		if (seq > cl->last_sequence - RETRANSMIT_REORDER && now - sent < timeout)
+			break;
+
+		const byte *data;
+		size_t size;
+
+		cl->relstore.find(seq, data, size);
+
+		MSG_WriteMarker(&cl->reliablebuf, svc_missedpacket);
+		MSG_WriteLong(&cl->reliablebuf, seq);
+		MSG_WriteShort(&cl->reliablebuf, size);
+		if (size)
+			SZ_Write (&cl->reliablebuf, data, size);
+
+		// the packet carrying the copy is the one to wait for now
+		cl->relstore.forget(seq);
+
+		if (cl->reliablebuf.overflowed)
+		{
+			// do full update
+			DPrintf("reliablebuf overflowed, need full update\n");
+			return;
 		}
 	}
+}
+
+//
+// SV_RetransmitPackets
+//
+void SV_RetransmitPackets()
+{
+	dtime_t now = I_MSTime();
 
-	cl->last_sequence = sequence;
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+		SV_RetransmitLost(*it, now);
 }
 
 VERSION_CONTROL (sv_rproto_cpp, "$Id$")
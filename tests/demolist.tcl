@@ -9,11 +9,44 @@ exec tclsh "$0" "$@"
 # assumes file input format:
 # DOOM2.WAD {PWAD.WAD DEH.DEH ...} DEMOLUMP.LMP {15eb4720 3ccc7a1 3fc7e27 800000}
 #
+# any arguments are passed on to odamex, and each demo is then played a
+# second time without them to check that the sector light levels come out
+# the same, e.g. to run light thinkers on worker threads:
+# tests/demolist.tcl +set thinkerthreads 4 +set thinkerthreadsminlights 1
+#
 # produces output format like:
 # DOOM2.WAD DEMO1 [PASS]
 # DOOM2.WAD TEST.LMP [FAIL]
 #
 
+proc rundemo { cmdline } {
+	set demotest "CRASHED"
+	set lights "CRASHED"
+	catch {
+		if [file exists odamex.exe] {
+			eval exec odamex.exe [split $cmdline] > tmp
+		} elseif [file exists ./odamex] {
+			eval exec ./odamex [split $cmdline] > tmp
+		} else {
+			eval exec ./build/client/odamex [split $cmdline] > tmp
+		}
+		set log [open odamex.log r]
+		while { ![eof $log] } {
+			set line [gets $log]
+			if { [string range $line 0 8] == "demotest:" } {
+				set demotest [string range $line 9 end]
+			}
+			if { [string range $line 0 15] == "demotest lights:" } {
+				set lights [string range $line 16 end]
+			}
+		}
+		close $log
+	}
+	return [list $demotest $lights]
+}
+
+set extra [join $argv " "]
+
 set file [open tests/DEMOLIST r]
 
 while { ![eof $file] } {
@@ -57,28 +90,20 @@ while { ![eof $file] } {
 	}
 	append args " +logfile odamex.log"
 
-	set demotest "CRASHED"
-	catch {
-		if [file exists odamex.exe] {
-			eval exec odamex.exe [split $args] > tmp
-		} elseif [file exists ./odamex] {
-			eval exec ./odamex [split $args] > tmp
-		} else {
-			eval exec ./build/client/odamex [split $args] > tmp
-		}
-		set log [open odamex.log r]
-		while { ![eof $log] } {
-			set line [gets $log]
-			if { [string range $line 0 8] == "demotest:" } {
-				set demotest [string range $line 9 end]
-			}
-		}
-		close $log
-	}
+	set run [rundemo "$args $extra"]
+	set demotest [lindex $run 0]
 
 	set result [lindex [split $demotest "\n"] end]
 	set expected [lindex $demo 3]
 
+	if { $extra != "" } {
+		set lights [lindex $run 1]
+		set serial [lindex [rundemo $args] 1]
+		if { $lights != $serial } {
+			set result "$result | lights $lights != $serial"
+		}
+	}
+
 	if { $result != $expected} {
 		puts "FAIL $demo | $result"
 	} else {
@@ -0,0 +1,456 @@
+//
+// hufftrain - Train and benchmark the static huffman packet model
+//
+// Reads the packets captured in netdemos (.odd) and either writes a new
+// common/huffman_model.cpp from their byte frequencies, or compares the
+// static huffman codec against minilzo on them.
+//
+//   hufftrain [-o huffman_model.cpp] demo.odd ...
+//   hufftrain -bench [-model huffman_model.cpp] demo.odd ...
+//
+// Train and benchmark on different sets of demos, otherwise the results
+// will flatter the model.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "version.h"
+#include "huffman.h"
+#include "minilzo.h"
+
+// huffman.cpp registers itself with the version command of the game
+file_version::file_version(const char *uid, const char *id, const char *p, int l, const char *t, const char *d) {}
+
+// netdemo layout, see client/src/cl_demo.h
+static const size_t NETDEMO_HEADER_SIZE = 64;
+static const size_t NETDEMO_MESSAGE_HEADER_SIZE = 9;
+static const unsigned char NETDEMO_MSG_PACKET = 0xAA;
+static const unsigned char NETDEMO_COMP_NONE = 0;
+static const unsigned char NETDEMO_COMP_LZO = 1;
+
+// The server flushes a client's buffers once they pass 600 bytes, and a
+// netdemo chunk holds every packet of a tic back to back.  Slicing chunks
+// at this size is a reasonable stand-in for the original packets.
+static const size_t PACKET_SLICE = 600;
+
+// must match MINILZO_COMPRESS_MINPACKETSIZE in common/i_net.h
+static const size_t MINILZO_MINPACKETSIZE = 0xFF;
+
+typedef std::vector<unsigned char> packet_t;
+
+static unsigned int ReadLE32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+//
+// DecompressDemo
+//
+// Rebuild the uncompressed layout of a compressed netdemo from its blocks,
+// see NetDemo::loadBlock.
+//
+static bool DecompressDemo(const packet_t &file, packet_t &data)
+{
+	unsigned int block_size = ReadLE32(&file[28]);
+	unsigned int block_count = ReadLE32(&file[32]);
+	unsigned int table = ReadLE32(&file[36]);
+
+	if (block_size == 0 || table > file.size() || block_count > (file.size() - table) / 4)
+		return false;
+
+	// the blocks pick up right after the header
+	data.assign(file.begin(), file.begin() + NETDEMO_HEADER_SIZE);
+
+	for (unsigned int i = 0; i < block_count; i++)
+	{
+		unsigned int offset = ReadLE32(&file[table + i * 4]);
+		if (offset > file.size() || file.size() - offset < 8)
+			return false;
+
+		unsigned int packed_len = ReadLE32(&file[offset]);
+		unsigned int raw_len = ReadLE32(&file[offset + 4]);
+		offset += 8;
+
+		if (raw_len > block_size || packed_len > raw_len ||
+			file.size() - offset < (packed_len ? packed_len : raw_len))
+			return false;
+
+		if (raw_len == 0)
+			continue;
+
+		size_t start = data.size();
+		data.resize(start + raw_len);
+
+		if (packed_len == 0)
+		{
+			memcpy(&data[start], &file[offset], raw_len);
+		}
+		else
+		{
+			lzo_uint outlen = raw_len;
+			if (lzo1x_decompress_safe(&file[offset], packed_len, &data[start], &outlen, NULL) != LZO_E_OK ||
+				outlen != raw_len)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//
+// ReadDemoPackets
+//
+// Append the packets of every msg_packet chunk of a netdemo to packets.
+//
+static bool ReadDemoPackets(const char *filename, std::vector<packet_t> &packets)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "%s: could not open file\n", filename);
+		return false;
+	}
+
+	packet_t file;
+	unsigned char buf[65536];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+		file.insert(file.end(), buf, buf + len);
+	fclose(fp);
+
+	if (file.size() < NETDEMO_HEADER_SIZE || memcmp(&file[0], "ODAD", 4) != 0)
+	{
+		fprintf(stderr, "%s: not an Odamex netdemo\n", filename);
+		return false;
+	}
+
+	if (file[4] > NETDEMOVER)
+	{
+		fprintf(stderr, "%s: netdemo version %d is newer than this tool\n", filename, file[4]);
+		return false;
+	}
+
+	packet_t data;
+	if (file[5] == NETDEMO_COMP_NONE)
+	{
+		data.swap(file);
+	}
+	else if (file[5] != NETDEMO_COMP_LZO)
+	{
+		fprintf(stderr, "%s: unknown netdemo compression %d\n", filename, file[5]);
+		return false;
+	}
+	else if (!DecompressDemo(file, data))
+	{
+		fprintf(stderr, "%s: could not decompress netdemo\n", filename);
+		return false;
+	}
+
+	// the snapshot index follows the last message
+	size_t end = ReadLE32(&data[8]);
+	if (end == 0 || end > data.size())
+		end = data.size();
+
+	size_t pos = NETDEMO_HEADER_SIZE;
+	while (end - pos >= NETDEMO_MESSAGE_HEADER_SIZE)
+	{
+		unsigned char type = data[pos];
+		size_t chunklen = ReadLE32(&data[pos + 1]);
+		pos += NETDEMO_MESSAGE_HEADER_SIZE;
+
+		if (chunklen > end - pos)
+			break;
+
+		if (type == NETDEMO_MSG_PACKET)
+		{
+			for (size_t slice = 0; slice < chunklen; slice += PACKET_SLICE)
+			{
+				size_t slicelen = chunklen - slice < PACKET_SLICE ? chunklen - slice : PACKET_SLICE;
+				packets.push_back(packet_t(data.begin() + pos + slice,
+										   data.begin() + pos + slice + slicelen));
+			}
+		}
+
+		pos += chunklen;
+	}
+
+	return true;
+}
+
+//
+// ReadModel
+//
+// Read the 256 counts back out of a generated huffman_model.cpp.
+//
+static bool ReadModel(const char *filename, unsigned int *counts)
+{
+	FILE *fp = fopen(filename, "r");
+	if (!fp)
+		return false;
+
+	int c;
+	while ((c = fgetc(fp)) != EOF && c != '{')
+		;
+
+	int n = 0;
+	while (n < 256 && fscanf(fp, " %u ,", &counts[n]) == 1)
+		n++;
+
+	fclose(fp);
+	return n == 256;
+}
+
+static bool WriteModel(const char *filename, const unsigned int *counts, size_t numpackets)
+{
+	FILE *fp = fopen(filename, "w");
+	if (!fp)
+		return false;
+
+	fprintf(fp, "// Emacs style mode select   -*- C++ -*-\n");
+	fprintf(fp, "//-----------------------------------------------------------------------------\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// $Id$\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// Copyright (C) 2006-2015 by The Odamex Team.\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// This program is free software; you can redistribute it and/or\n");
+	fprintf(fp, "// modify it under the terms of the GNU General Public License\n");
+	fprintf(fp, "// as published by the Free Software Foundation; either version 2\n");
+	fprintf(fp, "// of the License, or (at your option) any later version.\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// This program is distributed in the hope that it will be useful,\n");
+	fprintf(fp, "// but WITHOUT ANY WARRANTY; without even the implied warranty of\n");
+	fprintf(fp, "// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the\n");
+	fprintf(fp, "// GNU General Public License for more details.\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// DESCRIPTION:\n");
+	fprintf(fp, "//	Static huffman model for packet compression.\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "//	Generated by tools/hufftrain from %lu packets.  Changing it breaks\n",
+			(unsigned long)numpackets);
+	fprintf(fp, "//	compatibility with clients built against a different model.\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "//-----------------------------------------------------------------------------\n");
+	fprintf(fp, "\n#include \"huffman.h\"\n\n");
+	fprintf(fp, "const unsigned int huffman_static_model[256] =\n{\n");
+
+	for (int i = 0; i < 256; i += 8)
+	{
+		fprintf(fp, "\t");
+		for (int j = i; j < i + 8; j++)
+			fprintf(fp, "%u,%s", counts[j], j < i + 7 ? " " : "\n");
+	}
+
+	fprintf(fp, "};\n");
+	fclose(fp);
+
+	return true;
+}
+
+static int Train(const std::vector<packet_t> &packets, const char *output)
+{
+	unsigned int counts[256];
+	unsigned long long total[256];
+	unsigned long long sum = 0;
+
+	memset(total, 0, sizeof(total));
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		for (size_t j = 0; j < packets[i].size(); j++)
+			total[packets[i][j]]++;
+		sum += packets[i].size();
+	}
+
+	// scale into the range huffman::set_model keeps anyway, so the
+	// generated table reads the same as the model in use
+	unsigned long long divisor = 1;
+	while (sum / divisor > 65000)
+		divisor *= 2;
+
+	for (int i = 0; i < 256; i++)
+	{
+		counts[i] = (unsigned int)(total[i] / divisor);
+		if (counts[i] == 0)
+			counts[i] = 1;
+	}
+
+	if (!WriteModel(output, counts, packets.size()))
+	{
+		fprintf(stderr, "%s: could not write model\n", output);
+		return 1;
+	}
+
+	printf("Trained on %lu packets (%llu bytes), wrote %s\n",
+		   (unsigned long)packets.size(), sum, output);
+	return 0;
+}
+
+struct bench_result_t
+{
+	const char			*name;
+	unsigned long long	bytes;
+	clock_t				ticks;
+};
+
+static void PrintResult(const bench_result_t &r, unsigned long long raw, size_t numpackets)
+{
+	printf("%-16s %12llu bytes  %6.1f%%  %8.3f us/packet\n", r.name, r.bytes,
+		   raw ? 100.0 * (double)r.bytes / (double)raw : 100.0,
+		   numpackets ? 1000000.0 * (double)r.ticks / CLOCKS_PER_SEC / numpackets : 0.0);
+}
+
+static int Bench(const std::vector<packet_t> &packets, huffman &codec)
+{
+	static lzo_align_t wrkmem[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+	std::vector<unsigned char> in, out, check;
+	unsigned long long raw = 0;
+
+	bench_result_t lzo = { "minilzo", 0, 0 };
+	bench_result_t huff = { "static huffman", 0, 0 };
+	bench_result_t unhuff = { "  (decompress)", 0, 0 };
+	bench_result_t both = { "lzo, else huff", 0, 0 };
+
+	if (lzo_init() != LZO_E_OK)
+	{
+		fprintf(stderr, "lzo_init failed\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		size_t len = packets[i].size();
+		if (len == 0)
+			continue;
+
+		in = packets[i];
+		out.resize(len * 2 + 512);
+		check.resize(len + 1);
+		raw += len;
+
+		// minilzo, only applied above the same threshold as the server
+		size_t lzolen = len;
+		if (len >= MINILZO_MINPACKETSIZE)
+		{
+			lzo_uint outlen = out.size();
+			clock_t start = clock();
+			int r = lzo1x_1_compress(&in[0], len, &out[0], &outlen, wrkmem);
+			lzo.ticks += clock() - start;
+
+			if (r == LZO_E_OK && outlen < len)
+				lzolen = outlen;
+		}
+		lzo.bytes += lzolen;
+
+		// static huffman
+		size_t hufflen = out.size();
+		clock_t start = clock();
+		bool ok = codec.compress(&in[0], len, &out[0], hufflen);
+		huff.ticks += clock() - start;
+
+		if (ok)
+		{
+			size_t checklen = check.size();
+			start = clock();
+			bool r = codec.decompress(&out[0], hufflen, &check[0], checklen);
+			unhuff.ticks += clock() - start;
+
+			if (!r || checklen != len || memcmp(&check[0], &in[0], len) != 0)
+			{
+				fprintf(stderr, "packet %lu does not survive a round trip\n", (unsigned long)i);
+				return 1;
+			}
+		}
+
+		if (!ok || hufflen >= len)
+			hufflen = len;
+		huff.bytes += hufflen;
+
+		// what SV_CompressPacket does with sv_statichuffman enabled
+		both.bytes += lzolen < len ? lzolen : hufflen;
+	}
+
+	unhuff.bytes = huff.bytes;
+	both.ticks = lzo.ticks + huff.ticks;
+
+	printf("%lu packets, %llu bytes, %.1f bytes/packet\n", (unsigned long)packets.size(),
+		   raw, packets.empty() ? 0.0 : (double)raw / packets.size());
+	PrintResult(lzo, raw, packets.size());
+	PrintResult(huff, raw, packets.size());
+	PrintResult(unhuff, raw, packets.size());
+	PrintResult(both, raw, packets.size());
+
+	return 0;
+}
+
+static void Usage()
+{
+	fprintf(stderr,
+			"Usage: hufftrain [-o huffman_model.cpp] demo.odd ...\n"
+			"       hufftrain -bench [-model huffman_model.cpp] demo.odd ...\n");
+}
+
+int main(int argc, char **argv)
+{
+	std::string output = "huffman_model.cpp";
+	const char *model = NULL;
+	bool bench = false;
+	std::vector<packet_t> packets;
+
+	// compressed netdemos are decompressed while reading them
+	if (lzo_init() != LZO_E_OK)
+	{
+		fprintf(stderr, "lzo_init failed\n");
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			output = argv[++i];
+		else if (!strcmp(argv[i], "-model") && i + 1 < argc)
+			model = argv[++i];
+		else if (!strcmp(argv[i], "-bench"))
+			bench = true;
+		else if (argv[i][0] == '-')
+		{
+			Usage();
+			return 1;
+		}
+		else
+			ReadDemoPackets(argv[i], packets);
+	}
+
+	if (packets.empty())
+	{
+		Usage();
+		return 1;
+	}
+
+	if (!bench)
+		return Train(packets, output.c_str());
+
+	huffman codec;
+	if (model)
+	{
+		unsigned int counts[256];
+		if (!ReadModel(model, counts))
+		{
+			fprintf(stderr, "%s: could not read model\n", model);
+			return 1;
+		}
+		codec.set_model(counts);
+	}
+	else
+	{
+		codec.set_model(huffman_static_model);
+	}
+
+	return Bench(packets, codec);
+}
@@ -0,0 +1,76 @@
+#!/bin/bash
+# \
+exec tclsh "$0" "$@"
+
+#
+# runs ./odamex -nosound -netdemoinfo DEMO.ODD for every netdemo given on
+# the command line, several at a time, leaving a DEMO.json summary next to
+# each netdemo
+#
+# usage: netdemoinfo.tcl [-j JOBS] [-odamex PATH] DEMO.ODD ...
+#
+# produces output format like:
+# demos/duel1.odd [PASS]
+# demos/broken.odd [FAIL]
+#
+
+set jobs 4
+set odamex ./odamex
+set demos {}
+
+for { set i 0 } { $i < [llength $argv] } { incr i } {
+	set arg [lindex $argv $i]
+	if { $arg == "-j" } {
+		set jobs [lindex $argv [incr i]]
+	} elseif { $arg == "-odamex" } {
+		set odamex [lindex $argv [incr i]]
+	} else {
+		lappend demos $arg
+	}
+}
+
+if { [llength $demos] == 0 } {
+	puts "usage: netdemoinfo.tcl \[-j JOBS\] \[-odamex PATH\] DEMO.ODD ..."
+	exit 1
+}
+
+set running 0
+set failed 0
+
+proc finish { chan demo } {
+	global running failed
+
+	if { ![eof $chan] } {
+		gets $chan
+		return
+	}
+
+	fconfigure $chan -blocking 1
+	if { [catch { close $chan }] || ![file exists [file rootname $demo].json] } {
+		puts "$demo \[FAIL\]"
+		incr failed
+	} else {
+		puts "$demo \[PASS\]"
+	}
+
+	incr running -1
+}
+
+foreach demo $demos {
+	while { $running >= $jobs } {
+		vwait running
+	}
+
+	file delete [file rootname $demo].json
+
+	set chan [open "|$odamex -nosound -netdemoinfo [list $demo] 2>@1" r]
+	fconfigure $chan -blocking 0
+	fileevent $chan readable [list finish $chan $demo]
+	incr running
+}
+
+while { $running > 0 } {
+	vwait running
+}
+
+exit [expr { $failed > 0 }]